@@ -1,35 +1,50 @@
 
 #include "myk_tiny.h"
-#include <iostream>
+#include <algorithm>
 
 std::vector<float>
 myk_tiny::loadWav(const std::string& filename)
+{
+    int sampleRate, channels;
+    return loadWav(filename, sampleRate, channels);
+}
+
+std::vector<float>
+myk_tiny::loadWav(const std::string& filename, int& sampleRate, int& channels)
 {
     TinyWav twReader;
-    tinywav_open_read(&twReader, filename.c_str(), TW_INLINE);
-    size_t bufferSize = twReader.numChannels * twReader.numFramesInHeader;
-    // dynamically allocate buffer on the heap
-    float* mainBuffer = new float[bufferSize];
-    size_t subSize    = 44100; // max read per iteration
-    float* subBuffer  = new float[subSize];
+    if (tinywav_open_read(&twReader, filename.c_str(), TW_INTERLEAVED) != 0)
+    {
+        sampleRate = 0;
+        channels   = 0;
+        return {};
+    }
+    sampleRate = static_cast<int>(twReader.h.SampleRate);
+    channels   = twReader.numChannels;
 
-    for (auto offset = 0; offset < bufferSize; offset += subSize)
+    // tinywav counts frames (one sample per channel), so a frame holds
+    // `channels` interleaved samples
+    size_t frames    = twReader.numFramesInHeader;
+    size_t subFrames = 44100; // max read per iteration
+    std::vector<float> vBuffer(frames * channels);
+    std::vector<float> subBuffer(subFrames * channels);
+
+    size_t framesRead = 0;
+    while (framesRead < frames)
     {
-        size_t samplesRead = tinywav_read_f(&twReader, subBuffer, subSize);
-        // copy samples read to the main buffer
-        // std::cout << "Samples read " << samplesRead << " of " <<bufferSize <<
-        // std::endl;
-        if (samplesRead == 0)
+        int read = tinywav_read_f(&twReader,
+                                  subBuffer.data(),
+                                  static_cast<int>(
+                                    std::min(subFrames, frames - framesRead)));
+        if (read <= 0)
             break;
-        std::copy(subBuffer, subBuffer + samplesRead, mainBuffer + offset);
-        // std::cout << (mainBuffer + offset)[0] << std::endl;
+        std::copy(subBuffer.begin(),
+                  subBuffer.begin() + read * channels,
+                  vBuffer.begin() + framesRead * channels);
+        framesRead += read;
     }
-    // iterate over the buffer, reading up to 4096 samples
     tinywav_close_read(&twReader);
-    std::vector<float> vBuffer(mainBuffer, mainBuffer + bufferSize);
-    // do the housework
-    delete[] mainBuffer;
-    delete[] subBuffer;
+    vBuffer.resize(framesRead * channels);
     return vBuffer;
 }
 
@@ -40,19 +55,21 @@ myk_tiny::saveWav(std::vector<float>& buffer,
                   const std::string& filename)
 {
     TinyWav twWriter;
-    size_t subSize = 44100; // max write per iteration
+    size_t subFrames = 44100; // max write per iteration
+    size_t frames    = buffer.size() / channels;
 
-    tinywav_open_write(
-      &twWriter, channels, sampleRate, TW_INT16, TW_INLINE, filename.c_str());
-    for (auto offset = 0; offset < buffer.size(); offset += subSize)
+    tinywav_open_write(&twWriter,
+                       channels,
+                       sampleRate,
+                       TW_INT16,
+                       TW_INTERLEAVED,
+                       filename.c_str());
+    for (size_t offset = 0; offset < frames; offset += subFrames)
     {
-        int remainingSamples = buffer.size() - offset;
-        if (remainingSamples == 0)
-            break;
-        int samplesToWrite =
-          (remainingSamples < subSize ? remainingSamples : subSize);
-        int samplesWritten =
-          tinywav_write_f(&twWriter, (buffer.data() + offset), samplesToWrite);
+        int framesToWrite =
+          static_cast<int>(std::min(subFrames, frames - offset));
+        tinywav_write_f(
+          &twWriter, buffer.data() + offset * channels, framesToWrite);
     }
     tinywav_close_write(&twWriter);
 }
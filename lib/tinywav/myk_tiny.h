@@ -10,6 +10,9 @@
 */
 
 struct myk_tiny{
+  // Interleaved samples (frames * channels); empty if the file can't be read
   static std::vector<float> loadWav(const std::string& filename);
+  static std::vector<float> loadWav(const std::string& filename, int& sampleRate, int& channels);
+  // `buffer` is interleaved, so its size is frames * channels
   static void saveWav(std::vector<float>& buffer, const int channels, const int sampleRate, const std::string& filename);
 };
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "AsyncConverter.h"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+AsyncConverter::AsyncConverter(Ort::Session& session,
+                               size_t threads,
+                               size_t streams,
+                               size_t maxInFlight,
+                               StreamAccounting* accounting)
+  : depth(maxInFlight)
+  , accounting(accounting)
+{
+    shards.push_back(std::make_unique<Shard>(session, streams, -1));
+    start(threads);
+}
+
+AsyncConverter::AsyncConverter(const std::vector<NumaNode>& nodes,
+                               const std::vector<Ort::Session*>& sessions,
+                               size_t threadsPerNode,
+                               size_t streamsPerNode,
+                               size_t maxInFlight,
+                               StreamAccounting* accounting)
+  : depth(maxInFlight)
+  , accounting(accounting)
+{
+    if (nodes.empty() || nodes.size() != sessions.size())
+    {
+        throw std::invalid_argument(
+          "AsyncConverter needs one session per NUMA node");
+    }
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        shards.push_back(
+          std::make_unique<Shard>(*sessions[k], streamsPerNode, nodes[k].id));
+        shards.back()->cpus = nodes[k].cpus;
+    }
+    start(threadsPerNode);
+}
+
+void
+AsyncConverter::start(size_t threadsPerShard)
+{
+    if (threadsPerShard == 0 || depth == 0)
+    {
+        throw std::invalid_argument(
+          "AsyncConverter needs at least one thread and one block in flight");
+    }
+    for (auto& shard : shards)
+    {
+        Shard* owner = shard.get();
+        for (size_t i = 0; i < threadsPerShard; ++i)
+        {
+            shard->workers.emplace_back([this, owner] { run(*owner); });
+        }
+    }
+}
+
+AsyncConverter::~AsyncConverter()
+{
+    for (auto& shard : shards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shard->queueMutex);
+            shard->stopping = true;
+        }
+        shard->ready.notify_all();
+    }
+    for (auto& shard : shards)
+    {
+        for (auto& worker : shard->workers)
+        {
+            worker.join();
+        }
+        for (Stream* stream : shard->open)
+        {
+            if (stream->account)
+            {
+                accounting->close(stream->account);
+            }
+            delete stream; // states go with the pool
+        }
+    }
+}
+
+AsyncConverter::Stream*
+AsyncConverter::openStream()
+{
+    // Least loaded shard first; a full one falls through to the next
+    std::vector<size_t> load(shards.size());
+    for (size_t k = 0; k < shards.size(); ++k)
+    {
+        std::lock_guard<std::mutex> lock(shards[k]->queueMutex);
+        load[k] = shards[k]->open.size();
+    }
+    std::vector<size_t> order(shards.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&load](size_t a, size_t b) {
+        return load[a] < load[b];
+    });
+
+    for (size_t k : order)
+    {
+        Shard& shard = *shards[k];
+        std::lock_guard<std::mutex> lock(shard.queueMutex);
+        PooledState* state = shard.states.acquire();
+        if (!state)
+        {
+            continue;
+        }
+        Stream* stream = new Stream;
+        stream->shard  = &shard;
+        stream->state  = state;
+        if (accounting)
+        {
+            stream->account = accounting->open(nextStreamId++);
+        }
+        shard.open.insert(stream);
+        return stream;
+    }
+    return nullptr;
+}
+
+void
+AsyncConverter::closeStream(Stream* stream)
+{
+    Shard& shard = *stream->shard;
+    std::lock_guard<std::mutex> lock(shard.queueMutex);
+    if (stream->running || !stream->pending.empty())
+    {
+        stream->closing = true; // the worker finishing it frees it
+        return;
+    }
+    release(shard, stream);
+}
+
+bool
+AsyncConverter::submit(Stream* stream,
+                       std::vector<float> block,
+                       Completion done)
+{
+    Shard& shard = *stream->shard;
+    {
+        std::lock_guard<std::mutex> lock(shard.queueMutex);
+        if (stream->closing)
+        {
+            throw std::logic_error("block submitted to a closed stream");
+        }
+        if (stream->pending.size() + (stream->running ? 1 : 0) >= depth)
+        {
+            return false;
+        }
+        stream->pending.push_back({ std::move(block), std::move(done) });
+        ++shard.outstanding;
+        if (stream->running || stream->pending.size() > 1)
+        {
+            return true; // already runnable or running
+        }
+        shard.runnable.push_back(stream);
+    }
+    shard.ready.notify_one();
+    return true;
+}
+
+std::future<std::vector<float>>
+AsyncConverter::submit(Stream* stream, std::vector<float> block)
+{
+    auto promise = std::make_shared<std::promise<std::vector<float>>>();
+    std::future<std::vector<float>> result = promise->get_future();
+    Completion fulfil = [promise](std::vector<float> output,
+                                  std::exception_ptr error) {
+        if (error)
+        {
+            promise->set_exception(error);
+        }
+        else
+        {
+            promise->set_value(std::move(output));
+        }
+    };
+    bool queued = submit(stream, std::move(block), std::move(fulfil));
+    return queued ? std::move(result) : std::future<std::vector<float>>();
+}
+
+size_t
+AsyncConverter::inFlight() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->queueMutex);
+        total += shard->outstanding;
+    }
+    return total;
+}
+
+void
+AsyncConverter::run(Shard& shard)
+{
+    // Keeps the worker next to its session's weights and its pool's states
+    if (!shard.cpus.empty())
+    {
+        pinThisThread(shard.cpus);
+    }
+    while (true)
+    {
+        Stream* stream;
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(shard.queueMutex);
+            shard.ready.wait(lock, [&shard] {
+                return !shard.runnable.empty() ||
+                       (shard.stopping && shard.outstanding == 0);
+            });
+            if (shard.runnable.empty())
+            {
+                return;
+            }
+            stream = shard.runnable.front();
+            shard.runnable.pop_front();
+            request = std::move(stream->pending.front());
+            stream->pending.pop_front();
+            stream->running = true;
+        }
+
+        std::exception_ptr error;
+        size_t samples = request.block.size();
+        RunTimer timer;
+        try
+        {
+            processBlock(shard.session,
+                         request.block.data(),
+                         request.block.data(),
+                         request.block.size(),
+                         *stream->state);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            request.block.clear();
+        }
+        if (stream->account)
+        {
+            // Failed Runs are charged too
+            accounting->record(stream->account, samples, timer.elapsed());
+        }
+        // Still marked running, so the stream's next block cannot overtake
+        request.done(std::move(request.block), error);
+
+        bool drained;
+        {
+            std::lock_guard<std::mutex> lock(shard.queueMutex);
+            stream->running = false;
+            --shard.outstanding;
+            if (!stream->pending.empty())
+            {
+                // Back of the line, behind streams that waited meanwhile
+                shard.runnable.push_back(stream);
+            }
+            else if (stream->closing)
+            {
+                release(shard, stream);
+            }
+            drained = shard.stopping && shard.outstanding == 0;
+        }
+        if (drained)
+        {
+            shard.ready.notify_all();
+        }
+    }
+}
+
+void
+AsyncConverter::release(Shard& shard, Stream* stream)
+{
+    shard.states.release(stream->state);
+    shard.open.erase(stream);
+    if (stream->account)
+    {
+        accounting->close(stream->account);
+    }
+    delete stream;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Numa.h"
+#include "StatePool.h"
+#include "StreamAccounting.h"
+#include <onnxruntime_cxx_api.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Non-blocking conversion for event-loop callers: blocks are submitted with
+// a completion callback (or for a future) and converted on an internal pool
+// of inference threads sharing one session. A stream has at most one block
+// running at a time, so its blocks complete in submission order and its
+// state is only ever touched by one thread; different streams run in
+// parallel and take turns round-robin. States come from a StatePool.
+//
+// On NUMA machines the converter can be split into one shard per node:
+// each shard has its own session, workers pinned to the node and a
+// node-local state pool, and a stream stays on the shard it opened on, so
+// no block reads weights or state across the interconnect.
+//
+// Given a StreamAccounting, every stream gets an account from open to
+// close and each Run is charged to it.
+
+class AsyncConverter
+{
+  public:
+    // Called on an inference thread with the converted block, or with the
+    // error that stopped it (the output is then empty). Callbacks for one
+    // stream never overlap and arrive in order; they must not throw and
+    // should hand the result to the caller's own loop rather than block.
+    using Completion =
+      std::function<void(std::vector<float> output, std::exception_ptr error)>;
+
+    struct Stream;
+
+    // `maxInFlight` bounds the blocks each stream may have queued or
+    // running; `streams` bounds the open streams. `accounting`, if given,
+    // must outlive the converter.
+    AsyncConverter(Ort::Session& session,
+                   size_t threads,
+                   size_t streams,
+                   size_t maxInFlight,
+                   StreamAccounting* accounting = nullptr);
+
+    // One shard per node; sessions[k] serves nodes[k] and should have been
+    // created there (createSessionOnNode). The counts are per node.
+    AsyncConverter(const std::vector<NumaNode>& nodes,
+                   const std::vector<Ort::Session*>& sessions,
+                   size_t threadsPerNode,
+                   size_t streamsPerNode,
+                   size_t maxInFlight,
+                   StreamAccounting* accounting = nullptr);
+
+    // Finishes every submitted block, then joins the threads
+    ~AsyncConverter();
+
+    AsyncConverter(const AsyncConverter&) = delete;
+    AsyncConverter& operator=(const AsyncConverter&) = delete;
+
+    // Opens on the shard with the fewest streams; returns nullptr when
+    // every shard is full
+    Stream* openStream();
+
+    // Blocks already submitted still complete; the stream is freed after
+    // the last of them
+    void closeStream(Stream* stream);
+
+    // False, without calling `done`, when the stream has maxInFlight blocks
+    // outstanding
+    bool submit(Stream* stream, std::vector<float> block, Completion done);
+
+    // As above; the future is invalid (valid() == false) when the stream is
+    // full, and rethrows inference errors from get()
+    std::future<std::vector<float>> submit(Stream* stream,
+                                           std::vector<float> block);
+
+    size_t inFlight() const;
+    size_t maxInFlight() const { return depth; }
+    size_t shardCount() const { return shards.size(); }
+
+  private:
+    struct Request
+    {
+        std::vector<float> block;
+        Completion done;
+    };
+
+    struct Shard
+    {
+        Shard(Ort::Session& session, size_t streams, int node)
+          : session(session)
+          , states(streams, false, false, node)
+        {
+        }
+
+        Ort::Session& session;
+        StatePool states;
+        std::vector<int> cpus; // empty: workers are not pinned
+
+        mutable std::mutex queueMutex;
+        std::condition_variable ready;
+        std::deque<Stream*> runnable; // streams with a block and none running
+        size_t outstanding = 0;
+        bool stopping      = false;
+        std::unordered_set<Stream*> open;
+        std::vector<std::thread> workers;
+    };
+
+    void start(size_t threadsPerShard);
+    void run(Shard& shard);
+    // Under the shard's queueMutex
+    void release(Shard& shard, Stream* stream);
+
+    const size_t depth;
+    StreamAccounting* const accounting;
+    std::atomic<uint64_t> nextStreamId{ 0 };
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+struct AsyncConverter::Stream
+{
+    Shard* shard                       = nullptr;
+    PooledState* state                 = nullptr;
+    StreamAccounting::Account* account = nullptr; // null without accounting
+    std::deque<Request> pending; // guarded by the shard's queueMutex
+    bool running = false;
+    bool closing = false;
+};
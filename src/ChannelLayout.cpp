@@ -0,0 +1,142 @@
+#include "ChannelLayout.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LLVC_DOWNMIX_AVX2 1
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define LLVC_DOWNMIX_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LLVC_DOWNMIX_NEON 1
+#endif
+
+namespace
+{
+// Stereo frames [first, frames) one at a time
+void
+downmixStereoScalar(const float* interleaved,
+                    size_t first,
+                    size_t frames,
+                    float* mono)
+{
+    for (size_t i = first; i < frames; ++i)
+    {
+        mono[i] = 0.5f * (interleaved[2 * i] + interleaved[2 * i + 1]);
+    }
+}
+
+void
+downmixStereo(const float* interleaved, size_t frames, float* mono)
+{
+    size_t i = 0;
+#if LLVC_DOWNMIX_AVX2
+    // hadd sums adjacent pairs within each 128-bit lane; the permute puts
+    // the 64-bit halves back in frame order
+    const __m256 half = _mm256_set1_ps(0.5f);
+    for (; i + 8 <= frames; i += 8)
+    {
+        __m256 a    = _mm256_loadu_ps(interleaved + 2 * i);
+        __m256 b    = _mm256_loadu_ps(interleaved + 2 * i + 8);
+        __m256 sums = _mm256_hadd_ps(a, b);
+        sums        = _mm256_castpd_ps(_mm256_permute4x64_pd(
+          _mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(mono + i, _mm256_mul_ps(sums, half));
+    }
+#elif LLVC_DOWNMIX_SSE
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 a     = _mm_loadu_ps(interleaved + 2 * i);
+        __m128 b     = _mm_loadu_ps(interleaved + 2 * i + 4);
+        __m128 left  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(mono + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+#elif LLVC_DOWNMIX_NEON
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t lr = vld2q_f32(interleaved + 2 * i);
+        vst1q_f32(mono + i,
+                  vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+    }
+#endif
+    downmixStereoScalar(interleaved, i, frames, mono);
+}
+} // namespace
+
+const char*
+downmixIsa()
+{
+#if LLVC_DOWNMIX_AVX2
+    return "avx2";
+#elif LLVC_DOWNMIX_SSE
+    return "sse";
+#elif LLVC_DOWNMIX_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+void
+deinterleave(const float* interleaved,
+             size_t frames,
+             size_t channels,
+             float* planar)
+{
+    for (size_t c = 0; c < channels; ++c)
+    {
+        float* out = planar + c * frames;
+        for (size_t i = 0; i < frames; ++i)
+        {
+            out[i] = interleaved[i * channels + c];
+        }
+    }
+}
+
+void
+interleave(const float* planar,
+           size_t frames,
+           size_t channels,
+           float* interleaved)
+{
+    for (size_t c = 0; c < channels; ++c)
+    {
+        const float* in = planar + c * frames;
+        for (size_t i = 0; i < frames; ++i)
+        {
+            interleaved[i * channels + c] = in[i];
+        }
+    }
+}
+
+void
+downmixToMono(const float* interleaved,
+              size_t frames,
+              size_t channels,
+              float* mono)
+{
+    if (channels == 1)
+    {
+        std::copy(interleaved, interleaved + frames, mono);
+        return;
+    }
+    if (channels == 2)
+    {
+        downmixStereo(interleaved, frames, mono);
+        return;
+    }
+    const float scale = 1.0f / static_cast<float>(channels);
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const float* frame = interleaved + i * channels;
+        float sum          = 0.0f;
+        for (size_t c = 0; c < channels; ++c)
+        {
+            sum += frame[c];
+        }
+        mono[i] = sum * scale;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// Conversions between the interleaved frames of a WAV file and the
+// channel-after-channel layout processBatch takes. `frames` counts samples
+// per channel.
+
+// Name of the instruction set downmixToMono was built for
+const char*
+downmixIsa();
+
+void
+deinterleave(const float* interleaved,
+             size_t frames,
+             size_t channels,
+             float* planar);
+
+void
+interleave(const float* planar,
+           size_t frames,
+           size_t channels,
+           float* interleaved);
+
+// mono[i] = mean of frame i's channels. Stereo has an AVX2, SSE or NEON
+// path, chosen at compile time (LLVC_NATIVE_ARCH for AVX2); other channel
+// counts, and the scalar fallback, sum frame by frame.
+void
+downmixToMono(const float* interleaved,
+              size_t frames,
+              size_t channels,
+              float* mono);
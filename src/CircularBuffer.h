@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Simple lock-free circular buffer of fixed-size audio blocks, for one
+// producer and one consumer. Blocks are copied in and out, so neither side
+// allocates once the ring is built.
+class CircularBuffer
+{
+  public:
+    CircularBuffer(size_t capacity, size_t blockSize)
+      : writeIndex(0)
+      , readIndex(0)
+      , size(0)
+    {
+        buffer.resize(capacity);
+        for (auto& block : buffer)
+        {
+            block.resize(blockSize);
+        }
+    }
+
+    bool push(const std::vector<float>& data)
+    {
+        if (size.load(std::memory_order_acquire) == buffer.size())
+        {
+            return false; // Buffer is full
+        }
+        buffer[writeIndex] = data;
+        writeIndex         = (writeIndex + 1) % buffer.size();
+        size.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(std::vector<float>& data)
+    {
+        if (size.load(std::memory_order_acquire) == 0)
+        {
+            return false; // Buffer is empty
+        }
+        data      = buffer[readIndex];
+        readIndex = (readIndex + 1) % buffer.size();
+        size.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: discards the oldest block without copying it
+    bool dropOldest()
+    {
+        if (size.load(std::memory_order_acquire) == 0)
+        {
+            return false;
+        }
+        readIndex = (readIndex + 1) % buffer.size();
+        size.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    size_t queued() const { return size.load(std::memory_order_acquire); }
+
+  private:
+    std::vector<std::vector<float>> buffer;
+    std::atomic<size_t> writeIndex;
+    std::atomic<size_t> readIndex;
+    std::atomic<size_t> size;
+};
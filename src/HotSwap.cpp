@@ -0,0 +1,111 @@
+#include "HotSwap.h"
+#include "llvc.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+template <size_t N>
+void
+checkShape(Ort::Session& session,
+           size_t index,
+           const std::array<int64_t, N>& expected)
+{
+    std::vector<int64_t> shape =
+      session.GetInputTypeInfo(index).GetTensorTypeAndShapeInfo().GetShape();
+    bool matches = shape.size() == N;
+    for (size_t d = 0; matches && d < N; ++d)
+    {
+        // Symbolic dimensions (-1) accept whatever the state provides
+        matches = shape[d] == expected[d] || shape[d] < 0;
+    }
+    if (!matches)
+    {
+        throw std::runtime_error(std::string("model input ") +
+                                 INPUT_NAMES[index] +
+                                 " does not match the stream state shape");
+    }
+}
+} // namespace
+
+void
+validateModel(Ort::Session& session)
+{
+    if (session.GetInputCount() != 5 || session.GetOutputCount() != 5)
+    {
+        throw std::runtime_error("model must have 5 inputs and 5 outputs");
+    }
+    Ort::AllocatorWithDefaultOptions allocator;
+    for (size_t i = 0; i < 5; ++i)
+    {
+        if (std::string(session.GetInputNameAllocated(i, allocator).get()) !=
+            INPUT_NAMES[i])
+        {
+            throw std::runtime_error(std::string("model input ") +
+                                     std::to_string(i) + " is not " +
+                                     INPUT_NAMES[i]);
+        }
+        if (std::string(session.GetOutputNameAllocated(i, allocator).get()) !=
+            OUTPUT_NAMES[i])
+        {
+            throw std::runtime_error(std::string("model output ") +
+                                     std::to_string(i) + " is not " +
+                                     OUTPUT_NAMES[i]);
+        }
+    }
+    checkShape(session, 1, ENC_BUF_SHAPE);
+    checkShape(session, 2, DEC_BUF_SHAPE);
+    checkShape(session, 3, OUT_BUF_SHAPE);
+    checkShape(session, 4, CONVNET_PRE_CTX_SHAPE);
+}
+
+std::shared_ptr<const LoadedModel>
+loadModel(Ort::Env& env,
+          const std::string& path,
+          Ort::SessionOptions& options,
+          const std::vector<size_t>& warmupSizes,
+          uint64_t generation,
+          bool mapWeights)
+{
+    auto model        = std::make_shared<LoadedModel>();
+    model->path       = path;
+    model->generation = generation;
+    if (mapWeights)
+    {
+        auto start     = std::chrono::steady_clock::now();
+        model->mapping = std::make_shared<const MappedModel>(path);
+        model->startup.mapMs =
+          std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+        model->session =
+          createSession(env, *model->mapping, options, model->startup);
+    }
+    else
+    {
+        model->session =
+          createSession(env, path.c_str(), options, model->startup);
+    }
+    validateModel(*model->session);
+    warmUpSession(*model->session, warmupSizes, model->startup);
+    readResidentMemory(model->startup);
+    return model;
+}
+
+void
+crossfade(const float* from,
+          const float* to,
+          float* out,
+          size_t samples,
+          float startGain,
+          float endGain)
+{
+    float step = (endGain - startGain) / std::max<size_t>(samples, 1);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        float gain = startGain + step * i;
+        out[i]     = from[i] * (1.0f - gain) + to[i] * gain;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "MappedModel.h"
+#include "llvc_startup.h"
+#include <onnxruntime_cxx_api.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Replacing the model of a running converter. A model is loaded, checked
+// and warmed up off the audio path, then published through a ModelSlot;
+// streams pick it up at their next block boundary. Sessions are shared_ptr
+// owned, so the old one is freed only when the last stream using it lets go.
+
+struct LoadedModel
+{
+    // Set when the weights are mapped; declared first so it outlives the
+    // session reading from it
+    std::shared_ptr<const MappedModel> mapping;
+    std::unique_ptr<Ort::Session> session;
+    std::string path;
+    uint64_t generation = 0;
+    StartupReport startup;
+};
+
+// How streams move to a newly published model
+enum class SwapPolicy
+{
+    Crossfade, // switch at once with fresh state, fading from the old model
+    Drain      // keep the old model until the stream ends
+};
+
+// Throws std::runtime_error unless the session has the LLVC streaming
+// signature with state shapes matching llvc.h
+void
+validateModel(Ort::Session& session);
+
+// Creates, validates and warms up a session for `path`, with its weights
+// in a shared read-only mapping if `mapWeights` (see MappedModel)
+std::shared_ptr<const LoadedModel>
+loadModel(Ort::Env& env,
+          const std::string& path,
+          Ort::SessionOptions& options,
+          const std::vector<size_t>& warmupSizes,
+          uint64_t generation,
+          bool mapWeights = false);
+
+// The model new blocks should use. Readers and the publisher never block
+// each other.
+class ModelSlot
+{
+  public:
+    explicit ModelSlot(std::shared_ptr<const LoadedModel> model)
+      : model(std::move(model))
+    {
+    }
+
+    std::shared_ptr<const LoadedModel> current() const
+    {
+        return std::atomic_load(&model);
+    }
+
+    void publish(std::shared_ptr<const LoadedModel> next)
+    {
+        std::atomic_store(&model, std::move(next));
+    }
+
+  private:
+    std::shared_ptr<const LoadedModel> model;
+};
+
+// Mixes the outgoing and incoming model outputs into `out`, ramping the
+// incoming gain linearly from `startGain` to `endGain` over the block
+void
+crossfade(const float* from,
+          const float* to,
+          float* out,
+          size_t samples,
+          float startGain,
+          float endGain);
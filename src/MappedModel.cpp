@@ -0,0 +1,236 @@
+#include "MappedModel.h"
+#include "OnnxGraph.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const int32_t TYPE_FLOAT  = 1;
+const int32_t TYPE_STRING = 8;
+
+// Smaller initializers, and every non-float one, stay in the skeleton. ORT
+// reads int64 shapes, axes and pads during shape inference and constant
+// folding, before external initializers are bound, and fails on them with
+// "Cannot parse data from external tensors"; small tensors save nothing.
+const size_t MIN_MAPPED_BYTES = 4096;
+
+[[noreturn]] void
+throwErrno(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Bytes per element of an onnx.proto TensorProto.DataType, or 0 for types
+// that cannot be passed as a flat buffer
+size_t
+elementSize(int32_t dataType)
+{
+    switch (dataType)
+    {
+        case 2:  // UINT8
+        case 3:  // INT8
+        case 9:  // BOOL
+        case 17: // FLOAT8E4M3FN
+        case 18: // FLOAT8E4M3FNUZ
+        case 19: // FLOAT8E5M2
+        case 20: // FLOAT8E5M2FNUZ
+            return 1;
+        case 4:  // UINT16
+        case 5:  // INT16
+        case 10: // FLOAT16
+        case 16: // BFLOAT16
+            return 2;
+        case 1:  // FLOAT
+        case 6:  // INT32
+        case 12: // UINT32
+            return 4;
+        case 7:  // INT64
+        case 11: // DOUBLE
+        case 13: // UINT64
+        case 14: // COMPLEX64
+            return 8;
+        case 15: // COMPLEX128
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t
+elementCount(const std::vector<int64_t>& shape)
+{
+    size_t count = 1;
+    for (int64_t dim : shape)
+    {
+        count *= static_cast<size_t>(dim);
+    }
+    return count;
+}
+} // namespace
+
+MappedModel::MappedModel(const std::string& path)
+  : modelPath(path)
+{
+    try
+    {
+        Mapping model = map(path);
+        std::filesystem::path directory =
+          std::filesystem::path(path).parent_path();
+        Ort::MemoryInfo memoryInfo =
+          Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+
+        std::set<std::string> supplied;
+        std::map<std::string, std::string> inlined;
+        for (const InitializerData& data :
+             locateInitializers(model.address, model.size))
+        {
+            size_t width = elementSize(data.dataType);
+            size_t count = elementCount(data.shape);
+            if (data.dataType == TYPE_STRING || width == 0 || count == 0)
+            {
+                continue;
+            }
+            bool external = !data.location.empty();
+            bool eligible = data.dataType == TYPE_FLOAT &&
+                            count * width >= MIN_MAPPED_BYTES;
+            if (!eligible && !external)
+            {
+                continue; // ORT parses it from the skeleton as before
+            }
+            Mapping file  = external
+                              ? map((directory / data.location).string())
+                              : model;
+            size_t length = data.length;
+            if (length == 0 && external && data.offset <= file.size)
+            {
+                length = file.size - data.offset; // to the end of the file
+            }
+            if (data.offset > file.size || length > file.size - data.offset ||
+                length != count * width)
+            {
+                throw std::runtime_error("initializer " + data.name +
+                                         " does not fit in " + file.file);
+            }
+
+            // The skeleton is parsed from memory, so it cannot refer to data
+            // files; small and non-float tensors stored in one go back in
+            const char* bytes = file.address + data.offset;
+            if (!eligible)
+            {
+                inlined.emplace(data.name, std::string(bytes, length));
+                continue;
+            }
+
+            // The mapping is page aligned, so the offset decides
+            if (data.offset % width == 0)
+            {
+                ++mappedCount;
+                mappedTotal += length;
+            }
+            else
+            {
+                copies.emplace_back(new char[length]);
+                std::memcpy(copies.back().get(), bytes, length);
+                bytes = copies.back().get();
+                ++copiedCount;
+                copiedTotal += length;
+            }
+            // ORT only reads initializers, so the mapping can stay read-only
+            names.push_back(data.name);
+            values.push_back(Ort::Value::CreateTensor(
+              memoryInfo,
+              const_cast<char*>(bytes),
+              length,
+              data.shape.data(),
+              data.shape.size(),
+              static_cast<ONNXTensorElementDataType>(data.dataType)));
+            supplied.insert(data.name);
+        }
+        skeleton =
+          stripInitializers(model.address, model.size, supplied, inlined);
+    }
+    catch (...)
+    {
+        values.clear();
+        for (const Mapping& mapping : mappings)
+        {
+            if (mapping.size)
+            {
+                munmap(const_cast<char*>(mapping.address), mapping.size);
+            }
+        }
+        throw;
+    }
+}
+
+MappedModel::~MappedModel()
+{
+    values.clear(); // before the memory they point into
+    for (const Mapping& mapping : mappings)
+    {
+        if (mapping.size)
+        {
+            munmap(const_cast<char*>(mapping.address), mapping.size);
+        }
+    }
+}
+
+MappedModel::Mapping
+MappedModel::map(const std::string& file)
+{
+    for (const Mapping& mapping : mappings)
+    {
+        if (mapping.file == file)
+        {
+            return mapping;
+        }
+    }
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throwErrno("open " + file);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        throwErrno("stat " + file);
+    }
+    Mapping mapping;
+    mapping.file = file;
+    mapping.size = static_cast<size_t>(info.st_size);
+    if (mapping.size)
+    {
+        void* base =
+          mmap(nullptr, mapping.size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            throwErrno("mmap " + file);
+        }
+        mapping.address = static_cast<const char*>(base);
+    }
+    close(fd);
+    mappings.push_back(mapping);
+    return mapping;
+}
+
+Ort::SessionOptions
+MappedModel::sessionOptions(const Ort::SessionOptions& options) const
+{
+    Ort::SessionOptions mapped = options.Clone();
+    mapped.AddConfigEntry("session.disable_prepacking", "1");
+    if (!names.empty())
+    {
+        mapped.AddExternalInitializers(names, values);
+    }
+    return mapped;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A model file, and any external data files next to it, mapped read-only
+// and shared. Initializers stored as raw bytes are handed to ORT as tensors
+// pointing into the mapping (SessionOptions::AddExternalInitializers), so
+// every session and every process serving the same file reads one copy of
+// the weights from the page cache; ORT parses the rest of the graph from a
+// copy of the model with those bytes stripped, which is small.
+//
+// Only float weights of 4 KiB or more are supplied this way. Smaller and
+// non-float initializers (int64 shapes, axes, pads) stay in the model, as
+// ORT needs their values during shape inference, and are copied by ORT as
+// usual; if they were in an external data file their bytes are put back
+// inline. A weight whose bytes are not aligned to its element size cannot
+// be used in place and is copied once into memory owned here. The
+// MappedModel must outlive every session created from it.
+class MappedModel
+{
+  public:
+    // Throws std::runtime_error if a file cannot be opened or mapped, or an
+    // initializer lies outside its file
+    explicit MappedModel(const std::string& path);
+    ~MappedModel();
+
+    MappedModel(const MappedModel&) = delete;
+    MappedModel& operator=(const MappedModel&) = delete;
+
+    // A copy of `options` that supplies the initializers. Prepacking is
+    // turned off: prepacked kernels keep their own reordered copy of the
+    // weights, which would undo the sharing.
+    Ort::SessionOptions sessionOptions(
+      const Ort::SessionOptions& options) const;
+
+    // The stripped model, to pass to Ort::Session with sessionOptions()
+    const std::string& modelBytes() const { return skeleton; }
+
+    const std::string& path() const { return modelPath; }
+    size_t mappedInitializers() const { return mappedCount; }
+    size_t mappedBytes() const { return mappedTotal; }
+    size_t copiedInitializers() const { return copiedCount; }
+    size_t copiedBytes() const { return copiedTotal; }
+
+  private:
+    struct Mapping
+    {
+        std::string file;
+        const char* address = nullptr;
+        size_t size         = 0;
+    };
+
+    // Maps `file` once; later calls return the same mapping
+    Mapping map(const std::string& file);
+
+    std::string modelPath;
+    std::vector<Mapping> mappings; // the model first
+    std::vector<std::unique_ptr<char[]>> copies;
+    std::vector<std::string> names;
+    std::vector<Ort::Value> values;
+    std::string skeleton;
+    size_t mappedCount = 0;
+    size_t mappedTotal = 0;
+    size_t copiedCount = 0;
+    size_t copiedTotal = 0;
+};
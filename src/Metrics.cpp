@@ -0,0 +1,400 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+const int POLL_MS = 100; // how often the exporter checks for shutdown
+
+// Threads take shards round-robin on their first update
+size_t
+shardIndex()
+{
+    static std::atomic<size_t> next{ 0 };
+    thread_local size_t index =
+      next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return index;
+}
+
+std::string
+baseName(const std::string& name)
+{
+    return name.substr(0, name.find('{'));
+}
+
+void
+writeAll(int fd, const std::string& data)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t n = send(
+          fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return; // the scraper went away
+        }
+        offset += static_cast<size_t>(n);
+    }
+}
+} // namespace
+
+void
+Counter::add(uint64_t amount)
+{
+    shards[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t
+Counter::value() const
+{
+    uint64_t total = 0;
+    for (const Shard& shard : shards)
+    {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+  : bounds(std::move(bounds))
+{
+    for (Shard& shard : shards)
+    {
+        shard.buckets.reset(new std::atomic<uint64_t>[this->bounds.size() + 1]);
+        for (size_t b = 0; b <= this->bounds.size(); ++b)
+        {
+            shard.buckets[b].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void
+Histogram::observe(double value)
+{
+    Shard& shard  = shards[shardIndex()];
+    size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) -
+                    bounds.begin();
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    // Uncontended unless more threads than shards observe at once
+    uint64_t bits = shard.sumBits.load(std::memory_order_relaxed);
+    while (true)
+    {
+        double sum;
+        std::memcpy(&sum, &bits, sizeof(sum));
+        sum += value;
+        uint64_t next;
+        std::memcpy(&next, &sum, sizeof(next));
+        if (shard.sumBits.compare_exchange_weak(
+              bits, next, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+}
+
+Histogram::Snapshot
+Histogram::snapshot() const
+{
+    Snapshot result;
+    result.cumulative.assign(bounds.size() + 1, 0);
+    for (const Shard& shard : shards)
+    {
+        for (size_t b = 0; b <= bounds.size(); ++b)
+        {
+            result.cumulative[b] +=
+              shard.buckets[b].load(std::memory_order_relaxed);
+        }
+        uint64_t bits = shard.sumBits.load(std::memory_order_relaxed);
+        double sum;
+        std::memcpy(&sum, &bits, sizeof(sum));
+        result.sum += sum;
+    }
+    for (size_t b = 1; b <= bounds.size(); ++b)
+    {
+        result.cumulative[b] += result.cumulative[b - 1];
+    }
+    // Taken from the buckets so the snapshot is self-consistent
+    result.count = result.cumulative.back();
+    return result;
+}
+
+MetricsRegistry::Entry*
+MetricsRegistry::find(const std::string& name)
+{
+    for (auto& entry : entries)
+    {
+        if (entry->name == name)
+        {
+            return entry.get();
+        }
+    }
+    return nullptr;
+}
+
+MetricsRegistry::Entry&
+MetricsRegistry::add(const std::string& name,
+                     const std::string& help,
+                     Type type)
+{
+    Entry* existing = find(name);
+    if (existing)
+    {
+        if (existing->type != type)
+        {
+            throw std::runtime_error("metric " + name +
+                                     " registered with another type");
+        }
+        return *existing;
+    }
+    auto entry  = std::make_unique<Entry>();
+    entry->name = name;
+    entry->help = help;
+    entry->type = type;
+    entries.push_back(std::move(entry));
+    return *entries.back();
+}
+
+Counter&
+MetricsRegistry::counter(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = add(name, help, Type::Counter);
+    if (!entry.counter)
+    {
+        entry.counter = std::make_unique<Counter>();
+    }
+    return *entry.counter;
+}
+
+Gauge&
+MetricsRegistry::gauge(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = add(name, help, Type::Gauge);
+    if (!entry.gauge)
+    {
+        entry.gauge = std::make_unique<Gauge>();
+    }
+    return *entry.gauge;
+}
+
+Histogram&
+MetricsRegistry::histogram(const std::string& name,
+                           const std::string& help,
+                           const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = add(name, help, Type::Histogram);
+    if (!entry.histogram)
+    {
+        entry.histogram = std::make_unique<Histogram>(bounds);
+    }
+    return *entry.histogram;
+}
+
+void
+MetricsRegistry::gauge(const std::string& name,
+                       const std::string& help,
+                       std::function<double()> read)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    add(name, help, Type::Gauge).read = std::move(read);
+}
+
+void
+MetricsRegistry::collector(std::function<std::string()> render)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    collectors.push_back(std::move(render));
+}
+
+std::string
+MetricsRegistry::render() const
+{
+    static const char* const TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out.precision(12);
+    std::vector<std::string> described;
+    for (const auto& entry : entries)
+    {
+        std::string base = baseName(entry->name);
+        if (std::find(described.begin(), described.end(), base) ==
+            described.end())
+        {
+            out << "# HELP " << base << " " << entry->help << "\n"
+                << "# TYPE " << base << " "
+                << TYPE_NAMES[static_cast<int>(entry->type)] << "\n";
+            described.push_back(base);
+        }
+        switch (entry->type)
+        {
+            case Type::Counter:
+                out << entry->name << " " << entry->counter->value() << "\n";
+                break;
+            case Type::Gauge:
+                out << entry->name << " "
+                    << (entry->read ? entry->read() : entry->gauge->value())
+                    << "\n";
+                break;
+            case Type::Histogram:
+            {
+                Histogram::Snapshot snapshot = entry->histogram->snapshot();
+                const std::vector<double>& bounds =
+                  entry->histogram->upperBounds();
+                for (size_t b = 0; b < bounds.size(); ++b)
+                {
+                    out << base << "_bucket{le=\"" << bounds[b] << "\"} "
+                        << snapshot.cumulative[b] << "\n";
+                }
+                out << base << "_bucket{le=\"+Inf\"} " << snapshot.count
+                    << "\n"
+                    << base << "_sum " << snapshot.sum << "\n"
+                    << base << "_count " << snapshot.count << "\n";
+                break;
+            }
+        }
+    }
+    for (const auto& collect : collectors)
+    {
+        out << collect();
+    }
+    return out.str();
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry,
+                                 int port,
+                                 const std::string& path,
+                                 double intervalSeconds)
+  : registry(registry)
+  , path(path)
+  , intervalSeconds(intervalSeconds)
+{
+    if (port > 0)
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one  = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_port        = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listenFd < 0 ||
+            bind(listenFd,
+                 reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) < 0 ||
+            listen(listenFd, 16) < 0)
+        {
+            std::string error = std::strerror(errno);
+            if (listenFd >= 0)
+            {
+                close(listenFd);
+            }
+            throw std::runtime_error("metrics port " + std::to_string(port) +
+                                     ": " + error);
+        }
+    }
+    thread = std::thread([this] { run(); });
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stopping.store(true);
+    thread.join();
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+    }
+    if (!path.empty())
+    {
+        writeFile(); // final values
+    }
+}
+
+void
+MetricsExporter::run()
+{
+    using Clock    = std::chrono::steady_clock;
+    auto nextWrite = Clock::now();
+    auto interval  = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(intervalSeconds));
+    while (!stopping.load())
+    {
+        if (!path.empty() && Clock::now() >= nextWrite)
+        {
+            writeFile();
+            nextWrite += interval;
+        }
+        if (listenFd < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+            continue;
+        }
+        pollfd listener{ listenFd, POLLIN, 0 };
+        if (poll(&listener, 1, POLL_MS) > 0)
+        {
+            serve();
+        }
+    }
+}
+
+void
+MetricsExporter::serve()
+{
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    // The request itself does not matter; read what has arrived so the
+    // close does not reset the connection
+    pollfd client{ fd, POLLIN, 0 };
+    if (poll(&client, 1, POLL_MS) > 0)
+    {
+        char request[4096];
+        ssize_t ignored = recv(fd, request, sizeof(request), 0);
+        (void)ignored;
+    }
+    std::string body = registry.render();
+    writeAll(fd,
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: text/plain; version=0.0.4\r\n"
+             "Content-Length: " +
+               std::to_string(body.size()) +
+               "\r\n"
+               "Connection: close\r\n\r\n" +
+               body);
+    close(fd);
+}
+
+void
+MetricsExporter::writeFile()
+{
+    // Replaced atomically so a reader never sees a partial file
+    std::string temporary = path + ".tmp";
+    FILE* file            = std::fopen(temporary.c_str(), "w");
+    if (!file)
+    {
+        return;
+    }
+    std::string body = registry.render();
+    bool written =
+      std::fwrite(body.data(), 1, body.size(), file) == body.size();
+    written = std::fclose(file) == 0 && written;
+    if (written)
+    {
+        std::rename(temporary.c_str(), path.c_str());
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Embedded metrics in the Prometheus text format. Counters and histograms
+// are sharded: each thread updates its own cache line with relaxed atomics
+// and the shards are only summed when the registry is rendered, so
+// recording a block costs a few uncontended increments. Gauges are single
+// atomics or functions evaluated at scrape time.
+//
+// Metric names may carry a fixed label set, e.g.
+// `llvc_xruns_total{kind="input_overflow"}`; HELP and TYPE are emitted once
+// per base name. Histograms take no labels.
+
+const size_t METRIC_SHARDS = 16;
+
+// Block latency buckets in milliseconds
+const std::vector<double> LATENCY_BUCKETS_MS = { 1,  2,   5,   10,  20,  50,
+                                                 100, 200, 500, 1000, 2000 };
+
+class Counter
+{
+  public:
+    void add(uint64_t amount = 1);
+    uint64_t value() const;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{ 0 };
+    };
+    Shard shards[METRIC_SHARDS];
+};
+
+class Gauge
+{
+  public:
+    void set(double value) { current.store(value, std::memory_order_relaxed); }
+    double value() const { return current.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<double> current{ 0.0 };
+};
+
+class Histogram
+{
+  public:
+    // `bounds` are the upper bounds of the buckets, ascending; +Inf is
+    // implied
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    struct Snapshot
+    {
+        std::vector<uint64_t> cumulative; // per bound, then +Inf
+        double sum     = 0.0;
+        uint64_t count = 0;
+    };
+    Snapshot snapshot() const;
+    const std::vector<double>& upperBounds() const { return bounds; }
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+        std::atomic<uint64_t> sumBits{ 0 }; // double, updated by CAS
+    };
+    std::vector<double> bounds;
+    Shard shards[METRIC_SHARDS];
+};
+
+class MetricsRegistry
+{
+  public:
+    // Registration returns a reference that stays valid for the registry's
+    // lifetime; registering a name twice returns the same metric
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name,
+                         const std::string& help,
+                         const std::vector<double>& bounds);
+    // Read when rendered, on the scraping thread
+    void gauge(const std::string& name,
+               const std::string& help,
+               std::function<double()> read);
+
+    // Text appended to every render, produced at scrape time: for
+    // families whose label sets come and go (e.g. per-stream series). It
+    // must be complete exposition lines, HELP and TYPE included.
+    void collector(std::function<std::string()> render);
+
+    // Prometheus text exposition format, version 0.0.4
+    std::string render() const;
+
+  private:
+    enum class Type
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        Type type;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;
+    };
+
+    Entry* find(const std::string& name);
+    Entry& add(const std::string& name, const std::string& help, Type type);
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries; // in registration order
+    std::vector<std::function<std::string()>> collectors;
+};
+
+// Publishes a registry: serves it over HTTP on 127.0.0.1:`port` (any path,
+// for `port` > 0) and/or rewrites `path` every `intervalSeconds` (for a
+// non-empty path, e.g. for node_exporter's textfile collector). Runs on
+// its own thread; throws std::runtime_error if the port cannot be bound.
+class MetricsExporter
+{
+  public:
+    MetricsExporter(const MetricsRegistry& registry,
+                    int port,
+                    const std::string& path,
+                    double intervalSeconds);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  private:
+    void run();
+    void serve();
+    void writeFile();
+
+    const MetricsRegistry& registry;
+    int listenFd = -1;
+    std::string path;
+    double intervalSeconds;
+    std::atomic<bool> stopping{ false };
+    std::thread thread;
+};
@@ -0,0 +1,247 @@
+#include "ModelRegistry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+// Voice names become file names, so keep them to a safe alphabet
+bool
+validVoiceName(const std::string& voice)
+{
+    if (voice.empty() || voice.size() > 64)
+    {
+        return false;
+    }
+    for (char c : voice)
+    {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    return voice[0] != '.';
+}
+
+size_t
+residentBytes()
+{
+    long pages = 0;
+    long rss   = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+    {
+        if (std::fscanf(statm, "%ld %ld", &pages, &rss) != 2)
+        {
+            rss = 0;
+        }
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(rss) * sysconf(_SC_PAGESIZE);
+}
+} // namespace
+
+std::ostream&
+operator<<(std::ostream& out, const RegistryStats& stats)
+{
+    out << "Model registry: " << stats.hits << " hits, " << stats.misses
+        << " misses, " << stats.loads << " loads ("
+        << (stats.loads ? stats.loadMsTotal / stats.loads : 0.0)
+        << " ms mean, " << stats.loadMsMax << " ms max), "
+        << stats.loadFailures << " failed, " << stats.evictions
+        << " evictions; " << stats.residentModels << " resident using ~"
+        << stats.residentBytes / 1048576.0 << " of "
+        << stats.budgetBytes / 1048576.0 << " MB";
+    return out;
+}
+
+ModelRegistry::ModelRegistry(Ort::Env& env,
+                             Ort::SessionOptions& options,
+                             const std::string& directory,
+                             size_t budgetBytes,
+                             std::vector<size_t> warmupSizes,
+                             bool mapWeights)
+  : env(env)
+  , options(options)
+  , directory(directory)
+  , warmupSizes(std::move(warmupSizes))
+  , mapWeights(mapWeights)
+{
+    counters.budgetBytes = budgetBytes;
+}
+
+std::shared_ptr<const LoadedModel>
+ModelRegistry::acquire(const std::string& voice)
+{
+    if (!validVoiceName(voice))
+    {
+        throw std::runtime_error("invalid voice name");
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(voice);
+    if (it != entries.end() && !it->second.loading)
+    {
+        ++counters.hits;
+        return lease(voice, it->second);
+    }
+    ++counters.misses;
+
+    if (it != entries.end())
+    {
+        // Another stream is loading this voice; share its result
+        loaded.wait(lock, [&] {
+            auto found = entries.find(voice);
+            return found == entries.end() || !found->second.loading;
+        });
+        it = entries.find(voice);
+        if (it == entries.end())
+        {
+            throw std::runtime_error("failed to load voice " + voice);
+        }
+        return lease(voice, it->second);
+    }
+
+    entries[voice].loading = true;
+    lock.unlock();
+
+    size_t bytes = 0;
+    std::shared_ptr<const LoadedModel> model;
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        model = load(voice, bytes);
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    lock.lock();
+    if (!model)
+    {
+        entries.erase(voice);
+        ++counters.loadFailures;
+        loaded.notify_all();
+        throw std::runtime_error("failed to load voice " + voice + ": " +
+                                 error);
+    }
+    ++counters.loads;
+    counters.loadMsTotal += ms;
+    counters.loadMsMax = std::max(counters.loadMsMax, ms);
+
+    Entry& entry  = entries[voice];
+    entry.model   = std::move(model);
+    entry.bytes   = bytes;
+    entry.loading = false;
+    counters.residentBytes += bytes;
+    ++counters.residentModels;
+    std::shared_ptr<const LoadedModel> handle = lease(voice, entry);
+    evictToBudget();
+    loaded.notify_all();
+    return handle;
+}
+
+std::shared_ptr<const LoadedModel>
+ModelRegistry::tryAcquire(const std::string& voice)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(voice);
+    if (it == entries.end() || it->second.loading)
+    {
+        return nullptr;
+    }
+    ++counters.hits;
+    return lease(voice, it->second);
+}
+
+RegistryStats
+ModelRegistry::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+// Called with `mutex` held
+std::shared_ptr<const LoadedModel>
+ModelRegistry::lease(const std::string& voice, Entry& entry)
+{
+    ++entry.users;
+    entry.lastUse = ++clock;
+    std::shared_ptr<const LoadedModel> model = entry.model;
+    return std::shared_ptr<const LoadedModel>(
+      model.get(), [this, voice, model](const LoadedModel*) {
+          release(voice);
+      });
+}
+
+void
+ModelRegistry::release(const std::string& voice)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(voice);
+    if (it != entries.end() && it->second.users > 0)
+    {
+        --it->second.users;
+        it->second.lastUse = ++clock;
+    }
+    evictToBudget();
+}
+
+std::shared_ptr<const LoadedModel>
+ModelRegistry::load(const std::string& voice, size_t& bytes)
+{
+    std::string path = directory + "/" + voice + ".onnx";
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        throw std::runtime_error("no model at " + path);
+    }
+
+    // Session memory is estimated from the RSS growth across the load,
+    // and never taken as less than the model file itself
+    std::lock_guard<std::mutex> serial(loadMutex);
+    size_t before = residentBytes();
+    std::shared_ptr<const LoadedModel> model =
+      loadModel(env, path, options, warmupSizes, ++generation, mapWeights);
+    size_t after = residentBytes();
+    bytes        = std::max(static_cast<size_t>(info.st_size),
+                     after > before ? after - before : 0);
+    return model;
+}
+
+// Called with `mutex` held
+void
+ModelRegistry::evictToBudget()
+{
+    while (counters.residentBytes > counters.budgetBytes)
+    {
+        auto victim = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            const Entry& entry = it->second;
+            if (!entry.loading && entry.users == 0 &&
+                (victim == entries.end() ||
+                 entry.lastUse < victim->second.lastUse))
+            {
+                victim = it;
+            }
+        }
+        if (victim == entries.end())
+        {
+            return; // Everything resident is in use; stay over budget
+        }
+        counters.residentBytes -= victim->second.bytes;
+        --counters.residentModels;
+        ++counters.evictions;
+        entries.erase(victim);
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "HotSwap.h"
+#include <onnxruntime_cxx_api.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// On-demand cache of per-voice models. Voice "name" is loaded from
+// <directory>/name.onnx the first time a stream asks for it and stays
+// resident while the total estimated size fits the memory budget; beyond
+// that, the least recently used models with no streams are evicted.
+//
+// acquire() hands out a shared_ptr whose deleter returns the reference to
+// the registry, so a model in use is never evicted and callers treat it like
+// any other LoadedModel. The registry must outlive every handle.
+
+struct RegistryStats
+{
+    size_t hits           = 0;
+    size_t misses         = 0; // acquires that loaded, or waited for, a model
+    size_t loads          = 0;
+    size_t loadFailures   = 0;
+    size_t evictions      = 0;
+    double loadMsTotal    = 0.0;
+    double loadMsMax      = 0.0;
+    size_t residentModels = 0;
+    size_t residentBytes  = 0;
+    size_t budgetBytes    = 0;
+};
+
+std::ostream&
+operator<<(std::ostream& out, const RegistryStats& stats);
+
+class ModelRegistry
+{
+  public:
+    ModelRegistry(Ort::Env& env,
+                  Ort::SessionOptions& options,
+                  const std::string& directory,
+                  size_t budgetBytes,
+                  std::vector<size_t> warmupSizes,
+                  bool mapWeights = false);
+
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    // Blocks while the model loads; throws std::runtime_error if the voice
+    // is unknown or its model fails to load or validate
+    std::shared_ptr<const LoadedModel> acquire(const std::string& voice);
+
+    // The voice's model if it is resident, null otherwise; never loads or
+    // waits for a load
+    std::shared_ptr<const LoadedModel> tryAcquire(const std::string& voice);
+
+    RegistryStats stats() const;
+
+  private:
+    struct Entry
+    {
+        std::shared_ptr<const LoadedModel> model; // null while loading
+        bool loading     = false;
+        size_t bytes     = 0;
+        size_t users     = 0;
+        uint64_t lastUse = 0;
+    };
+
+    std::shared_ptr<const LoadedModel> lease(const std::string& voice,
+                                             Entry& entry);
+    void release(const std::string& voice);
+    std::shared_ptr<const LoadedModel> load(const std::string& voice,
+                                            size_t& bytes);
+    void evictToBudget();
+
+    Ort::Env& env;
+    Ort::SessionOptions& options;
+    std::string directory;
+    std::vector<size_t> warmupSizes;
+    bool mapWeights;
+
+    mutable std::mutex mutex;
+    std::condition_variable loaded;
+    std::mutex loadMutex; // one load at a time keeps the RSS estimate clean
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t clock = 0;
+    uint64_t generation = 0;
+    RegistryStats counters;
+};
@@ -0,0 +1,2215 @@
+#include "NativeEngine.h"
+#include "NativeKernels.h"
+#include "llvc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+using Step   = NativeEngine::Step;
+using Tensor = NativeTensor;
+using Shape  = NativeShape;
+
+[[noreturn]] void
+fail(const Step& step, const std::string& message)
+{
+    throw std::runtime_error("native engine: " + step.node->opType + " " +
+                             step.node->name + ": " + message);
+}
+
+const Tensor&
+input(const Step& step, size_t index)
+{
+    if (index >= step.inputs.size() || !step.inputs[index])
+    {
+        fail(step, "missing input " + std::to_string(index));
+    }
+    return *step.inputs[index];
+}
+
+bool
+hasInput(const Step& step, size_t index)
+{
+    return index < step.inputs.size() && step.inputs[index];
+}
+
+Tensor&
+output(Step& step, size_t index = 0)
+{
+    return *step.outputs[index];
+}
+
+size_t
+normalizeAxis(const Step& step, int64_t axis, size_t rank)
+{
+    int64_t normalized = axis < 0 ? axis + static_cast<int64_t>(rank) : axis;
+    if (normalized < 0 || normalized >= static_cast<int64_t>(rank))
+    {
+        fail(step, "axis out of range");
+    }
+    return static_cast<size_t>(normalized);
+}
+
+// An int64 input as a list (shapes, axes, pads)
+void
+readInts(const Tensor& tensor, std::vector<int64_t>& out)
+{
+    if (tensor.type == ElementType::Int64)
+    {
+        out.assign(tensor.ints.begin(),
+                   tensor.ints.begin() + tensor.shape.count());
+    }
+    else
+    {
+        out.assign(tensor.floats.begin(),
+                   tensor.floats.begin() + tensor.shape.count());
+    }
+}
+
+double
+scalar(const Tensor& tensor)
+{
+    return tensor.type == ElementType::Int64 ? double(tensor.ints[0])
+                                             : double(tensor.floats[0]);
+}
+
+void
+strides(const Shape& shape, int64_t* out)
+{
+    int64_t stride = 1;
+    for (size_t d = shape.rank; d-- > 0;)
+    {
+        out[d] = stride;
+        stride *= shape[d];
+    }
+}
+
+// Strides of `in` aligned to `out`, zero along broadcast dimensions
+void
+broadcastStrides(const Shape& in, const Shape& out, int64_t* result)
+{
+    int64_t own[MAX_RANK];
+    strides(in, own);
+    size_t offset = out.rank - in.rank;
+    for (size_t d = 0; d < out.rank; ++d)
+    {
+        result[d] = d < offset || in[d - offset] == 1 ? 0 : own[d - offset];
+    }
+}
+
+bool
+broadcastShape(const Shape& a, const Shape& b, Shape& out)
+{
+    out.rank = std::max(a.rank, b.rank);
+    for (size_t d = 0; d < out.rank; ++d)
+    {
+        int64_t x = d + a.rank >= out.rank ? a[d + a.rank - out.rank] : 1;
+        int64_t y = d + b.rank >= out.rank ? b[d + b.rank - out.rank] : 1;
+        if (x != y && x != 1 && y != 1)
+        {
+            return false;
+        }
+        out[d] = x == 1 ? y : x;
+    }
+    return true;
+}
+
+// Calls f(outIndex, offset0, offset1, offset2) over every element of
+// `shape`, with offsets advancing by the given strides. Dimensions that are
+// contiguous in all three operands are merged first, and the innermost one
+// runs as a plain loop the compiler can inline `f` into.
+template <typename F>
+void
+forEachIndex(const Shape& shape, const int64_t* const* stride, F f)
+{
+    int64_t extent[MAX_RANK], step[3][MAX_RANK];
+    size_t rank = 0;
+    for (size_t d = 0; d < shape.rank; ++d)
+    {
+        if (shape[d] == 0)
+        {
+            return;
+        }
+        bool merge = rank > 0;
+        for (size_t k = 0; merge && k < 3; ++k)
+        {
+            merge = step[k][rank - 1] == stride[k][d] * shape[d];
+        }
+        if (merge)
+        {
+            extent[rank - 1] *= shape[d];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                step[k][rank - 1] = stride[k][d];
+            }
+            continue;
+        }
+        if (shape[d] == 1)
+        {
+            continue;
+        }
+        extent[rank] = shape[d];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            step[k][rank] = stride[k][d];
+        }
+        ++rank;
+    }
+    if (rank == 0)
+    {
+        f(0, 0, 0, 0);
+        return;
+    }
+
+    size_t inner  = static_cast<size_t>(extent[rank - 1]);
+    int64_t s0    = step[0][rank - 1];
+    int64_t s1    = step[1][rank - 1];
+    int64_t s2    = step[2][rank - 1];
+    size_t total  = 1;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        total *= static_cast<size_t>(extent[d]);
+    }
+    int64_t index[MAX_RANK] = {};
+    int64_t offset[3]       = {};
+    for (size_t n = 0; n < total; n += inner)
+    {
+        for (size_t j = 0; j < inner; ++j)
+        {
+            int64_t i = static_cast<int64_t>(j);
+            f(n + j,
+              offset[0] + i * s0,
+              offset[1] + i * s1,
+              offset[2] + i * s2);
+        }
+        for (size_t d = rank - 1; d-- > 0;)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                offset[k] += step[k][d];
+            }
+            if (++index[d] < extent[d])
+            {
+                break;
+            }
+            for (size_t k = 0; k < 3; ++k)
+            {
+                offset[k] -= step[k][d] * extent[d];
+            }
+            index[d] = 0;
+        }
+    }
+}
+
+template <typename T>
+const T*
+data(const Tensor& tensor);
+
+template <>
+const float*
+data<float>(const Tensor& tensor)
+{
+    return tensor.floats.data();
+}
+
+template <>
+const int64_t*
+data<int64_t>(const Tensor& tensor)
+{
+    return tensor.ints.data();
+}
+
+template <typename T>
+T*
+mutableData(Tensor& tensor);
+
+template <>
+float*
+mutableData<float>(Tensor& tensor)
+{
+    return tensor.floats.data();
+}
+
+template <>
+int64_t*
+mutableData<int64_t>(Tensor& tensor)
+{
+    return tensor.ints.data();
+}
+
+// ---------------------------------------------------------------------------
+// Element-wise
+
+template <typename T, typename R, typename F>
+void
+binaryTyped(Step& step, ElementType resultType, F f)
+{
+    const Tensor& a = input(step, 0);
+    const Tensor& b = input(step, 1);
+    Shape shape;
+    if (!broadcastShape(a.shape, b.shape, shape))
+    {
+        fail(step, "shapes do not broadcast");
+    }
+    Tensor& out = output(step);
+    out.resize(resultType, shape);
+    const T* x = data<T>(a);
+    const T* y = data<T>(b);
+    R* z       = mutableData<R>(out);
+    size_t n   = shape.count();
+
+    if (a.shape.count() == n && b.shape.count() == n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            z[i] = f(x[i], y[i]);
+        }
+    }
+    else if (b.shape.count() == 1)
+    {
+        T value = y[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            z[i] = f(x[i], value);
+        }
+    }
+    else
+    {
+        int64_t sa[MAX_RANK], sb[MAX_RANK], none[MAX_RANK] = {};
+        broadcastStrides(a.shape, shape, sa);
+        broadcastStrides(b.shape, shape, sb);
+        const int64_t* all[3] = { sa, sb, none };
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t q, int64_t) {
+            z[i] = f(x[p], y[q]);
+        });
+    }
+}
+
+template <typename F>
+void
+arithmetic(Step& step, F f)
+{
+    if (input(step, 0).type == ElementType::Int64)
+    {
+        binaryTyped<int64_t, int64_t>(step, ElementType::Int64, f);
+    }
+    else
+    {
+        binaryTyped<float, float>(step, ElementType::Float, f);
+    }
+}
+
+template <typename F>
+void
+comparison(Step& step, F f)
+{
+    auto boolean = [f](auto x, auto y) { return int64_t(f(x, y)); };
+    if (input(step, 0).type == ElementType::Int64)
+    {
+        binaryTyped<int64_t, int64_t>(step, ElementType::Int64, boolean);
+    }
+    else
+    {
+        binaryTyped<float, int64_t>(step, ElementType::Int64, boolean);
+    }
+}
+
+// Same-shape float operands take the vectorized kernels
+template <typename Vectorized, typename F>
+void
+floatArithmetic(Step& step, Vectorized vectorized, F f)
+{
+    const Tensor& a = input(step, 0);
+    const Tensor& b = input(step, 1);
+    if (a.type == ElementType::Float && b.type == ElementType::Float &&
+        a.shape.rank == b.shape.rank &&
+        std::equal(a.shape.dims.begin(),
+                   a.shape.dims.begin() + a.shape.rank,
+                   b.shape.dims.begin()))
+    {
+        Tensor& out = output(step);
+        out.resize(ElementType::Float, a.shape);
+        vectorized(a.floats.data(),
+                   b.floats.data(),
+                   out.floats.data(),
+                   a.shape.count());
+        return;
+    }
+    arithmetic(step, f);
+}
+
+void
+runAdd(Step& step)
+{
+    floatArithmetic(step, addVectors, [](auto x, auto y) { return x + y; });
+}
+
+void
+runSub(Step& step)
+{
+    floatArithmetic(
+      step, subtractVectors, [](auto x, auto y) { return x - y; });
+}
+
+void
+runMul(Step& step)
+{
+    floatArithmetic(
+      step, multiplyVectors, [](auto x, auto y) { return x * y; });
+}
+
+void
+runDiv(Step& step)
+{
+    arithmetic(step, [](auto x, auto y) { return x / y; });
+}
+
+void
+runPow(Step& step)
+{
+    binaryTyped<float, float>(step, ElementType::Float, [](float x, float y) {
+        return y == 2.0f ? x * x : std::pow(x, y);
+    });
+}
+
+void
+runMax(Step& step)
+{
+    arithmetic(step, [](auto x, auto y) { return std::max(x, y); });
+}
+
+void
+runMin(Step& step)
+{
+    arithmetic(step, [](auto x, auto y) { return std::min(x, y); });
+}
+
+void
+runPRelu(Step& step)
+{
+    binaryTyped<float, float>(
+      step, ElementType::Float, [](float x, float slope) {
+          return x < 0.0f ? x * slope : x;
+      });
+}
+
+void
+runEqual(Step& step)
+{
+    comparison(step, [](auto x, auto y) { return x == y; });
+}
+
+void
+runLess(Step& step)
+{
+    comparison(step, [](auto x, auto y) { return x < y; });
+}
+
+void
+runGreater(Step& step)
+{
+    comparison(step, [](auto x, auto y) { return x > y; });
+}
+
+void
+runWhere(Step& step)
+{
+    const Tensor& condition = input(step, 0);
+    const Tensor& a         = input(step, 1);
+    const Tensor& b         = input(step, 2);
+    Shape partial, shape;
+    if (!broadcastShape(condition.shape, a.shape, partial) ||
+        !broadcastShape(partial, b.shape, shape))
+    {
+        fail(step, "shapes do not broadcast");
+    }
+    Tensor& out = output(step);
+    out.resize(a.type, shape);
+    int64_t sc[MAX_RANK], sa[MAX_RANK], sb[MAX_RANK];
+    broadcastStrides(condition.shape, shape, sc);
+    broadcastStrides(a.shape, shape, sa);
+    broadcastStrides(b.shape, shape, sb);
+    const int64_t* all[3] = { sc, sa, sb };
+    const int64_t* c      = condition.ints.data();
+    if (a.type == ElementType::Float)
+    {
+        forEachIndex(
+          shape, all, [&](size_t i, int64_t p, int64_t q, int64_t r) {
+              out.floats[i] = c[p] ? a.floats[q] : b.floats[r];
+          });
+    }
+    else
+    {
+        forEachIndex(
+          shape, all, [&](size_t i, int64_t p, int64_t q, int64_t r) {
+              out.ints[i] = c[p] ? a.ints[q] : b.ints[r];
+          });
+    }
+}
+
+template <typename F>
+void
+unary(Step& step, F f)
+{
+    const Tensor& x = input(step, 0);
+    Tensor& out     = output(step);
+    out.resize(ElementType::Float, x.shape);
+    size_t n = x.shape.count();
+    for (size_t i = 0; i < n; ++i)
+    {
+        out.floats[i] = f(x.floats[i]);
+    }
+}
+
+// For operators with a vectorized kernel in NativeKernels.h
+void
+unaryVector(Step& step, void (*kernel)(const float*, float*, size_t))
+{
+    const Tensor& x = input(step, 0);
+    Tensor& out     = output(step);
+    out.resize(ElementType::Float, x.shape);
+    kernel(x.floats.data(), out.floats.data(), x.shape.count());
+}
+
+void
+runRelu(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    Tensor& out     = output(step);
+    out.resize(ElementType::Float, x.shape);
+    relu(x.floats.data(), out.floats.data(), x.shape.count());
+}
+
+void
+runLeakyRelu(Step& step)
+{
+    float alpha = step.node->floatAttr("alpha", 0.01f);
+    unary(step, [alpha](float x) { return x < 0.0f ? alpha * x : x; });
+}
+
+void
+runElu(Step& step)
+{
+    float alpha = step.node->floatAttr("alpha", 1.0f);
+    unary(step, [alpha](float x) {
+        return x < 0.0f ? alpha * (std::exp(x) - 1.0f) : x;
+    });
+}
+
+void
+runSigmoid(Step& step)
+{
+    unaryVector(step, sigmoidVector);
+}
+
+void
+runTanh(Step& step)
+{
+    unaryVector(step, tanhVector);
+}
+
+void
+runErf(Step& step)
+{
+    unaryVector(step, erfVector);
+}
+
+void
+runGelu(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    Tensor& out     = output(step);
+    out.resize(ElementType::Float, x.shape);
+    size_t n        = x.shape.count();
+    const float* in = x.floats.data();
+    float* y        = out.floats.data();
+
+    // y = 0.5 x (1 + erf(x / sqrt(2))), or the tanh approximation
+    auto found = step.node->attributes.find("approximate");
+    if (found != step.node->attributes.end() && found->second.s == "tanh")
+    {
+        const float k = 0.7978845608f; // sqrt(2 / pi)
+        for (size_t i = 0; i < n; ++i)
+        {
+            y[i] = k * (in[i] + 0.044715f * in[i] * in[i] * in[i]);
+        }
+        tanhVector(y, y, n);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            y[i] = in[i] * 0.70710678f;
+        }
+        erfVector(y, y, n);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        y[i] = 0.5f * in[i] * (1.0f + y[i]);
+    }
+}
+
+void
+runSoftplus(Step& step)
+{
+    unary(step, [](float x) { return std::log1p(std::exp(x)); });
+}
+
+void
+runSqrt(Step& step)
+{
+    unary(step, [](float x) { return std::sqrt(x); });
+}
+
+void
+runExp(Step& step)
+{
+    unaryVector(step, expVector);
+}
+
+void
+runLog(Step& step)
+{
+    unary(step, [](float x) { return std::log(x); });
+}
+
+void
+runReciprocal(Step& step)
+{
+    unary(step, [](float x) { return 1.0f / x; });
+}
+
+void
+runNeg(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    if (x.type == ElementType::Int64)
+    {
+        Tensor& out = output(step);
+        out.resize(ElementType::Int64, x.shape);
+        for (size_t i = 0; i < x.shape.count(); ++i)
+        {
+            out.ints[i] = -x.ints[i];
+        }
+        return;
+    }
+    unary(step, [](float v) { return -v; });
+}
+
+void
+runAbs(Step& step)
+{
+    unary(step, [](float x) { return std::fabs(x); });
+}
+
+void
+runClip(Step& step)
+{
+    // Bounds are attributes before opset 11 and optional inputs after
+    const float largest = std::numeric_limits<float>::max();
+    float low           = step.node->floatAttr("min", -largest);
+    float high          = step.node->floatAttr("max", largest);
+    if (hasInput(step, 1))
+    {
+        low = static_cast<float>(scalar(input(step, 1)));
+    }
+    if (hasInput(step, 2))
+    {
+        high = static_cast<float>(scalar(input(step, 2)));
+    }
+    unary(step,
+          [low, high](float x) { return std::min(std::max(x, low), high); });
+}
+
+// ---------------------------------------------------------------------------
+// Shapes and data movement
+
+void
+copyTensor(const Tensor& from, Tensor& to, const Shape& shape)
+{
+    to.resize(from.type, shape);
+    size_t n = shape.count();
+    if (from.type == ElementType::Float)
+    {
+        std::copy(
+          from.floats.begin(), from.floats.begin() + n, to.floats.begin());
+    }
+    else
+    {
+        std::copy(from.ints.begin(), from.ints.begin() + n, to.ints.begin());
+    }
+}
+
+void
+runIdentity(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    copyTensor(x, output(step), x.shape);
+}
+
+void
+runConstant(Step& step)
+{
+    const OnnxNode& node = *step.node;
+    Tensor& out          = output(step);
+    Shape shape;
+    auto attribute = [&](const char* key) {
+        auto it = node.attributes.find(key);
+        return it == node.attributes.end() ? nullptr : &it->second;
+    };
+    if (const OnnxAttribute* value = attribute("value"))
+    {
+        if (value->tensors.empty())
+        {
+            fail(step, "value has no tensor");
+        }
+        const OnnxTensor& tensor = value->tensors[0];
+        shape.rank               = tensor.shape.size();
+        std::copy(tensor.shape.begin(), tensor.shape.end(), shape.dims.begin());
+        out.resize(tensor.type, shape);
+        out.floats = tensor.floats;
+        out.ints   = tensor.ints;
+    }
+    else if (const OnnxAttribute* value = attribute("value_float"))
+    {
+        out.resize(ElementType::Float, shape);
+        out.floats[0] = value->f;
+    }
+    else if (const OnnxAttribute* value = attribute("value_floats"))
+    {
+        shape.rank = 1;
+        shape[0]   = static_cast<int64_t>(value->floats.size());
+        out.resize(ElementType::Float, shape);
+        out.floats = value->floats;
+    }
+    else if (const OnnxAttribute* value = attribute("value_int"))
+    {
+        out.resize(ElementType::Int64, shape);
+        out.ints[0] = value->i;
+    }
+    else if (const OnnxAttribute* value = attribute("value_ints"))
+    {
+        shape.rank = 1;
+        shape[0]   = static_cast<int64_t>(value->ints.size());
+        out.resize(ElementType::Int64, shape);
+        out.ints = value->ints;
+    }
+    else
+    {
+        fail(step, "unsupported constant attribute");
+    }
+}
+
+void
+runConstantOfShape(Step& step)
+{
+    std::vector<int64_t> dims;
+    readInts(input(step, 0), dims);
+    Shape shape;
+    shape.rank = dims.size();
+    std::copy(dims.begin(), dims.end(), shape.dims.begin());
+
+    Tensor& out = output(step);
+    auto it     = step.node->attributes.find("value");
+    if (it != step.node->attributes.end() && !it->second.tensors.empty() &&
+        it->second.tensors[0].type == ElementType::Int64)
+    {
+        out.resize(ElementType::Int64, shape);
+        std::fill(
+          out.ints.begin(), out.ints.end(), it->second.tensors[0].ints[0]);
+        return;
+    }
+    float value = 0.0f;
+    if (it != step.node->attributes.end() && !it->second.tensors.empty())
+    {
+        value = it->second.tensors[0].floats[0];
+    }
+    out.resize(ElementType::Float, shape);
+    std::fill(out.floats.begin(), out.floats.end(), value);
+}
+
+void
+runShape(Step& step)
+{
+    const Shape& in = input(step, 0).shape;
+    int64_t rank    = static_cast<int64_t>(in.rank);
+    int64_t start   = step.node->intAttr("start", 0);
+    int64_t end     = step.node->intAttr("end", rank);
+    start = std::clamp<int64_t>(start < 0 ? start + rank : start, 0, rank);
+    end   = std::clamp<int64_t>(end < 0 ? end + rank : end, 0, rank);
+
+    Shape shape;
+    shape.rank = 1;
+    shape[0]   = std::max<int64_t>(end - start, 0);
+    Tensor& out = output(step);
+    out.resize(ElementType::Int64, shape);
+    for (int64_t d = start; d < end; ++d)
+    {
+        out.ints[d - start] = in[d];
+    }
+}
+
+void
+runCast(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    Tensor& out     = output(step);
+    int64_t to      = step.node->intAttr("to", 1);
+    size_t n        = x.shape.count();
+    if (to == 1 || to == 11) // float, double
+    {
+        out.resize(ElementType::Float, x.shape);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out.floats[i] = x.type == ElementType::Float
+                              ? x.floats[i]
+                              : static_cast<float>(x.ints[i]);
+        }
+    }
+    else if (to == 6 || to == 7 || to == 9) // int32, int64, bool
+    {
+        out.resize(ElementType::Int64, x.shape);
+        for (size_t i = 0; i < n; ++i)
+        {
+            int64_t value = x.type == ElementType::Int64
+                              ? x.ints[i]
+                              : static_cast<int64_t>(x.floats[i]);
+            out.ints[i]   = to == 9 ? value != 0 : value;
+        }
+    }
+    else
+    {
+        fail(step, "unsupported target type " + std::to_string(to));
+    }
+}
+
+void
+reshapeTo(Step& step, const Shape& shape)
+{
+    const Tensor& x = input(step, 0);
+    if (shape.count() != x.shape.count())
+    {
+        fail(step, "element count changes");
+    }
+    copyTensor(x, output(step), shape);
+}
+
+void
+runReshape(Step& step)
+{
+    const Tensor& x      = input(step, 0);
+    const Tensor& target = input(step, 1);
+    Shape shape;
+    shape.rank    = target.shape.count();
+    int64_t known = 1;
+    int64_t infer = -1;
+    for (size_t d = 0; d < shape.rank; ++d)
+    {
+        int64_t dim = target.ints[d];
+        if (dim == 0 && !step.node->intAttr("allowzero", 0))
+        {
+            dim = x.shape[d];
+        }
+        if (dim == -1)
+        {
+            infer = static_cast<int64_t>(d);
+            dim   = 1;
+        }
+        shape[d] = dim;
+        known *= dim;
+    }
+    if (infer >= 0)
+    {
+        shape[infer] =
+          known ? static_cast<int64_t>(x.shape.count()) / known : 0;
+    }
+    reshapeTo(step, shape);
+}
+
+void
+runFlatten(Step& step)
+{
+    const Shape& in = input(step, 0).shape;
+    size_t axis     = in.rank ? normalizeAxis(step,
+                                          step.node->intAttr("axis", 1),
+                                          in.rank + 1)
+                              : 0;
+    Shape shape;
+    shape.rank = 2;
+    shape[0]   = 1;
+    shape[1]   = 1;
+    for (size_t d = 0; d < in.rank; ++d)
+    {
+        shape[d < axis ? 0 : 1] *= in[d];
+    }
+    reshapeTo(step, shape);
+}
+
+void
+axesFor(Step& step, std::vector<int64_t>& axes)
+{
+    axes = step.node->intsAttr("axes");
+    if (hasInput(step, 1))
+    {
+        readInts(input(step, 1), axes);
+    }
+}
+
+void
+runUnsqueeze(Step& step)
+{
+    const Shape& in = input(step, 0).shape;
+    std::vector<int64_t> axes;
+    axesFor(step, axes);
+    Shape shape;
+    shape.rank = in.rank + axes.size();
+    std::vector<bool> inserted(shape.rank, false);
+    for (int64_t axis : axes)
+    {
+        inserted[normalizeAxis(step, axis, shape.rank)] = true;
+    }
+    for (size_t d = 0, source = 0; d < shape.rank; ++d)
+    {
+        shape[d] = inserted[d] ? 1 : in[source++];
+    }
+    reshapeTo(step, shape);
+}
+
+void
+runSqueeze(Step& step)
+{
+    const Shape& in = input(step, 0).shape;
+    std::vector<int64_t> axes;
+    axesFor(step, axes);
+    std::vector<bool> removed(in.rank, axes.empty());
+    for (int64_t axis : axes)
+    {
+        removed[normalizeAxis(step, axis, in.rank)] = true;
+    }
+    Shape shape;
+    for (size_t d = 0; d < in.rank; ++d)
+    {
+        if (!(removed[d] && in[d] == 1))
+        {
+            shape[shape.rank++] = in[d];
+        }
+    }
+    reshapeTo(step, shape);
+}
+
+// Copies `rows` runs of `length` elements
+template <typename T>
+void
+copyRows(const T* from,
+         size_t fromStride,
+         T* to,
+         size_t toStride,
+         size_t rows,
+         size_t length)
+{
+    for (size_t r = 0; r < rows; ++r)
+    {
+        std::memcpy(
+          to + r * toStride, from + r * fromStride, length * sizeof(T));
+    }
+}
+
+void
+runConcat(Step& step)
+{
+    const Tensor& first = input(step, 0);
+    size_t axis =
+      normalizeAxis(step, step.node->intAttr("axis", 0), first.shape.rank);
+    Shape shape = first.shape;
+    shape[axis] = 0;
+    for (const Tensor* part : step.inputs)
+    {
+        shape[axis] += part->shape[axis];
+    }
+    Tensor& out = output(step);
+    out.resize(first.type, shape);
+
+    size_t outer = 1, inner = 1;
+    for (size_t d = 0; d < axis; ++d)
+    {
+        outer *= shape[d];
+    }
+    for (size_t d = axis + 1; d < shape.rank; ++d)
+    {
+        inner *= shape[d];
+    }
+    size_t outRow = shape[axis] * inner;
+    size_t offset = 0;
+    for (const Tensor* part : step.inputs)
+    {
+        size_t row = part->shape[axis] * inner;
+        if (first.type == ElementType::Float)
+        {
+            copyRows(part->floats.data(),
+                     row,
+                     out.floats.data() + offset,
+                     outRow,
+                     outer,
+                     row);
+        }
+        else
+        {
+            copyRows(part->ints.data(),
+                     row,
+                     out.ints.data() + offset,
+                     outRow,
+                     outer,
+                     row);
+        }
+        offset += row;
+    }
+}
+
+void
+runSplit(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    size_t axis =
+      normalizeAxis(step, step.node->intAttr("axis", 0), x.shape.rank);
+    std::vector<int64_t> sizes = step.node->intsAttr("split");
+    if (hasInput(step, 1))
+    {
+        readInts(input(step, 1), sizes);
+    }
+    if (sizes.empty())
+    {
+        size_t parts = step.outputs.size();
+        int64_t size = (x.shape[axis] + parts - 1) / parts;
+        for (size_t i = 0; i < parts; ++i)
+        {
+            sizes.push_back(std::min<int64_t>(size, x.shape[axis] - size * i));
+        }
+    }
+
+    size_t outer = 1, inner = 1;
+    for (size_t d = 0; d < axis; ++d)
+    {
+        outer *= x.shape[d];
+    }
+    for (size_t d = axis + 1; d < x.shape.rank; ++d)
+    {
+        inner *= x.shape[d];
+    }
+    size_t inRow  = x.shape[axis] * inner;
+    size_t offset = 0;
+    for (size_t i = 0; i < step.outputs.size(); ++i)
+    {
+        Shape shape = x.shape;
+        shape[axis] = sizes[i];
+        Tensor& out = output(step, i);
+        out.resize(x.type, shape);
+        size_t row = sizes[i] * inner;
+        if (x.type == ElementType::Float)
+        {
+            copyRows(x.floats.data() + offset,
+                     inRow,
+                     out.floats.data(),
+                     row,
+                     outer,
+                     row);
+        }
+        else
+        {
+            copyRows(x.ints.data() + offset,
+                     inRow,
+                     out.ints.data(),
+                     row,
+                     outer,
+                     row);
+        }
+        offset += row;
+    }
+}
+
+void
+runSlice(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    size_t rank     = x.shape.rank;
+    std::vector<int64_t> starts, ends, axes, steps;
+    if (hasInput(step, 1))
+    {
+        readInts(input(step, 1), starts);
+        readInts(input(step, 2), ends);
+        if (hasInput(step, 3))
+        {
+            readInts(input(step, 3), axes);
+        }
+        if (hasInput(step, 4))
+        {
+            readInts(input(step, 4), steps);
+        }
+    }
+    else // opset 1 attributes
+    {
+        starts = step.node->intsAttr("starts");
+        ends   = step.node->intsAttr("ends");
+        axes   = step.node->intsAttr("axes");
+    }
+
+    int64_t begin[MAX_RANK], stride[MAX_RANK];
+    Shape shape = x.shape;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        begin[d]  = 0;
+        stride[d] = 1;
+    }
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+        size_t axis = axes.empty() ? i : normalizeAxis(step, axes[i], rank);
+        int64_t dim = x.shape[axis];
+        int64_t s   = steps.empty() ? 1 : steps[i];
+        int64_t b   = starts[i] < 0 ? starts[i] + dim : starts[i];
+        int64_t e   = ends[i] < 0 ? ends[i] + dim : ends[i];
+        if (s > 0)
+        {
+            b = std::clamp<int64_t>(b, 0, dim);
+            e = std::clamp<int64_t>(e, 0, dim);
+            shape[axis] = std::max<int64_t>((e - b + s - 1) / s, 0);
+        }
+        else if (s < 0)
+        {
+            b = std::clamp<int64_t>(b, -1, dim - 1);
+            e = std::clamp<int64_t>(e, -1, dim - 1);
+            shape[axis] = std::max<int64_t>((b - e - s - 1) / -s, 0);
+        }
+        else
+        {
+            fail(step, "zero step");
+        }
+        begin[axis]  = b;
+        stride[axis] = s;
+    }
+
+    Tensor& out = output(step);
+    out.resize(x.type, shape);
+    int64_t own[MAX_RANK], in[MAX_RANK], none[MAX_RANK] = {};
+    strides(x.shape, own);
+    int64_t base = 0;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        in[d] = own[d] * stride[d];
+        base += begin[d] * own[d];
+    }
+
+    // Contiguous innermost runs are copied whole
+    size_t inner = 1;
+    Shape outerShape = shape;
+    if (rank > 0 && stride[rank - 1] == 1)
+    {
+        inner                     = shape[rank - 1];
+        outerShape[rank - 1]      = 1;
+    }
+    const int64_t* all[3] = { in, none, none };
+    if (x.type == ElementType::Float)
+    {
+        const float* from = x.floats.data() + base;
+        float* to         = out.floats.data();
+        forEachIndex(
+          outerShape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+              std::memcpy(to + i * inner, from + p, inner * sizeof(float));
+          });
+    }
+    else
+    {
+        const int64_t* from = x.ints.data() + base;
+        int64_t* to         = out.ints.data();
+        forEachIndex(
+          outerShape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+              std::memcpy(to + i * inner, from + p, inner * sizeof(int64_t));
+          });
+    }
+}
+
+void
+runTranspose(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    size_t rank     = x.shape.rank;
+    std::vector<int64_t> perm = step.node->intsAttr("perm");
+    if (perm.empty())
+    {
+        for (size_t d = rank; d-- > 0;)
+        {
+            perm.push_back(static_cast<int64_t>(d));
+        }
+    }
+    Shape shape;
+    shape.rank = rank;
+    int64_t own[MAX_RANK], in[MAX_RANK], none[MAX_RANK] = {};
+    strides(x.shape, own);
+    for (size_t d = 0; d < rank; ++d)
+    {
+        shape[d] = x.shape[perm[d]];
+        in[d]    = own[perm[d]];
+    }
+    Tensor& out = output(step);
+    out.resize(x.type, shape);
+
+    // Swapping the last two axes is a batch of blocked matrix transposes
+    bool lastTwo = rank >= 2 && x.type == ElementType::Float &&
+                   perm[rank - 2] == static_cast<int64_t>(rank - 1) &&
+                   perm[rank - 1] == static_cast<int64_t>(rank - 2);
+    for (size_t d = 0; lastTwo && d + 2 < rank; ++d)
+    {
+        lastTwo = perm[d] == static_cast<int64_t>(d);
+    }
+    if (lastTwo)
+    {
+        size_t rows = x.shape[rank - 2], columns = x.shape[rank - 1];
+        size_t batch = rows && columns ? x.shape.count() / (rows * columns) : 0;
+        for (size_t b = 0; b < batch; ++b)
+        {
+            transposeMatrix(x.floats.data() + b * rows * columns,
+                            out.floats.data() + b * rows * columns,
+                            rows,
+                            columns);
+        }
+        return;
+    }
+
+    const int64_t* all[3] = { in, none, none };
+    if (x.type == ElementType::Float)
+    {
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+            out.floats[i] = x.floats[p];
+        });
+    }
+    else
+    {
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+            out.ints[i] = x.ints[p];
+        });
+    }
+}
+
+void
+runGather(Step& step)
+{
+    const Tensor& x       = input(step, 0);
+    const Tensor& indices = input(step, 1);
+    size_t axis =
+      normalizeAxis(step, step.node->intAttr("axis", 0), x.shape.rank);
+    Shape shape;
+    for (size_t d = 0; d < axis; ++d)
+    {
+        shape[shape.rank++] = x.shape[d];
+    }
+    for (size_t d = 0; d < indices.shape.rank; ++d)
+    {
+        shape[shape.rank++] = indices.shape[d];
+    }
+    for (size_t d = axis + 1; d < x.shape.rank; ++d)
+    {
+        shape[shape.rank++] = x.shape[d];
+    }
+
+    size_t outer = 1, inner = 1;
+    for (size_t d = 0; d < axis; ++d)
+    {
+        outer *= x.shape[d];
+    }
+    for (size_t d = axis + 1; d < x.shape.rank; ++d)
+    {
+        inner *= x.shape[d];
+    }
+    int64_t dim  = x.shape[axis];
+    size_t count = indices.shape.count();
+    Tensor& out  = output(step);
+    out.resize(x.type, shape);
+    for (size_t o = 0; o < outer; ++o)
+    {
+        for (size_t j = 0; j < count; ++j)
+        {
+            int64_t index = indices.ints[j] < 0 ? indices.ints[j] + dim
+                                                : indices.ints[j];
+            if (index < 0 || index >= dim)
+            {
+                fail(step, "index out of range");
+            }
+            size_t from = (o * dim + index) * inner;
+            size_t to   = (o * count + j) * inner;
+            if (x.type == ElementType::Float)
+            {
+                std::memcpy(
+                  &out.floats[to], &x.floats[from], inner * sizeof(float));
+            }
+            else
+            {
+                std::memcpy(
+                  &out.ints[to], &x.ints[from], inner * sizeof(int64_t));
+            }
+        }
+    }
+}
+
+void
+runExpand(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    std::vector<int64_t> dims;
+    readInts(input(step, 1), dims);
+    Shape target;
+    target.rank = dims.size();
+    std::copy(dims.begin(), dims.end(), target.dims.begin());
+    Shape shape;
+    if (!broadcastShape(x.shape, target, shape))
+    {
+        fail(step, "shapes do not broadcast");
+    }
+    Tensor& out = output(step);
+    out.resize(x.type, shape);
+    int64_t in[MAX_RANK], none[MAX_RANK] = {};
+    broadcastStrides(x.shape, shape, in);
+    const int64_t* all[3] = { in, none, none };
+    if (x.type == ElementType::Float)
+    {
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+            out.floats[i] = x.floats[p];
+        });
+    }
+    else
+    {
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+            out.ints[i] = x.ints[p];
+        });
+    }
+}
+
+void
+runRange(Step& step)
+{
+    double start = scalar(input(step, 0));
+    double limit = scalar(input(step, 1));
+    double delta = scalar(input(step, 2));
+    Shape shape;
+    shape.rank = 1;
+    shape[0]   = std::max<int64_t>(
+      static_cast<int64_t>(std::ceil((limit - start) / delta)), 0);
+    Tensor& out = output(step);
+    out.resize(input(step, 0).type, shape);
+    for (int64_t i = 0; i < shape[0]; ++i)
+    {
+        double value = start + delta * i;
+        if (out.type == ElementType::Float)
+        {
+            out.floats[i] = static_cast<float>(value);
+        }
+        else
+        {
+            out.ints[i] = static_cast<int64_t>(value);
+        }
+    }
+}
+
+void
+runPad(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    auto mode       = step.node->attributes.find("mode");
+    if (mode != step.node->attributes.end() && mode->second.s != "constant")
+    {
+        fail(step, "only constant padding is supported");
+    }
+    std::vector<int64_t> pads = step.node->intsAttr("pads");
+    float value               = step.node->floatAttr("value", 0.0f);
+    if (hasInput(step, 1))
+    {
+        readInts(input(step, 1), pads);
+    }
+    if (hasInput(step, 2))
+    {
+        value = static_cast<float>(scalar(input(step, 2)));
+    }
+    size_t rank = x.shape.rank;
+    if (pads.size() != 2 * rank || x.type != ElementType::Float)
+    {
+        fail(step, "pads must cover every axis of a float tensor");
+    }
+
+    Shape shape = x.shape;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        shape[d] += pads[d] + pads[d + rank];
+    }
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, shape);
+    std::fill(out.floats.begin(), out.floats.begin() + shape.count(), value);
+
+    // Walk the input, dropping elements cropped by negative pads
+    int64_t own[MAX_RANK], none[MAX_RANK] = {};
+    strides(shape, own);
+    const int64_t* all[3] = { own, none, none };
+    int64_t origin        = 0;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        origin += pads[d] * own[d];
+    }
+    int64_t index[MAX_RANK] = {};
+    forEachIndex(x.shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+        bool inside = true;
+        for (size_t d = 0; d < rank; ++d)
+        {
+            int64_t at = index[d] + pads[d];
+            inside     = inside && at >= 0 && at < shape[d];
+        }
+        if (inside)
+        {
+            out.floats[origin + p] = x.floats[i];
+        }
+        for (size_t d = rank; d-- > 0;)
+        {
+            if (++index[d] < x.shape[d])
+            {
+                break;
+            }
+            index[d] = 0;
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Reductions and normalization
+
+template <typename Init, typename Accumulate, typename Finish>
+void
+reduce(Step& step, Init init, Accumulate accumulate, Finish finish)
+{
+    const Tensor& x = input(step, 0);
+    size_t rank     = x.shape.rank;
+    std::vector<int64_t> axes = step.node->intsAttr("axes");
+    if (hasInput(step, 1))
+    {
+        readInts(input(step, 1), axes);
+    }
+    bool keep = step.node->intAttr("keepdims", 1) != 0;
+    if (axes.empty() && step.node->intAttr("noop_with_empty_axes", 0))
+    {
+        runIdentity(step);
+        return;
+    }
+
+    bool reduced[MAX_RANK] = {};
+    for (size_t d = 0; d < rank; ++d)
+    {
+        reduced[d] = axes.empty();
+    }
+    for (int64_t axis : axes)
+    {
+        reduced[normalizeAxis(step, axis, rank)] = true;
+    }
+
+    Shape kept, shape;
+    kept.rank = rank;
+    size_t group = 1;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        kept[d] = reduced[d] ? 1 : x.shape[d];
+        group *= reduced[d] ? x.shape[d] : 1;
+        if (!reduced[d] || keep)
+        {
+            shape[shape.rank++] = kept[d];
+        }
+    }
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, shape);
+    std::fill(out.floats.begin(), out.floats.begin() + shape.count(), init);
+
+    int64_t to[MAX_RANK], none[MAX_RANK] = {};
+    broadcastStrides(kept, x.shape, to);
+    const int64_t* all[3] = { to, none, none };
+    forEachIndex(x.shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+        out.floats[p] = accumulate(out.floats[p], x.floats[i]);
+    });
+    for (size_t i = 0; i < shape.count(); ++i)
+    {
+        out.floats[i] = finish(out.floats[i], group);
+    }
+}
+
+void
+runReduceMean(Step& step)
+{
+    reduce(
+      step,
+      0.0f,
+      [](float a, float x) { return a + x; },
+      [](float a, size_t n) { return a / n; });
+}
+
+void
+runReduceSum(Step& step)
+{
+    reduce(
+      step,
+      0.0f,
+      [](float a, float x) { return a + x; },
+      [](float a, size_t) { return a; });
+}
+
+void
+runReduceMax(Step& step)
+{
+    reduce(
+      step,
+      -std::numeric_limits<float>::infinity(),
+      [](float a, float x) { return std::max(a, x); },
+      [](float a, size_t) { return a; });
+}
+
+// Views `shape` as [outer][axis][inner]
+void
+splitAround(const Shape& shape, size_t axis, size_t& outer, size_t& inner)
+{
+    outer = inner = 1;
+    for (size_t d = 0; d < axis; ++d)
+    {
+        outer *= shape[d];
+    }
+    for (size_t d = axis + 1; d < shape.rank; ++d)
+    {
+        inner *= shape[d];
+    }
+}
+
+void
+runSoftmax(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    size_t axis =
+      normalizeAxis(step, step.node->intAttr("axis", -1), x.shape.rank);
+    size_t outer, inner;
+    splitAround(x.shape, axis, outer, inner);
+    size_t n    = x.shape[axis];
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, x.shape);
+    for (size_t o = 0; o < outer; ++o)
+    {
+        for (size_t i = 0; i < inner; ++i)
+        {
+            const float* in = x.floats.data() + o * n * inner + i;
+            float* result   = out.floats.data() + o * n * inner + i;
+            float peak      = -std::numeric_limits<float>::infinity();
+            for (size_t k = 0; k < n; ++k)
+            {
+                peak = std::max(peak, in[k * inner]);
+            }
+            float sum = 0.0f;
+            for (size_t k = 0; k < n; ++k)
+            {
+                result[k * inner] = std::exp(in[k * inner] - peak);
+                sum += result[k * inner];
+            }
+            for (size_t k = 0; k < n; ++k)
+            {
+                result[k * inner] /= sum;
+            }
+        }
+    }
+}
+
+void
+runLayerNormalization(Step& step)
+{
+    const Tensor& x = input(step, 0);
+    const Tensor& scale = input(step, 1);
+    size_t axis =
+      normalizeAxis(step, step.node->intAttr("axis", -1), x.shape.rank);
+    float epsilon = step.node->floatAttr("epsilon", 1e-5f);
+    size_t rows = 1, width = 1;
+    for (size_t d = 0; d < x.shape.rank; ++d)
+    {
+        (d < axis ? rows : width) *= x.shape[d];
+    }
+    const float* bias = hasInput(step, 2) ? input(step, 2).floats.data()
+                                          : nullptr;
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, x.shape);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        const float* in = x.floats.data() + r * width;
+        float* result   = out.floats.data() + r * width;
+        float mean      = 0.0f;
+        for (size_t i = 0; i < width; ++i)
+        {
+            mean += in[i];
+        }
+        mean /= width;
+        float variance = 0.0f;
+        for (size_t i = 0; i < width; ++i)
+        {
+            variance += (in[i] - mean) * (in[i] - mean);
+        }
+        float norm = 1.0f / std::sqrt(variance / width + epsilon);
+        for (size_t i = 0; i < width; ++i)
+        {
+            result[i] = (in[i] - mean) * norm * scale.floats[i] +
+                        (bias ? bias[i] : 0.0f);
+        }
+    }
+}
+
+void
+runBatchNormalization(Step& step)
+{
+    const Tensor& x    = input(step, 0);
+    const float* scale = input(step, 1).floats.data();
+    const float* bias  = input(step, 2).floats.data();
+    const float* mean  = input(step, 3).floats.data();
+    const float* var   = input(step, 4).floats.data();
+    float epsilon      = step.node->floatAttr("epsilon", 1e-5f);
+    size_t outer, inner;
+    splitAround(x.shape, 1, outer, inner);
+    size_t channels = x.shape[1];
+    Tensor& out     = output(step);
+    out.resize(ElementType::Float, x.shape);
+    for (size_t o = 0; o < outer; ++o)
+    {
+        for (size_t c = 0; c < channels; ++c)
+        {
+            float gain    = scale[c] / std::sqrt(var[c] + epsilon);
+            float shift   = bias[c] - mean[c] * gain;
+            size_t offset = (o * channels + c) * inner;
+            for (size_t i = 0; i < inner; ++i)
+            {
+                out.floats[offset + i] = x.floats[offset + i] * gain + shift;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Linear algebra and convolution
+
+void
+runMatMul(Step& step)
+{
+    const Tensor& a = input(step, 0);
+    const Tensor& b = input(step, 1);
+    if (a.shape.rank < 1 || b.shape.rank < 1)
+    {
+        fail(step, "scalar operands");
+    }
+    // 1-D operands are promoted to matrices and the extra axis dropped
+    Shape sa = a.shape, sb = b.shape;
+    if (sa.rank == 1)
+    {
+        sa.rank = 2;
+        sa[1]   = sa[0];
+        sa[0]   = 1;
+    }
+    if (sb.rank == 1)
+    {
+        sb.rank = 2;
+        sb[1]   = 1;
+    }
+    size_t M = sa[sa.rank - 2], K = sa[sa.rank - 1], N = sb[sb.rank - 1];
+    if (static_cast<int64_t>(K) != sb[sb.rank - 2])
+    {
+        fail(step, "inner dimensions differ");
+    }
+
+    Shape batchA = sa, batchB = sb, batch;
+    batchA.rank -= 2;
+    batchB.rank -= 2;
+    if (!broadcastShape(batchA, batchB, batch))
+    {
+        fail(step, "batch dimensions do not broadcast");
+    }
+    Shape shape;
+    for (size_t d = 0; d < batch.rank; ++d)
+    {
+        shape[shape.rank++] = batch[d];
+    }
+    if (a.shape.rank > 1)
+    {
+        shape[shape.rank++] = M;
+    }
+    if (b.shape.rank > 1)
+    {
+        shape[shape.rank++] = N;
+    }
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, shape);
+
+    int64_t stepA[MAX_RANK], stepB[MAX_RANK], stepC[MAX_RANK];
+    broadcastStrides(batchA, batch, stepA);
+    broadcastStrides(batchB, batch, stepB);
+    strides(batch, stepC);
+    const int64_t* all[3] = { stepA, stepB, stepC };
+    forEachIndex(batch, all, [&](size_t, int64_t p, int64_t q, int64_t r) {
+        gemm(M,
+             N,
+             K,
+             a.floats.data() + p * M * K,
+             K,
+             b.floats.data() + q * K * N,
+             N,
+             out.floats.data() + r * M * N,
+             N,
+             false);
+    });
+}
+
+void
+runGemm(Step& step)
+{
+    const Tensor& a = input(step, 0);
+    const Tensor& b = input(step, 1);
+    float alpha     = step.node->floatAttr("alpha", 1.0f);
+    float beta      = step.node->floatAttr("beta", 1.0f);
+    bool transA     = step.node->intAttr("transA", 0) != 0;
+    bool transB     = step.node->intAttr("transB", 0) != 0;
+    if (transA)
+    {
+        fail(step, "transA is not supported");
+    }
+    size_t M = a.shape[0], K = a.shape[1];
+    size_t N = transB ? b.shape[0] : b.shape[1];
+    Shape shape;
+    shape.rank  = 2;
+    shape[0]    = M;
+    shape[1]    = N;
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, shape);
+    float* c = out.floats.data();
+
+    if (transB && M > 1)
+    {
+        // Repacking B costs O(NK) against O(MNK) for the product and lets
+        // it use the register-tiled kernel
+        step.scratch.resize(N * K);
+        transposeMatrix(b.floats.data(), step.scratch.data(), N, K);
+        gemm(M, N, K, a.floats.data(), K, step.scratch.data(), N, c, N, false);
+    }
+    else if (transB)
+    {
+        gemmTransposedB(
+          M, N, K, a.floats.data(), K, b.floats.data(), K, c, N, false);
+    }
+    else
+    {
+        gemm(M, N, K, a.floats.data(), K, b.floats.data(), N, c, N, false);
+    }
+    if (alpha != 1.0f)
+    {
+        for (size_t i = 0; i < M * N; ++i)
+        {
+            c[i] *= alpha;
+        }
+    }
+    if (hasInput(step, 2) && beta != 0.0f)
+    {
+        const Tensor& bias = input(step, 2);
+        int64_t sc[MAX_RANK], none[MAX_RANK] = {};
+        broadcastStrides(bias.shape, shape, sc);
+        const int64_t* all[3] = { sc, none, none };
+        forEachIndex(shape, all, [&](size_t i, int64_t p, int64_t, int64_t) {
+            c[i] += beta * bias.floats[p];
+        });
+    }
+}
+
+Conv1dShape
+convShape(Step& step, const Tensor& x, const Tensor& w, bool transposed)
+{
+    if (x.shape.rank != 3 || w.shape.rank != 3)
+    {
+        fail(step, "only 1-D convolutions are supported");
+    }
+    auto autoPad = step.node->attributes.find("auto_pad");
+    if (autoPad != step.node->attributes.end() &&
+        autoPad->second.s != "NOTSET" && autoPad->second.s != "VALID")
+    {
+        fail(step, "auto_pad " + autoPad->second.s + " is not supported");
+    }
+    std::vector<int64_t> pads      = step.node->intsAttr("pads");
+    std::vector<int64_t> stride    = step.node->intsAttr("strides");
+    std::vector<int64_t> dilations = step.node->intsAttr("dilations");
+
+    Conv1dShape shape;
+    shape.groups     = step.node->intAttr("group", 1);
+    shape.inChannels = x.shape[1];
+    shape.inLength   = x.shape[2];
+    shape.kernel     = w.shape[2];
+    shape.stride     = stride.empty() ? 1 : stride[0];
+    shape.dilation   = dilations.empty() ? 1 : dilations[0];
+    shape.padLeft    = pads.empty() ? 0 : pads[0];
+    size_t padRight  = pads.size() < 2 ? 0 : pads[1];
+    size_t span      = shape.dilation * (shape.kernel - 1) + 1;
+    if (transposed)
+    {
+        std::vector<int64_t> extra = step.node->intsAttr("output_padding");
+        shape.outChannels = w.shape[1] * shape.groups;
+        shape.outLength   = shape.stride * (shape.inLength - 1) + span +
+                          (extra.empty() ? 0 : extra[0]) - shape.padLeft -
+                          padRight;
+    }
+    else
+    {
+        shape.outChannels = w.shape[0];
+        if (shape.inLength + shape.padLeft + padRight < span)
+        {
+            fail(step, "input shorter than the kernel");
+        }
+        shape.outLength =
+          (shape.inLength + shape.padLeft + padRight - span) / shape.stride + 1;
+    }
+    return shape;
+}
+
+void
+runConv(Step& step)
+{
+    const Tensor& x   = input(step, 0);
+    const Tensor& w   = input(step, 1);
+    const float* bias = hasInput(step, 2) ? input(step, 2).floats.data()
+                                          : nullptr;
+    Conv1dShape shape = convShape(step, x, w, false);
+    size_t batch      = x.shape[0];
+    NativeShape result;
+    result.rank = 3;
+    result[0]   = batch;
+    result[1]   = shape.outChannels;
+    result[2]   = shape.outLength;
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, result);
+    step.scratch.resize(conv1dScratchSize(shape));
+    for (size_t n = 0; n < batch; ++n)
+    {
+        conv1d(shape,
+               x.floats.data() + n * shape.inChannels * shape.inLength,
+               w.floats.data(),
+               bias,
+               out.floats.data() + n * shape.outChannels * shape.outLength,
+               step.scratch.data());
+    }
+}
+
+void
+runConvTranspose(Step& step)
+{
+    const Tensor& x   = input(step, 0);
+    const Tensor& w   = input(step, 1);
+    const float* bias = hasInput(step, 2) ? input(step, 2).floats.data()
+                                          : nullptr;
+    Conv1dShape shape = convShape(step, x, w, true);
+    size_t batch      = x.shape[0];
+    NativeShape result;
+    result.rank = 3;
+    result[0]   = batch;
+    result[1]   = shape.outChannels;
+    result[2]   = shape.outLength;
+    Tensor& out = output(step);
+    out.resize(ElementType::Float, result);
+    for (size_t n = 0; n < batch; ++n)
+    {
+        convTranspose1d(
+          shape,
+          x.floats.data() + n * shape.inChannels * shape.inLength,
+          w.floats.data(),
+          bias,
+          out.floats.data() + n * shape.outChannels * shape.outLength);
+    }
+}
+
+const std::unordered_map<std::string, NativeEngine::Kernel>&
+kernels()
+{
+    static const std::unordered_map<std::string, NativeEngine::Kernel> table =
+      {
+          { "Abs", runAbs },
+          { "Add", runAdd },
+          { "BatchNormalization", runBatchNormalization },
+          { "Cast", runCast },
+          { "Clip", runClip },
+          { "Concat", runConcat },
+          { "Constant", runConstant },
+          { "ConstantOfShape", runConstantOfShape },
+          { "Conv", runConv },
+          { "ConvTranspose", runConvTranspose },
+          { "Div", runDiv },
+          { "Dropout", runIdentity },
+          { "Elu", runElu },
+          { "Equal", runEqual },
+          { "Erf", runErf },
+          { "Exp", runExp },
+          { "Expand", runExpand },
+          { "Flatten", runFlatten },
+          { "Gather", runGather },
+          { "Gelu", runGelu },
+          { "Gemm", runGemm },
+          { "Greater", runGreater },
+          { "Identity", runIdentity },
+          { "LayerNormalization", runLayerNormalization },
+          { "LeakyRelu", runLeakyRelu },
+          { "Less", runLess },
+          { "Log", runLog },
+          { "MatMul", runMatMul },
+          { "Max", runMax },
+          { "Min", runMin },
+          { "Mul", runMul },
+          { "Neg", runNeg },
+          { "PRelu", runPRelu },
+          { "Pad", runPad },
+          { "Pow", runPow },
+          { "Range", runRange },
+          { "Reciprocal", runReciprocal },
+          { "ReduceMax", runReduceMax },
+          { "ReduceMean", runReduceMean },
+          { "ReduceSum", runReduceSum },
+          { "Relu", runRelu },
+          { "Reshape", runReshape },
+          { "Shape", runShape },
+          { "Sigmoid", runSigmoid },
+          { "Slice", runSlice },
+          { "Softmax", runSoftmax },
+          { "Softplus", runSoftplus },
+          { "Split", runSplit },
+          { "Sqrt", runSqrt },
+          { "Squeeze", runSqueeze },
+          { "Sub", runSub },
+          { "Tanh", runTanh },
+          { "Transpose", runTranspose },
+          { "Unsqueeze", runUnsqueeze },
+          { "Where", runWhere },
+      };
+    return table;
+}
+
+template <size_t N>
+NativeShape
+toShape(const std::array<int64_t, N>& dims)
+{
+    NativeShape shape;
+    shape.rank = N;
+    std::copy(dims.begin(), dims.end(), shape.dims.begin());
+    return shape;
+}
+
+const NativeShape STATE_SHAPES[4] = { toShape(ENC_BUF_SHAPE),
+                                      toShape(DEC_BUF_SHAPE),
+                                      toShape(OUT_BUF_SHAPE),
+                                      toShape(CONVNET_PRE_CTX_SHAPE) };
+} // namespace
+
+size_t
+NativeShape::count() const
+{
+    size_t total = 1;
+    for (size_t d = 0; d < rank; ++d)
+    {
+        total *= static_cast<size_t>(dims[d]);
+    }
+    return total;
+}
+
+void
+NativeTensor::resize(ElementType type, const NativeShape& shape)
+{
+    this->type  = type;
+    this->shape = shape;
+    size_t n    = shape.count();
+    if (type == ElementType::Float && floats.size() < n)
+    {
+        floats.resize(n);
+    }
+    else if (type == ElementType::Int64 && ints.size() < n)
+    {
+        ints.resize(n);
+    }
+}
+
+NativeEngine::NativeEngine(const std::string& modelPath)
+  : graph(loadOnnxGraph(modelPath))
+{
+    const auto& table = kernels();
+    std::string unsupported;
+    for (const OnnxNode& node : graph.nodes)
+    {
+        bool standard = node.domain.empty() || node.domain == "ai.onnx";
+        if (!standard || !table.count(node.opType))
+        {
+            unsupported += (unsupported.empty() ? "" : ", ") +
+                           (standard ? "" : node.domain + ".") + node.opType;
+        }
+    }
+    if (!unsupported.empty())
+    {
+        throw std::runtime_error("native engine: unsupported operators: " +
+                                 unsupported);
+    }
+
+    // Every tensor name gets a slot before any pointer into `values` is taken
+    std::unordered_map<std::string, size_t> ids;
+    auto id = [&](const std::string& name) {
+        auto found = ids.find(name);
+        if (found != ids.end())
+        {
+            return found->second;
+        }
+        ids.emplace(name, ids.size());
+        return ids.size() - 1;
+    };
+    for (const OnnxTensor& tensor : graph.initializers)
+    {
+        id(tensor.name);
+    }
+    for (const std::string& name : graph.inputs)
+    {
+        id(name);
+    }
+    for (const OnnxNode& node : graph.nodes)
+    {
+        for (const std::string& name : node.inputs)
+        {
+            if (!name.empty())
+            {
+                id(name);
+            }
+        }
+        for (const std::string& name : node.outputs)
+        {
+            if (!name.empty())
+            {
+                id(name);
+            }
+        }
+    }
+
+    auto require = [&](const std::string& name, bool isInput) {
+        const std::vector<std::string>& names =
+          isInput ? graph.inputs : graph.outputs;
+        if (std::find(names.begin(), names.end(), name) == names.end())
+        {
+            throw std::runtime_error(
+              std::string("native engine: model has no ") +
+              (isInput ? "input " : "output ") + name);
+        }
+        return ids.at(name);
+    };
+    audioIn  = require(INPUT_NAMES[0], true);
+    audioOut = require(OUTPUT_NAMES[0], false);
+    for (size_t k = 0; k < 4; ++k)
+    {
+        stateIn[k]  = require(INPUT_NAMES[k + 1], true);
+        stateOut[k] = require(OUTPUT_NAMES[k + 1], false);
+    }
+
+    values.resize(ids.size());
+    constant.assign(ids.size(), false);
+    for (OnnxTensor& tensor : graph.initializers)
+    {
+        NativeTensor& value = values[ids.at(tensor.name)];
+        NativeShape shape;
+        shape.rank = tensor.shape.size();
+        std::copy(tensor.shape.begin(), tensor.shape.end(), shape.dims.begin());
+        value.resize(tensor.type, shape);
+        value.floats = std::move(tensor.floats);
+        value.ints   = std::move(tensor.ints);
+    }
+
+    for (const OnnxNode& node : graph.nodes)
+    {
+        Step step;
+        step.node   = &node;
+        step.kernel = table.at(node.opType);
+        for (const std::string& name : node.inputs)
+        {
+            step.inputs.push_back(name.empty() ? nullptr
+                                               : &values[ids.at(name)]);
+        }
+        for (const std::string& name : node.outputs)
+        {
+            // Unused optional outputs (e.g. Dropout's mask) still get a slot
+            step.outputs.push_back(name.empty() ? nullptr
+                                                : &values[ids.at(name)]);
+        }
+        steps.push_back(std::move(step));
+    }
+}
+
+NativeState
+NativeEngine::createState() const
+{
+    NativeState state;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        state.buffers[k].assign(STATE_SHAPES[k].count(), 0.0f);
+    }
+    return state;
+}
+
+size_t
+NativeEngine::foldedNodeCount() const
+{
+    return std::count_if(
+      steps.begin(), steps.end(), [](const Step& step) { return step.folded; });
+}
+
+std::vector<std::string>
+NativeEngine::supportedOperators()
+{
+    std::vector<std::string> names;
+    for (const auto& entry : kernels())
+    {
+        names.push_back(entry.first);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+void
+NativeEngine::bindInput(size_t samples, const float* input)
+{
+    NativeShape shape;
+    shape.rank = 3;
+    shape[0]   = 1;
+    shape[1]   = 1;
+    shape[2]   = static_cast<int64_t>(samples);
+    values[audioIn].resize(ElementType::Float, shape);
+    std::copy(input, input + samples, values[audioIn].floats.begin());
+}
+
+// Runs every node once at the new block size and marks the ones whose
+// inputs cannot change between blocks; process() then skips those
+void
+NativeEngine::plan(size_t samples)
+{
+    std::vector<float> silence(samples, 0.0f);
+    bindInput(samples, silence.data());
+    for (size_t k = 0; k < 4; ++k)
+    {
+        values[stateIn[k]].resize(ElementType::Float, STATE_SHAPES[k]);
+        std::fill(values[stateIn[k]].floats.begin(),
+                  values[stateIn[k]].floats.end(),
+                  0.0f);
+    }
+
+    // Initializers have data but no producer
+    std::vector<bool> produced(values.size(), false);
+    for (const Step& step : steps)
+    {
+        for (NativeTensor* out : step.outputs)
+        {
+            if (out)
+            {
+                produced[out - values.data()] = true;
+            }
+        }
+    }
+    for (size_t v = 0; v < values.size(); ++v)
+    {
+        bool isInput = v == audioIn || std::find(stateIn.begin(),
+                                                 stateIn.end(),
+                                                 v) != stateIn.end();
+        constant[v] = !produced[v] && !isInput;
+    }
+
+    for (Step& step : steps)
+    {
+        // Shape depends only on the block size, which is fixed from here on
+        bool folded = step.node->opType == "Shape";
+        if (!folded)
+        {
+            folded = std::all_of(
+              step.inputs.begin(), step.inputs.end(), [&](NativeTensor* in) {
+                  return !in || constant[in - values.data()];
+              });
+        }
+        step.folded = folded;
+        step.kernel(step);
+        for (NativeTensor* out : step.outputs)
+        {
+            if (out)
+            {
+                constant[out - values.data()] = folded;
+            }
+        }
+    }
+    plannedSamples = samples;
+}
+
+void
+NativeEngine::process(const float* input,
+                      float* output,
+                      size_t samples,
+                      NativeState& state)
+{
+    if (samples != plannedSamples)
+    {
+        plan(samples);
+    }
+    bindInput(samples, input);
+
+    // Swapping buffers in and out moves the state without copying it
+    for (size_t k = 0; k < 4; ++k)
+    {
+        std::swap(values[stateIn[k]].floats, state.buffers[k]);
+    }
+    for (Step& step : steps)
+    {
+        if (!step.folded)
+        {
+            step.kernel(step);
+        }
+    }
+    for (size_t k = 0; k < 4; ++k)
+    {
+        NativeTensor& next = values[stateOut[k]];
+        if (next.shape.count() != STATE_SHAPES[k].count())
+        {
+            throw std::runtime_error(std::string("native engine: ") +
+                                     OUTPUT_NAMES[k + 1] +
+                                     " has the wrong size");
+        }
+        if (constant[stateOut[k]])
+        {
+            std::copy(next.floats.begin(),
+                      next.floats.begin() + next.shape.count(),
+                      state.buffers[k].begin());
+        }
+        else
+        {
+            std::swap(state.buffers[k], next.floats);
+        }
+    }
+
+    const NativeTensor& audio = values[audioOut];
+    if (audio.shape.count() != samples)
+    {
+        throw std::runtime_error("native engine: output has " +
+                                 std::to_string(audio.shape.count()) +
+                                 " samples for a block of " +
+                                 std::to_string(samples));
+    }
+    std::copy(audio.floats.begin(), audio.floats.begin() + samples, output);
+}
+
+size_t
+processBlock(NativeEngine& engine,
+             const float* input,
+             float* output,
+             size_t samples,
+             NativeState& state)
+{
+    engine.process(input, output, samples, state);
+    return samples; // process() throws on any other length
+}
+
+void
+processBlock(NativeEngine& engine,
+             std::vector<float>& block,
+             NativeState& state)
+{
+    engine.process(block.data(), block.data(), block.size(), state);
+}
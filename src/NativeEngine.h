@@ -0,0 +1,121 @@
+#pragma once
+
+#include "OnnxGraph.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs the LLVC streaming graph without ONNX Runtime. The graph and weights
+// are read from the same .onnx file, nodes run in file order on the kernels
+// in NativeKernels.h, and everything that depends only on weights or on the
+// block size (shape arithmetic, constant subgraphs) is folded when a block
+// size is first seen. After that first block, a run at the same size
+// resolves no value names and reuses every tensor buffer.
+//
+// Only the operators listed by supportedOperators() are implemented; a
+// model using anything else is rejected at construction, so callers can
+// fall back to ORT. Check a model with llvc_native_check before using it.
+// llvc_stdio and llvc_pipeline run it with --backend native.
+//
+// The kernels' AVX2/FMA and AVX-512 paths are only compiled in with
+// LLVC_NATIVE_ARCH=ON; a default build runs the scalar fallbacks, which
+// are correct but much slower (kernelIsa() says which one was built).
+
+const size_t MAX_RANK = 8;
+
+struct NativeShape
+{
+    std::array<int64_t, MAX_RANK> dims{};
+    size_t rank = 0;
+
+    int64_t& operator[](size_t d) { return dims[d]; }
+    int64_t operator[](size_t d) const { return dims[d]; }
+    size_t count() const;
+};
+
+struct NativeTensor
+{
+    ElementType type = ElementType::Float;
+    NativeShape shape;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+
+    // Sets type and shape, growing storage only if it is too small
+    void resize(ElementType type, const NativeShape& shape);
+};
+
+// Per-stream recurrent state, in INPUT_NAMES order (enc_buf, dec_buf,
+// out_buf, convnet_pre_ctx)
+struct NativeState
+{
+    std::array<std::vector<float>, 4> buffers;
+};
+
+class NativeEngine
+{
+  public:
+    // Throws std::runtime_error if the model cannot be read, does not have
+    // the LLVC streaming signature, or uses an unsupported operator
+    explicit NativeEngine(const std::string& modelPath);
+
+    NativeEngine(const NativeEngine&) = delete;
+    NativeEngine& operator=(const NativeEngine&) = delete;
+
+    // Zeroed state with the shapes from llvc.h
+    NativeState createState() const;
+
+    // Converts one block; `input` and `output` may alias. The first block
+    // of a new size replans and allocates.
+    void process(const float* input,
+                 float* output,
+                 size_t samples,
+                 NativeState& state);
+
+    size_t nodeCount() const { return steps.size(); }
+    size_t foldedNodeCount() const; // 0 until the first block
+
+    static std::vector<std::string> supportedOperators();
+
+    struct Step;
+    using Kernel = void (*)(Step&);
+
+    struct Step
+    {
+        const OnnxNode* node = nullptr;
+        Kernel kernel        = nullptr;
+        std::vector<NativeTensor*> inputs; // null for omitted inputs
+        std::vector<NativeTensor*> outputs;
+        std::vector<float> scratch;
+        bool folded = false;
+    };
+
+  private:
+    void plan(size_t samples);
+    void bindInput(size_t samples, const float* input);
+
+    OnnxGraph graph;
+    std::vector<NativeTensor> values; // never resized after construction
+    std::vector<bool> constant; // per value, valid after plan()
+    std::vector<Step> steps;
+    size_t audioIn  = 0;
+    size_t audioOut = 0;
+    std::array<size_t, 4> stateIn{};
+    std::array<size_t, 4> stateOut{};
+    size_t plannedSamples = 0;
+};
+
+// The llvc.h processBlock() overloads for the native engine, so code
+// written against them (VadGate, the command-line tools) runs either one
+size_t
+processBlock(NativeEngine& engine,
+             const float* input,
+             float* output,
+             size_t samples,
+             NativeState& state);
+
+void
+processBlock(NativeEngine& engine,
+             std::vector<float>& block,
+             NativeState& state);
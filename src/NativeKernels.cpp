@@ -0,0 +1,778 @@
+#include "NativeKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LLVC_KERNELS_AVX2 1
+#endif
+#if defined(__AVX512F__)
+#define LLVC_KERNELS_AVX512 1
+#endif
+
+namespace
+{
+const size_t GEMM_ROWS            = 6;   // rows of A per register tile
+const size_t GEMM_DEPTH           = 256; // K per packed panel of B
+const size_t GEMV_ROWS            = 2;   // up to this, gemm runs as axpy
+const size_t TRANSPOSE_TILE       = 16;  // square blocks that stay in L1
+const size_t DIRECT_CONV_CHANNELS = 4;   // below this, conv skips im2col
+
+// Cephes exp: e^x = 2^n * e^r with |r| <= ln(2) / 2
+const float EXP_LIMIT = 88.3762626647949f;
+const float LOG2E     = 1.44269504088896341f;
+const float LN2_HIGH  = 0.693359375f;
+const float LN2_LOW   = -2.12194440e-4f;
+const float EXP_POLY[] = { 1.9875691500e-4f, 1.3981999507e-3f,
+                           8.3334519073e-3f, 4.1665795894e-2f,
+                           1.6666665459e-1f, 5.0000001201e-1f };
+
+// Abramowitz & Stegun 7.1.26, absolute error below 1.5e-7
+const float ERF_P      = 0.3275911f;
+const float ERF_POLY[] = { 1.061405429f, -1.453152027f, 1.421413741f,
+                           -0.284496736f, 0.254829592f };
+
+float
+expScalar(float x)
+{
+    x         = std::min(std::max(x, -EXP_LIMIT), EXP_LIMIT);
+    float n   = std::floor(x * LOG2E + 0.5f);
+    float r   = x - n * LN2_HIGH - n * LN2_LOW;
+    float y   = EXP_POLY[0];
+    for (size_t k = 1; k < 6; ++k)
+    {
+        y = y * r + EXP_POLY[k];
+    }
+    y = y * r * r + r + 1.0f;
+    return std::ldexp(y, static_cast<int>(n));
+}
+
+float
+erfScalar(float x)
+{
+    float a = std::fabs(x);
+    float t = 1.0f / (1.0f + ERF_P * a);
+    float y = ERF_POLY[0];
+    for (size_t k = 1; k < 5; ++k)
+    {
+        y = y * t + ERF_POLY[k];
+    }
+    y = 1.0f - y * t * expScalar(-a * a);
+    return x < 0.0f ? -y : y;
+}
+
+#if LLVC_KERNELS_AVX2
+float
+horizontalSum(__m256 v)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+                            _mm256_extractf128_ps(v, 1));
+    sum        = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum        = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+__m256
+exp8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-EXP_LIMIT)),
+                      _mm256_set1_ps(EXP_LIMIT));
+    __m256 n = _mm256_floor_ps(
+      _mm256_fmadd_ps(x, _mm256_set1_ps(LOG2E), _mm256_set1_ps(0.5f)));
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HIGH), x);
+    r        = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LOW), r);
+    __m256 y = _mm256_set1_ps(EXP_POLY[0]);
+    for (size_t k = 1; k < 6; ++k)
+    {
+        y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(EXP_POLY[k]));
+    }
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(r, r), r);
+    y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+    // Scale by 2^n through the exponent bits
+    __m256i e = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+}
+
+// 8 x 8 block through registers: unpack pairs, then quads, then halves
+void
+transpose8x8(const float* in, size_t ldi, float* out, size_t ldo)
+{
+    __m256 r[8], t[8];
+    for (size_t i = 0; i < 8; ++i)
+    {
+        r[i] = _mm256_loadu_ps(in + i * ldi);
+    }
+    for (size_t i = 0; i < 8; i += 2)
+    {
+        t[i]     = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (size_t i = 0; i < 8; i += 4)
+    {
+        r[i]     = _mm256_shuffle_ps(t[i], t[i + 2], 0x44);
+        r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], 0xee);
+        r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+        r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0xee);
+    }
+    for (size_t i = 0; i < 4; ++i)
+    {
+        _mm256_storeu_ps(out + i * ldo,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+        _mm256_storeu_ps(out + (i + 4) * ldo,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+    }
+}
+
+#if LLVC_KERNELS_AVX512
+typedef __m512 GemmVector;
+#define LLVC_GEMM_LOAD _mm512_loadu_ps
+#define LLVC_GEMM_STORE _mm512_storeu_ps
+#define LLVC_GEMM_BROADCAST(p) _mm512_set1_ps(*(p))
+#define LLVC_GEMM_FMADD _mm512_fmadd_ps
+#else
+typedef __m256 GemmVector;
+#define LLVC_GEMM_LOAD _mm256_loadu_ps
+#define LLVC_GEMM_STORE _mm256_storeu_ps
+#define LLVC_GEMM_BROADCAST(p) _mm256_broadcast_ss(p)
+#define LLVC_GEMM_FMADD _mm256_fmadd_ps
+#endif
+const size_t GEMM_LANES = sizeof(GemmVector) / sizeof(float);
+const size_t GEMM_PANEL = 2 * GEMM_LANES; // columns per register tile
+
+// C[0..ROWS)[0..GEMM_PANEL) += A[0..ROWS)[0..K) * B[0..K)[0..GEMM_PANEL).
+// ROWS is a template argument and the row loops are unrolled so the
+// accumulators stay in registers at -O2.
+template <size_t ROWS>
+void
+gemmTile(size_t K,
+         const float* A,
+         size_t lda,
+         const float* B,
+         size_t ldb,
+         float* C,
+         size_t ldc)
+{
+    GemmVector c[ROWS][2];
+#pragma GCC unroll 8
+    for (size_t r = 0; r < ROWS; ++r)
+    {
+        c[r][0] = LLVC_GEMM_LOAD(C + r * ldc);
+        c[r][1] = LLVC_GEMM_LOAD(C + r * ldc + GEMM_LANES);
+    }
+    for (size_t k = 0; k < K; ++k)
+    {
+        GemmVector b0 = LLVC_GEMM_LOAD(B + k * ldb);
+        GemmVector b1 = LLVC_GEMM_LOAD(B + k * ldb + GEMM_LANES);
+#pragma GCC unroll 8
+        for (size_t r = 0; r < ROWS; ++r)
+        {
+            GemmVector a = LLVC_GEMM_BROADCAST(A + r * lda + k);
+            c[r][0]      = LLVC_GEMM_FMADD(a, b0, c[r][0]);
+            c[r][1]      = LLVC_GEMM_FMADD(a, b1, c[r][1]);
+        }
+    }
+#pragma GCC unroll 8
+    for (size_t r = 0; r < ROWS; ++r)
+    {
+        LLVC_GEMM_STORE(C + r * ldc, c[r][0]);
+        LLVC_GEMM_STORE(C + r * ldc + GEMM_LANES, c[r][1]);
+    }
+}
+
+#undef LLVC_GEMM_LOAD
+#undef LLVC_GEMM_STORE
+#undef LLVC_GEMM_BROADCAST
+#undef LLVC_GEMM_FMADD
+
+// One GEMM_PANEL-column panel of B against every row of A
+void
+gemmPanel(size_t M,
+          size_t K,
+          const float* A,
+          size_t lda,
+          const float* B,
+          size_t ldb,
+          float* C,
+          size_t ldc)
+{
+    size_t i = 0;
+    for (; i + GEMM_ROWS <= M; i += GEMM_ROWS)
+    {
+        gemmTile<GEMM_ROWS>(
+          K, A + i * lda, lda, B, ldb, C + i * ldc, ldc);
+    }
+    A += i * lda;
+    C += i * ldc;
+    switch (M - i)
+    {
+        case 5:
+            gemmTile<5>(K, A, lda, B, ldb, C, ldc);
+            break;
+        case 4:
+            gemmTile<4>(K, A, lda, B, ldb, C, ldc);
+            break;
+        case 3:
+            gemmTile<3>(K, A, lda, B, ldb, C, ldc);
+            break;
+        case 2:
+            gemmTile<2>(K, A, lda, B, ldb, C, ldc);
+            break;
+        case 1:
+            gemmTile<1>(K, A, lda, B, ldb, C, ldc);
+            break;
+        default:
+            break;
+    }
+}
+#endif
+
+// Columns the register tiles did not cover
+void
+gemmEdge(size_t M,
+         size_t columns,
+         size_t K,
+         const float* A,
+         size_t lda,
+         const float* B,
+         size_t ldb,
+         float* C,
+         size_t ldc)
+{
+    for (size_t r = 0; r < M; ++r)
+    {
+        for (size_t k = 0; k < K; ++k)
+        {
+            float a = A[r * lda + k];
+            for (size_t j = 0; j < columns; ++j)
+            {
+                C[r * ldc + j] += a * B[k * ldb + j];
+            }
+        }
+    }
+}
+
+// Output positions [first, last) at which tap k reads inside the input
+void
+tapRange(const Conv1dShape& shape, size_t k, size_t& first, size_t& last)
+{
+    long long offset = static_cast<long long>(k * shape.dilation) -
+                       static_cast<long long>(shape.padLeft);
+    long long stride = static_cast<long long>(shape.stride);
+    long long length = static_cast<long long>(shape.inLength);
+    long long begin  = offset < 0 ? (stride - 1 - offset) / stride : 0;
+    long long end =
+      length > offset ? (length - offset + stride - 1) / stride : 0;
+    end   = std::min(end, static_cast<long long>(shape.outLength));
+    begin = std::min(begin, end);
+    first = static_cast<size_t>(begin);
+    last  = static_cast<size_t>(end);
+}
+} // namespace
+
+const char*
+kernelIsa()
+{
+#if LLVC_KERNELS_AVX512
+    return "AVX-512";
+#elif LLVC_KERNELS_AVX2
+    return "AVX2/FMA";
+#else
+    return "scalar";
+#endif
+}
+
+void
+axpy(float a, const float* x, float* y, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX512
+    __m512 va = _mm512_set1_ps(a);
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(
+          y + i,
+          _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+#elif LLVC_KERNELS_AVX2
+    __m256 va = _mm256_set1_ps(a);
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(
+          y + i,
+          _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+float
+dot(const float* a, const float* b, size_t n)
+{
+    size_t i  = 0;
+    float sum = 0.0f;
+#if LLVC_KERNELS_AVX512
+    __m512 acc = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        acc = _mm512_fmadd_ps(
+          _mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+    }
+    __m256 high =
+      _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1));
+    sum = horizontalSum(_mm256_add_ps(_mm512_castps512_ps256(acc), high));
+#elif LLVC_KERNELS_AVX2
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(
+          _mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(
+          _mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(
+          _mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+#endif
+    for (; i < n; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// The element-wise kernels share one shape; OP is the intrinsic suffix
+#if LLVC_KERNELS_AVX512
+#define LLVC_BINARY_LOOP(OP)                                                   \
+    for (; i + 16 <= n; i += 16)                                               \
+    {                                                                          \
+        _mm512_storeu_ps(                                                      \
+          out + i,                                                             \
+          _mm512_##OP##_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));   \
+    }
+#elif LLVC_KERNELS_AVX2
+#define LLVC_BINARY_LOOP(OP)                                                   \
+    for (; i + 8 <= n; i += 8)                                                 \
+    {                                                                          \
+        _mm256_storeu_ps(                                                      \
+          out + i,                                                             \
+          _mm256_##OP##_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));   \
+    }
+#else
+#define LLVC_BINARY_LOOP(OP)
+#endif
+
+void
+addVectors(const float* a, const float* b, float* out, size_t n)
+{
+    size_t i = 0;
+    LLVC_BINARY_LOOP(add)
+    for (; i < n; ++i)
+    {
+        out[i] = a[i] + b[i];
+    }
+}
+
+void
+subtractVectors(const float* a, const float* b, float* out, size_t n)
+{
+    size_t i = 0;
+    LLVC_BINARY_LOOP(sub)
+    for (; i < n; ++i)
+    {
+        out[i] = a[i] - b[i];
+    }
+}
+
+void
+multiplyVectors(const float* a, const float* b, float* out, size_t n)
+{
+    size_t i = 0;
+    LLVC_BINARY_LOOP(mul)
+    for (; i < n; ++i)
+    {
+        out[i] = a[i] * b[i];
+    }
+}
+
+#undef LLVC_BINARY_LOOP
+
+void
+relu(const float* x, float* out, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX512
+    __m512 zero = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(out + i, _mm512_max_ps(_mm512_loadu_ps(x + i), zero));
+    }
+#elif LLVC_KERNELS_AVX2
+    __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_loadu_ps(x + i), zero));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out[i] = std::max(x[i], 0.0f);
+    }
+}
+
+void
+expVector(const float* x, float* out, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX2
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(out + i, exp8(_mm256_loadu_ps(x + i)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out[i] = expScalar(x[i]);
+    }
+}
+
+// tanh(x) = sign(x) * (1 - 2 / (e^2|x| + 1))
+void
+tanhVector(const float* x, float* out, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX2
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 one  = _mm256_set1_ps(1.0f);
+    const __m256 two  = _mm256_set1_ps(2.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 e = exp8(_mm256_mul_ps(two, _mm256_andnot_ps(sign, v)));
+        __m256 t =
+          _mm256_sub_ps(one, _mm256_div_ps(two, _mm256_add_ps(e, one)));
+        _mm256_storeu_ps(out + i, _mm256_or_ps(t, _mm256_and_ps(sign, v)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        float t = 1.0f - 2.0f / (expScalar(2.0f * std::fabs(x[i])) + 1.0f);
+        out[i]  = std::copysign(t, x[i]);
+    }
+}
+
+void
+sigmoidVector(const float* x, float* out, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX2
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 e =
+          exp8(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+        _mm256_storeu_ps(out + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out[i] = 1.0f / (1.0f + expScalar(-x[i]));
+    }
+}
+
+void
+erfVector(const float* x, float* out, size_t n)
+{
+    size_t i = 0;
+#if LLVC_KERNELS_AVX2
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 one  = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 a = _mm256_andnot_ps(sign, v);
+        __m256 t = _mm256_div_ps(
+          one, _mm256_fmadd_ps(_mm256_set1_ps(ERF_P), a, one));
+        __m256 y = _mm256_set1_ps(ERF_POLY[0]);
+        for (size_t k = 1; k < 5; ++k)
+        {
+            y = _mm256_fmadd_ps(y, t, _mm256_set1_ps(ERF_POLY[k]));
+        }
+        __m256 e =
+          exp8(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(a, a)));
+        y        = _mm256_fnmadd_ps(_mm256_mul_ps(y, t), e, one);
+        _mm256_storeu_ps(out + i, _mm256_or_ps(y, _mm256_and_ps(sign, v)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out[i] = erfScalar(x[i]);
+    }
+}
+
+void
+transposeMatrix(const float* in, float* out, size_t rows, size_t columns)
+{
+    for (size_t r0 = 0; r0 < rows; r0 += TRANSPOSE_TILE)
+    {
+        size_t r1 = std::min(rows, r0 + TRANSPOSE_TILE);
+        for (size_t c0 = 0; c0 < columns; c0 += TRANSPOSE_TILE)
+        {
+            size_t c1 = std::min(columns, c0 + TRANSPOSE_TILE);
+#if LLVC_KERNELS_AVX2
+            if (r1 - r0 == TRANSPOSE_TILE && c1 - c0 == TRANSPOSE_TILE)
+            {
+                for (size_t r = r0; r < r1; r += 8)
+                {
+                    for (size_t c = c0; c < c1; c += 8)
+                    {
+                        transpose8x8(in + r * columns + c,
+                                     columns,
+                                     out + c * rows + r,
+                                     rows);
+                    }
+                }
+                continue;
+            }
+#endif
+            for (size_t r = r0; r < r1; ++r)
+            {
+                for (size_t c = c0; c < c1; ++c)
+                {
+                    out[c * rows + r] = in[r * columns + c];
+                }
+            }
+        }
+    }
+}
+
+void
+gemm(size_t M,
+     size_t N,
+     size_t K,
+     const float* A,
+     size_t lda,
+     const float* B,
+     size_t ldb,
+     float* C,
+     size_t ldc,
+     bool accumulate)
+{
+    if (!accumulate)
+    {
+        for (size_t i = 0; i < M; ++i)
+        {
+            std::fill(C + i * ldc, C + i * ldc + N, 0.0f);
+        }
+    }
+    size_t j = 0;
+#if LLVC_KERNELS_AVX2
+    // For one or two rows (GEMV), streaming B row by row beats tiling it
+    if (M <= GEMV_ROWS)
+    {
+        for (size_t i = 0; i < M; ++i)
+        {
+            for (size_t k = 0; k < K; ++k)
+            {
+                axpy(A[i * lda + k], B + k * ldb, C + i * ldc, N);
+            }
+        }
+        return;
+    }
+    // Packing each panel of B keeps it contiguous: rows of a wide B are a
+    // power of two apart and would otherwise collide in L1
+    alignas(64) float panel[GEMM_DEPTH * GEMM_PANEL];
+    for (size_t k = 0; k < K; k += GEMM_DEPTH)
+    {
+        size_t depth = std::min(GEMM_DEPTH, K - k);
+        for (j = 0; j + GEMM_PANEL <= N; j += GEMM_PANEL)
+        {
+            for (size_t d = 0; d < depth; ++d)
+            {
+                std::memcpy(panel + d * GEMM_PANEL,
+                            B + (k + d) * ldb + j,
+                            GEMM_PANEL * sizeof(float));
+            }
+            gemmPanel(M, depth, A + k, lda, panel, GEMM_PANEL, C + j, ldc);
+        }
+    }
+#endif
+    if (j < N)
+    {
+        gemmEdge(M, N - j, K, A, lda, B + j, ldb, C + j, ldc);
+    }
+}
+
+void
+gemmTransposedB(size_t M,
+                size_t N,
+                size_t K,
+                const float* A,
+                size_t lda,
+                const float* B,
+                size_t ldb,
+                float* C,
+                size_t ldc,
+                bool accumulate)
+{
+    for (size_t i = 0; i < M; ++i)
+    {
+        for (size_t j = 0; j < N; ++j)
+        {
+            float value = dot(A + i * lda, B + j * ldb, K);
+            C[i * ldc + j] = accumulate ? C[i * ldc + j] + value : value;
+        }
+    }
+}
+
+size_t
+conv1dScratchSize(const Conv1dShape& shape)
+{
+    return shape.inChannels / shape.groups * shape.kernel * shape.outLength;
+}
+
+void
+conv1d(const Conv1dShape& shape,
+       const float* input,
+       const float* weights,
+       const float* bias,
+       float* output,
+       float* scratch)
+{
+    size_t inPerGroup  = shape.inChannels / shape.groups;
+    size_t outPerGroup = shape.outChannels / shape.groups;
+    size_t patch       = inPerGroup * shape.kernel;
+    size_t T           = shape.outLength;
+
+    for (size_t g = 0; g < shape.groups; ++g)
+    {
+        float* out = output + g * outPerGroup * T;
+        for (size_t o = 0; o < outPerGroup; ++o)
+        {
+            std::fill(out + o * T,
+                      out + (o + 1) * T,
+                      bias ? bias[g * outPerGroup + o] : 0.0f);
+        }
+
+        // A few output channels cannot amortize the im2col copy; with unit
+        // stride each tap is an axpy over the shifted input row
+        bool direct = shape.stride == 1 && outPerGroup < DIRECT_CONV_CHANNELS;
+        for (size_t c = 0; c < inPerGroup; ++c)
+        {
+            const float* in = input + (g * inPerGroup + c) * shape.inLength;
+            for (size_t k = 0; k < shape.kernel; ++k)
+            {
+                size_t first, last;
+                tapRange(shape, k, first, last);
+                long long offset = static_cast<long long>(k * shape.dilation) -
+                                   static_cast<long long>(shape.padLeft);
+                if (direct)
+                {
+                    for (size_t o = 0; o < outPerGroup; ++o)
+                    {
+                        float w = weights[(g * outPerGroup + o) * patch +
+                                          c * shape.kernel + k];
+                        axpy(w,
+                             in + offset + static_cast<long long>(first),
+                             out + o * T + first,
+                             last - first);
+                    }
+                    continue;
+                }
+
+                // im2col: row (c, k) holds input[c][t * stride + offset]
+                float* row = scratch + (c * shape.kernel + k) * T;
+                std::fill(row, row + first, 0.0f);
+                for (size_t t = first; t < last; ++t)
+                {
+                    row[t] = in[static_cast<long long>(t * shape.stride) +
+                                offset];
+                }
+                std::fill(row + last, row + T, 0.0f);
+            }
+        }
+        if (!direct)
+        {
+            gemm(outPerGroup,
+                 T,
+                 patch,
+                 weights + g * outPerGroup * patch,
+                 patch,
+                 scratch,
+                 T,
+                 out,
+                 T,
+                 true);
+        }
+    }
+}
+
+void
+convTranspose1d(const Conv1dShape& shape,
+                const float* input,
+                const float* weights,
+                const float* bias,
+                float* output)
+{
+    size_t inPerGroup  = shape.inChannels / shape.groups;
+    size_t outPerGroup = shape.outChannels / shape.groups;
+    size_t T           = shape.outLength;
+    for (size_t o = 0; o < shape.outChannels; ++o)
+    {
+        std::fill(output + o * T, output + (o + 1) * T, bias ? bias[o] : 0.0f);
+    }
+
+    // output[o][t * stride + k * dilation - pad] += w[c][o][k] * input[c][t]
+    for (size_t g = 0; g < shape.groups; ++g)
+    {
+        for (size_t c = g * inPerGroup; c < (g + 1) * inPerGroup; ++c)
+        {
+            const float* in = input + c * shape.inLength;
+            for (size_t o = 0; o < outPerGroup; ++o)
+            {
+                float* out = output + (g * outPerGroup + o) * T;
+                const float* w =
+                  weights + (c * outPerGroup + o) * shape.kernel;
+                for (size_t k = 0; k < shape.kernel; ++k)
+                {
+                    long long shift =
+                      static_cast<long long>(k * shape.dilation) -
+                      static_cast<long long>(shape.padLeft);
+                    if (shape.stride == 1)
+                    {
+                        // Valid t: 0 <= t + shift < T and t < inLength
+                        long long first = std::max(0LL, -shift);
+                        long long last  = std::min(
+                          static_cast<long long>(shape.inLength),
+                          static_cast<long long>(T) - shift);
+                        if (last > first)
+                        {
+                            axpy(w[k],
+                                 in + first,
+                                 out + first + shift,
+                                 static_cast<size_t>(last - first));
+                        }
+                        continue;
+                    }
+                    for (size_t t = 0; t < shape.inLength; ++t)
+                    {
+                        long long x =
+                          static_cast<long long>(t * shape.stride) + shift;
+                        if (x >= 0 && x < static_cast<long long>(T))
+                        {
+                            out[x] += w[k] * in[t];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
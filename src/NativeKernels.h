@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+
+// Dense float kernels behind the native engine. Each has an AVX2/FMA path,
+// the linear algebra also an AVX-512 one, and a scalar fallback. The choice
+// is made at compile time, not by CPU detection: the vector paths exist
+// only when the compiler targets them, i.e. with LLVC_NATIVE_ARCH=ON (or
+// equivalent -m flags), and a default build is scalar throughout.
+// Matrices are row-major with explicit leading dimensions.
+
+// Name of the instruction set the kernels were built for
+const char*
+kernelIsa();
+
+// y[i] += a * x[i]
+void
+axpy(float a, const float* x, float* y, size_t n);
+
+float
+dot(const float* a, const float* b, size_t n);
+
+// out[i] = a[i] (+ - *) b[i]
+void
+addVectors(const float* a, const float* b, float* out, size_t n);
+
+void
+subtractVectors(const float* a, const float* b, float* out, size_t n);
+
+void
+multiplyVectors(const float* a, const float* b, float* out, size_t n);
+
+// out[i] = max(x[i], 0)
+void
+relu(const float* x, float* out, size_t n);
+
+// Polynomial approximations, within 1e-6 of the libm results; `x` and
+// `out` may alias
+void
+expVector(const float* x, float* out, size_t n);
+
+void
+tanhVector(const float* x, float* out, size_t n);
+
+void
+sigmoidVector(const float* x, float* out, size_t n);
+
+void
+erfVector(const float* x, float* out, size_t n);
+
+// out[c][r] = in[r][c] for a rows x columns matrix
+void
+transposeMatrix(const float* in, float* out, size_t rows, size_t columns);
+
+// C (M x N) = A (M x K) * B (K x N), added to C when `accumulate`
+void
+gemm(size_t M,
+     size_t N,
+     size_t K,
+     const float* A,
+     size_t lda,
+     const float* B,
+     size_t ldb,
+     float* C,
+     size_t ldc,
+     bool accumulate);
+
+// As gemm, with B given transposed (N x K), as Linear weights are stored
+void
+gemmTransposedB(size_t M,
+                size_t N,
+                size_t K,
+                const float* A,
+                size_t lda,
+                const float* B,
+                size_t ldb,
+                float* C,
+                size_t ldc,
+                bool accumulate);
+
+struct Conv1dShape
+{
+    size_t inChannels  = 0;
+    size_t outChannels = 0;
+    size_t inLength    = 0;
+    size_t outLength   = 0;
+    size_t kernel      = 0;
+    size_t stride      = 1;
+    size_t dilation    = 1;
+    size_t padLeft     = 0;
+    size_t groups      = 1;
+};
+
+// One batch item, lowered to im2col + gemm. weights:
+// [outChannels][inChannels / groups][kernel]; bias may be null; scratch
+// holds conv1dScratchSize(shape) floats.
+void
+conv1d(const Conv1dShape& shape,
+       const float* input,
+       const float* weights,
+       const float* bias,
+       float* output,
+       float* scratch);
+
+size_t
+conv1dScratchSize(const Conv1dShape& shape);
+
+// Transposed 1-D convolution. weights:
+// [inChannels][outChannels / groups][kernel]; bias may be null.
+void
+convTranspose1d(const Conv1dShape& shape,
+                const float* input,
+                const float* weights,
+                const float* bias,
+                float* output);
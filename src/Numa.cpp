@@ -0,0 +1,164 @@
+#include "Numa.h"
+#include <algorithm>
+#include <dirent.h>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char* const NODE_DIRECTORY   = "/sys/devices/system/node";
+const unsigned long MPOL_BIND_MODE = 2; // MPOL_BIND from <numaif.h>
+
+// Parses a sysfs CPU list such as "0-3,8-11"
+std::vector<int>
+parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first   = std::stoi(range.substr(0, dash));
+        int last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaNode
+wholeMachine()
+{
+    NumaNode node;
+    node.id       = 0;
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned cpu = 0; cpu < cpus; ++cpu)
+    {
+        node.cpus.push_back(static_cast<int>(cpu));
+    }
+    return node;
+}
+} // namespace
+
+std::vector<NumaNode>
+numaTopology()
+{
+    std::vector<NumaNode> nodes;
+    DIR* directory = opendir(NODE_DIRECTORY);
+    if (directory)
+    {
+        while (dirent* entry = readdir(directory))
+        {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos ||
+                name.size() == 4)
+            {
+                continue;
+            }
+            std::ifstream file(std::string(NODE_DIRECTORY) + "/" + name +
+                               "/cpulist");
+            std::string list;
+            std::getline(file, list);
+            NumaNode node;
+            node.id   = std::stoi(name.substr(4));
+            node.cpus = parseCpuList(list);
+            if (!node.cpus.empty()) // memory-only nodes run no workers
+            {
+                nodes.push_back(std::move(node));
+            }
+        }
+        closedir(directory);
+    }
+    if (nodes.empty())
+    {
+        nodes.push_back(wholeMachine());
+    }
+    std::sort(nodes.begin(),
+              nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return nodes;
+}
+
+bool
+pinThisThread(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+bool
+bindMemory(void* memory, size_t bytes, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bitsPerWord + 1, 0);
+    mask[node / bitsPerWord] |= 1UL << (node % bitsPerWord);
+    return syscall(SYS_mbind,
+                   memory,
+                   bytes,
+                   MPOL_BIND_MODE,
+                   mask.data(),
+                   mask.size() * bitsPerWord + 1,
+                   0) == 0;
+#else
+    (void)memory;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+std::unique_ptr<Ort::Session>
+createSessionOnNode(Ort::Env& env,
+                    const char* modelPath,
+                    const Ort::SessionOptions& options,
+                    const NumaNode& node)
+{
+    std::unique_ptr<Ort::Session> session;
+    std::exception_ptr error;
+    std::thread loader([&] {
+        pinThisThread(node.cpus);
+        try
+        {
+            session = std::make_unique<Ort::Session>(env, modelPath, options);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    });
+    loader.join();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return session;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// NUMA topology, thread pinning and memory binding, read from sysfs and
+// done with plain syscalls so there is no libnuma dependency. On machines
+// without NUMA (or outside Linux) the topology is a single node holding
+// every CPU and binding memory does nothing.
+
+struct NumaNode
+{
+    int id;
+    std::vector<int> cpus;
+};
+
+// Nodes that have CPUs, in id order; never empty
+std::vector<NumaNode>
+numaTopology();
+
+// Restricts the calling thread to `cpus`; false if the kernel refused
+bool
+pinThisThread(const std::vector<int>& cpus);
+
+// Places [memory, memory + bytes) on `node`. Call before the pages are
+// first touched; false if the kernel refused or NUMA is unavailable.
+bool
+bindMemory(void* memory, size_t bytes, int node);
+
+// Creates the session on a thread pinned to `node`, so the weights ORT
+// copies out of the model are first touched, and so allocated, there
+std::unique_ptr<Ort::Session>
+createSessionOnNode(Ort::Env& env,
+                    const char* modelPath,
+                    const Ort::SessionOptions& options,
+                    const NumaNode& node);
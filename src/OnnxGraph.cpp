@@ -0,0 +1,1109 @@
+#include "OnnxGraph.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+// onnx.proto data types
+const int32_t TYPE_FLOAT  = 1;
+const int32_t TYPE_INT32  = 6;
+const int32_t TYPE_INT64  = 7;
+const int32_t TYPE_BOOL   = 9;
+const int32_t TYPE_DOUBLE = 11;
+
+const int32_t LOCATION_EXTERNAL = 1;
+
+// external_data location of stripped initializers; never opened, since
+// every one of them is supplied by the caller
+const char* const SUPPLIED_LOCATION = "llvc_supplied_initializer";
+
+// Versions written into synthetic models; old enough for ORT 1.17
+const uint64_t SYNTHETIC_IR_VERSION = 8;
+const uint64_t SYNTHETIC_OPSET      = 17;
+
+enum WireType
+{
+    VARINT    = 0,
+    FIXED64   = 1,
+    DELIMITED = 2,
+    FIXED32   = 5
+};
+
+// Protobuf wire-format cursor over one message
+class Message
+{
+  public:
+    Message(const char* begin, const char* end)
+      : p(begin)
+      , end(end)
+    {
+    }
+
+    bool next()
+    {
+        if (p >= end)
+        {
+            return false;
+        }
+        uint64_t key = varint();
+        field        = static_cast<int>(key >> 3);
+        wire         = static_cast<int>(key & 7);
+        return true;
+    }
+
+    int field = 0;
+    int wire  = 0;
+
+    // Start of the next field, for copying fields verbatim
+    const char* cursor() const { return p; }
+    size_t remaining() const { return static_cast<size_t>(end - p); }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p >= end)
+            {
+                throw std::runtime_error("truncated ONNX file");
+            }
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        throw std::runtime_error("malformed varint in ONNX file");
+    }
+
+    Message delimited()
+    {
+        uint64_t length = varint();
+        if (length > static_cast<uint64_t>(end - p))
+        {
+            throw std::runtime_error("truncated ONNX file");
+        }
+        Message inner(p, p + length);
+        p += length;
+        return inner;
+    }
+
+    std::string string()
+    {
+        Message inner = delimited();
+        return std::string(inner.p, inner.end);
+    }
+
+    float fixed32()
+    {
+        float value;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    double fixed64()
+    {
+        double value;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    // Repeated scalars may arrive packed or one per key
+    void varints(std::vector<int64_t>& out)
+    {
+        if (wire != DELIMITED)
+        {
+            out.push_back(static_cast<int64_t>(varint()));
+            return;
+        }
+        Message packed = delimited();
+        while (packed.p < packed.end)
+        {
+            out.push_back(static_cast<int64_t>(packed.varint()));
+        }
+    }
+
+    void floats(std::vector<float>& out)
+    {
+        if (wire != DELIMITED)
+        {
+            out.push_back(fixed32());
+            return;
+        }
+        Message packed = delimited();
+        while (packed.p < packed.end)
+        {
+            out.push_back(packed.fixed32());
+        }
+    }
+
+    void doubles(std::vector<float>& out)
+    {
+        if (wire != DELIMITED)
+        {
+            out.push_back(static_cast<float>(fixed64()));
+            return;
+        }
+        Message packed = delimited();
+        while (packed.p < packed.end)
+        {
+            out.push_back(static_cast<float>(packed.fixed64()));
+        }
+    }
+
+    void skip()
+    {
+        switch (wire)
+        {
+            case VARINT:
+                varint();
+                break;
+            case FIXED64:
+                advance(8);
+                break;
+            case DELIMITED:
+                delimited();
+                break;
+            case FIXED32:
+                advance(4);
+                break;
+            default:
+                throw std::runtime_error("unsupported protobuf wire type");
+        }
+    }
+
+  private:
+    void take(void* out, size_t size)
+    {
+        if (static_cast<size_t>(end - p) < size)
+        {
+            throw std::runtime_error("truncated ONNX file");
+        }
+        std::memcpy(out, p, size);
+        p += size;
+    }
+
+    void advance(size_t size)
+    {
+        if (static_cast<size_t>(end - p) < size)
+        {
+            throw std::runtime_error("truncated ONNX file");
+        }
+        p += size;
+    }
+
+    const char* p;
+    const char* end;
+};
+
+template <typename T>
+void
+decodeRaw(const std::string& raw, std::vector<T>& out)
+{
+    out.resize(raw.size() / sizeof(T));
+    std::memcpy(out.data(), raw.data(), out.size() * sizeof(T));
+}
+
+OnnxTensor
+readTensor(Message message)
+{
+    OnnxTensor tensor;
+    int32_t dataType = TYPE_FLOAT;
+    int32_t location = 0;
+    std::string raw;
+    std::vector<int64_t> ints;
+    std::vector<float> floats;
+    while (message.next())
+    {
+        switch (message.field)
+        {
+            case 1:
+                message.varints(tensor.shape);
+                break;
+            case 2:
+                dataType = static_cast<int32_t>(message.varint());
+                break;
+            case 4:
+                message.floats(floats);
+                break;
+            case 5: // int32_data, also used for bool
+            case 7: // int64_data
+                message.varints(ints);
+                break;
+            case 8:
+                tensor.name = message.string();
+                break;
+            case 9:
+                raw = message.string();
+                break;
+            case 10:
+                message.doubles(floats);
+                break;
+            case 14:
+                location = static_cast<int32_t>(message.varint());
+                break;
+            default:
+                message.skip();
+        }
+    }
+    if (location == LOCATION_EXTERNAL)
+    {
+        throw std::runtime_error("tensor " + tensor.name +
+                                 " uses external data, which is unsupported");
+    }
+
+    switch (dataType)
+    {
+        case TYPE_FLOAT:
+            tensor.type = ElementType::Float;
+            if (raw.empty())
+            {
+                tensor.floats = std::move(floats);
+            }
+            else
+            {
+                decodeRaw(raw, tensor.floats);
+            }
+            break;
+        case TYPE_DOUBLE:
+            tensor.type = ElementType::Float;
+            if (raw.empty())
+            {
+                tensor.floats = std::move(floats);
+            }
+            else
+            {
+                std::vector<double> values;
+                decodeRaw(raw, values);
+                tensor.floats.assign(values.begin(), values.end());
+            }
+            break;
+        case TYPE_INT64:
+            tensor.type = ElementType::Int64;
+            if (raw.empty())
+            {
+                tensor.ints = std::move(ints);
+            }
+            else
+            {
+                decodeRaw(raw, tensor.ints);
+            }
+            break;
+        case TYPE_INT32:
+        case TYPE_BOOL:
+            tensor.type = ElementType::Int64;
+            if (raw.empty())
+            {
+                tensor.ints = std::move(ints);
+            }
+            else if (dataType == TYPE_INT32)
+            {
+                std::vector<int32_t> values;
+                decodeRaw(raw, values);
+                tensor.ints.assign(values.begin(), values.end());
+            }
+            else
+            {
+                tensor.ints.assign(raw.begin(), raw.end());
+            }
+            break;
+        default:
+            throw std::runtime_error("tensor " + tensor.name +
+                                     " has an unsupported data type " +
+                                     std::to_string(dataType));
+    }
+    return tensor;
+}
+
+std::pair<std::string, OnnxAttribute>
+readAttribute(Message message)
+{
+    std::string name;
+    OnnxAttribute attribute;
+    while (message.next())
+    {
+        switch (message.field)
+        {
+            case 1:
+                name = message.string();
+                break;
+            case 2:
+                attribute.f = message.fixed32();
+                break;
+            case 3:
+                attribute.i = static_cast<int64_t>(message.varint());
+                break;
+            case 4:
+                attribute.s = message.string();
+                break;
+            case 5:
+                attribute.tensors.push_back(readTensor(message.delimited()));
+                break;
+            case 7:
+                message.floats(attribute.floats);
+                break;
+            case 8:
+                message.varints(attribute.ints);
+                break;
+            default:
+                message.skip();
+        }
+    }
+    return { name, std::move(attribute) };
+}
+
+OnnxNode
+readNode(Message message)
+{
+    OnnxNode node;
+    while (message.next())
+    {
+        switch (message.field)
+        {
+            case 1:
+                node.inputs.push_back(message.string());
+                break;
+            case 2:
+                node.outputs.push_back(message.string());
+                break;
+            case 3:
+                node.name = message.string();
+                break;
+            case 4:
+                node.opType = message.string();
+                break;
+            case 5:
+                node.attributes.insert(readAttribute(message.delimited()));
+                break;
+            case 7:
+                node.domain = message.string();
+                break;
+            default:
+                message.skip();
+        }
+    }
+    return node;
+}
+
+std::string
+readValueInfoName(Message message)
+{
+    std::string name;
+    while (message.next())
+    {
+        if (message.field == 1)
+        {
+            name = message.string();
+        }
+        else
+        {
+            message.skip();
+        }
+    }
+    return name;
+}
+
+std::string
+readTensorName(Message message)
+{
+    std::string name;
+    while (message.next())
+    {
+        if (message.field == 8)
+        {
+            name = message.string();
+        }
+        else
+        {
+            message.skip();
+        }
+    }
+    return name;
+}
+
+OnnxGraph
+readGraph(Message message)
+{
+    OnnxGraph graph;
+    std::vector<std::string> inputs;
+    while (message.next())
+    {
+        switch (message.field)
+        {
+            case 1:
+                graph.nodes.push_back(readNode(message.delimited()));
+                break;
+            case 5:
+                graph.initializers.push_back(readTensor(message.delimited()));
+                break;
+            case 11:
+                inputs.push_back(readValueInfoName(message.delimited()));
+                break;
+            case 12:
+                graph.outputs.push_back(
+                  readValueInfoName(message.delimited()));
+                break;
+            default:
+                message.skip();
+        }
+    }
+
+    // Older exporters list initializers among the inputs as well
+    std::set<std::string> weights;
+    for (const OnnxTensor& tensor : graph.initializers)
+    {
+        weights.insert(tensor.name);
+    }
+    for (const std::string& input : inputs)
+    {
+        if (!weights.count(input))
+        {
+            graph.inputs.push_back(input);
+        }
+    }
+    return graph;
+}
+std::string
+readModelFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open model " + path);
+    }
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+void
+appendVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void
+appendDelimited(std::string& out, int field, const std::string& payload)
+{
+    appendVarint(out, static_cast<uint64_t>(field) << 3 | DELIMITED);
+    appendVarint(out, payload.size());
+    out += payload;
+}
+
+// ValueInfoProto with a name and, for inputs, a float tensor type of
+// unknown shape; ORT infers the types of outputs
+std::string
+valueInfo(const std::string& name, bool typed)
+{
+    std::string info;
+    appendDelimited(info, 1, name);
+    if (typed)
+    {
+        std::string tensor;
+        appendVarint(tensor, 1 << 3 | VARINT);
+        appendVarint(tensor, TYPE_FLOAT);
+        std::string type;
+        appendDelimited(type, 1, tensor);
+        appendDelimited(info, 2, type);
+    }
+    return info;
+}
+
+// A graph decoded for splitting: parsed nodes next to the raw bytes of
+// every field, so stages are assembled from the original encodings
+struct RawGraph
+{
+    std::string name;
+    std::vector<OnnxNode> nodes;
+    std::vector<std::string> nodeBytes;
+    std::map<std::string, std::string> initializers; // name -> field bytes
+    std::map<std::string, std::string> inputs;
+    std::map<std::string, std::string> outputs;
+    std::vector<std::string> outputOrder;
+    std::map<std::string, std::string> valueInfo;
+};
+
+RawGraph
+readRawGraph(Message message)
+{
+    RawGraph graph;
+    while (true)
+    {
+        const char* start = message.cursor();
+        if (!message.next())
+        {
+            break;
+        }
+        if (message.wire != DELIMITED)
+        {
+            message.skip();
+            continue;
+        }
+        int field     = message.field;
+        Message inner = message.delimited();
+        std::string bytes(start, message.cursor());
+        switch (field)
+        {
+            case 1:
+                graph.nodes.push_back(readNode(inner));
+                graph.nodeBytes.push_back(std::move(bytes));
+                break;
+            case 2:
+                graph.name = std::string(inner.cursor(), message.cursor());
+                break;
+            case 5:
+                graph.initializers[readTensorName(inner)] = std::move(bytes);
+                break;
+            case 11:
+                graph.inputs[readValueInfoName(inner)] = std::move(bytes);
+                break;
+            case 12:
+            {
+                std::string name = readValueInfoName(inner);
+                graph.outputOrder.push_back(name);
+                graph.outputs[name] = std::move(bytes);
+                break;
+            }
+            case 13:
+                graph.valueInfo[readValueInfoName(inner)] = std::move(bytes);
+                break;
+            default:
+                break;
+        }
+    }
+    return graph;
+}
+
+// Calls `visit` with each initializer of the model's main graph
+template <typename Visit>
+void
+forEachInitializer(const char* model, size_t size, Visit visit)
+{
+    Message message(model, model + size);
+    while (message.next())
+    {
+        if (message.field != 7 || message.wire != DELIMITED)
+        {
+            message.skip();
+            continue;
+        }
+        Message graph = message.delimited();
+        while (graph.next())
+        {
+            if (graph.field == 5 && graph.wire == DELIMITED)
+            {
+                visit(graph.delimited());
+            }
+            else
+            {
+                graph.skip();
+            }
+        }
+    }
+}
+
+std::string
+tensorName(Message tensor)
+{
+    while (tensor.next())
+    {
+        if (tensor.field == 8)
+        {
+            return tensor.string();
+        }
+        tensor.skip();
+    }
+    return "";
+}
+} // namespace
+
+int64_t
+OnnxNode::intAttr(const char* key, int64_t fallback) const
+{
+    auto it = attributes.find(key);
+    return it == attributes.end() ? fallback : it->second.i;
+}
+
+float
+OnnxNode::floatAttr(const char* key, float fallback) const
+{
+    auto it = attributes.find(key);
+    return it == attributes.end() ? fallback : it->second.f;
+}
+
+std::vector<int64_t>
+OnnxNode::intsAttr(const char* key) const
+{
+    auto it = attributes.find(key);
+    return it == attributes.end() ? std::vector<int64_t>() : it->second.ints;
+}
+
+OnnxGraph
+loadOnnxGraph(const std::string& path)
+{
+    std::string bytes = readModelFile(path);
+    Message model(bytes.data(), bytes.data() + bytes.size());
+    while (model.next())
+    {
+        if (model.field == 7)
+        {
+            return readGraph(model.delimited());
+        }
+        model.skip();
+    }
+    throw std::runtime_error(path + " has no graph");
+}
+
+std::vector<OnnxStage>
+splitOnnxModel(const std::string& path, const std::vector<std::string>& cuts)
+{
+    std::string bytes = readModelFile(path);
+
+    // Everything but the graph (IR version, opsets, metadata) is shared
+    std::string header;
+    RawGraph graph;
+    bool found = false;
+    Message model(bytes.data(), bytes.data() + bytes.size());
+    while (true)
+    {
+        const char* start = model.cursor();
+        if (!model.next())
+        {
+            break;
+        }
+        if (model.field == 7 && model.wire == DELIMITED)
+        {
+            graph = readRawGraph(model.delimited());
+            found = true;
+        }
+        else
+        {
+            model.skip();
+            header.append(start, model.cursor());
+        }
+    }
+    if (!found)
+    {
+        throw std::runtime_error(path + " has no graph");
+    }
+
+    std::map<std::string, size_t> producer;
+    for (size_t n = 0; n < graph.nodes.size(); ++n)
+    {
+        for (const std::string& output : graph.nodes[n].outputs)
+        {
+            producer[output] = n;
+        }
+    }
+
+    // Stage k claims the unclaimed ancestors of cuts[k] and the last stage
+    // those of the first graph output (the audio); what is left, typically
+    // state updates, runs in the earliest stage that has its inputs
+    if (graph.outputOrder.empty())
+    {
+        throw std::runtime_error(path + " has no outputs");
+    }
+    std::vector<std::string> targets = cuts;
+    targets.push_back(graph.outputOrder[0]);
+    const size_t UNASSIGNED = targets.size();
+    std::vector<size_t> stageOf(graph.nodes.size(), UNASSIGNED);
+    for (size_t k = 0; k < targets.size(); ++k)
+    {
+        auto it = producer.find(targets[k]);
+        if (it == producer.end())
+        {
+            throw std::runtime_error("no node produces " + targets[k]);
+        }
+        size_t claimed = 0;
+        std::vector<size_t> pending = { it->second };
+        while (!pending.empty())
+        {
+            size_t n = pending.back();
+            pending.pop_back();
+            if (stageOf[n] != UNASSIGNED)
+            {
+                continue;
+            }
+            stageOf[n] = k;
+            ++claimed;
+            for (const std::string& input : graph.nodes[n].inputs)
+            {
+                auto from = producer.find(input);
+                if (from != producer.end())
+                {
+                    pending.push_back(from->second);
+                }
+            }
+        }
+        if (claimed == 0)
+        {
+            throw std::runtime_error(targets[k] +
+                                     " is already computed by an earlier "
+                                     "stage");
+        }
+    }
+    // A graph input counts as available from the first stage reading it,
+    // so a state input and its update stay in one stage; weights are
+    // available everywhere
+    std::map<std::string, size_t> firstReader;
+    for (size_t n = 0; n < graph.nodes.size(); ++n)
+    {
+        for (const std::string& input : graph.nodes[n].inputs)
+        {
+            if (stageOf[n] != UNASSIGNED && !producer.count(input) &&
+                !graph.initializers.count(input))
+            {
+                auto it = firstReader.emplace(input, stageOf[n]).first;
+                it->second = std::min(it->second, stageOf[n]);
+            }
+        }
+    }
+    for (size_t n = 0; n < graph.nodes.size(); ++n)
+    {
+        if (stageOf[n] != UNASSIGNED)
+        {
+            continue;
+        }
+        stageOf[n] = 0;
+        for (const std::string& input : graph.nodes[n].inputs)
+        {
+            auto from  = producer.find(input);
+            auto first = firstReader.find(input);
+            if (from != producer.end())
+            {
+                stageOf[n] = std::max(stageOf[n], stageOf[from->second]);
+            }
+            else if (first != firstReader.end())
+            {
+                stageOf[n] = std::max(stageOf[n], first->second);
+            }
+        }
+    }
+
+    // Last reader of every value, to decide which values leave a stage
+    std::map<std::string, size_t> lastReader;
+    for (size_t n = 0; n < graph.nodes.size(); ++n)
+    {
+        for (const std::string& input : graph.nodes[n].inputs)
+        {
+            size_t& last = lastReader[input];
+            last         = std::max(last, stageOf[n]);
+        }
+    }
+
+    std::vector<OnnxStage> stages(targets.size());
+    for (size_t k = 0; k < stages.size(); ++k)
+    {
+        OnnxStage& stage = stages[k];
+        std::string body;
+        std::set<std::string> produced, declared, weights;
+        for (size_t n = 0; n < graph.nodes.size(); ++n)
+        {
+            if (stageOf[n] != k)
+            {
+                continue;
+            }
+            body += graph.nodeBytes[n];
+            const OnnxNode& node = graph.nodes[n];
+            for (const std::string& input : node.inputs)
+            {
+                if (input.empty() || produced.count(input))
+                {
+                    continue;
+                }
+                if (graph.initializers.count(input))
+                {
+                    if (weights.insert(input).second)
+                    {
+                        body += graph.initializers[input];
+                    }
+                }
+                else if (declared.insert(input).second)
+                {
+                    stage.inputs.push_back(input);
+                }
+            }
+            for (const std::string& output : node.outputs)
+            {
+                produced.insert(output);
+                auto reader = lastReader.find(output);
+                if (graph.outputs.count(output) ||
+                    (reader != lastReader.end() && reader->second > k))
+                {
+                    stage.outputs.push_back(output);
+                }
+            }
+        }
+        if (body.empty())
+        {
+            throw std::runtime_error("stage " + std::to_string(k) +
+                                     " has no nodes");
+        }
+
+        appendDelimited(body, 2, graph.name + "_stage" + std::to_string(k));
+        for (const std::string& input : stage.inputs)
+        {
+            auto original = graph.inputs.find(input);
+            auto info     = graph.valueInfo.find(input);
+            if (original != graph.inputs.end())
+            {
+                body += original->second;
+            }
+            else if (info != graph.valueInfo.end())
+            {
+                // The same message, re-tagged from value_info to input
+                std::string payload = info->second;
+                payload[0] = static_cast<char>(11 << 3 | DELIMITED);
+                body += payload;
+            }
+            else
+            {
+                appendDelimited(body, 11, valueInfo(input, true));
+            }
+        }
+        for (const std::string& output : stage.outputs)
+        {
+            auto original = graph.outputs.find(output);
+            if (original != graph.outputs.end())
+            {
+                body += original->second;
+            }
+            else
+            {
+                appendDelimited(body, 12, valueInfo(output, false));
+            }
+        }
+
+        stage.model = header;
+        appendDelimited(stage.model, 7, body);
+    }
+    return stages;
+}
+
+std::string
+syntheticOnnxModel(const std::vector<std::string>& inputs,
+                   const std::vector<std::string>& outputs)
+{
+    if (inputs.size() != outputs.size())
+    {
+        throw std::runtime_error(
+          "synthetic model needs one output per input");
+    }
+
+    // Scalar initializer holding 0.5f, broadcast by every Mul
+    const float half = 0.5f;
+    std::string scale;
+    appendVarint(scale, 2 << 3 | VARINT);
+    appendVarint(scale, TYPE_FLOAT);
+    appendDelimited(scale, 8, "half");
+    appendDelimited(scale,
+                    9,
+                    std::string(reinterpret_cast<const char*>(&half),
+                                sizeof(half)));
+
+    std::string graph;
+    for (size_t k = 0; k < inputs.size(); ++k)
+    {
+        std::string node;
+        appendDelimited(node, 1, inputs[k]);
+        appendDelimited(node, 1, "half");
+        appendDelimited(node, 2, outputs[k]);
+        appendDelimited(node, 3, "scale_" + inputs[k]);
+        appendDelimited(node, 4, "Mul");
+        appendDelimited(graph, 1, node);
+    }
+    appendDelimited(graph, 2, "synthetic");
+    appendDelimited(graph, 5, scale);
+    for (const std::string& input : inputs)
+    {
+        appendDelimited(graph, 11, valueInfo(input, true));
+    }
+    for (const std::string& output : outputs)
+    {
+        appendDelimited(graph, 12, valueInfo(output, true));
+    }
+
+    std::string opset;
+    appendDelimited(opset, 1, "");
+    appendVarint(opset, 2 << 3 | VARINT);
+    appendVarint(opset, SYNTHETIC_OPSET);
+
+    std::string model;
+    appendVarint(model, 1 << 3 | VARINT);
+    appendVarint(model, SYNTHETIC_IR_VERSION);
+    appendDelimited(model, 2, "llvc");
+    appendDelimited(model, 7, graph);
+    appendDelimited(model, 8, opset);
+    return model;
+}
+
+std::vector<InitializerData>
+locateInitializers(const char* model, size_t size)
+{
+    std::vector<InitializerData> found;
+    forEachInitializer(model, size, [&](Message tensor) {
+        InitializerData data;
+        bool raw         = false;
+        int32_t location = 0;
+        while (tensor.next())
+        {
+            switch (tensor.field)
+            {
+                case 1:
+                    tensor.varints(data.shape);
+                    break;
+                case 2:
+                    data.dataType = static_cast<int32_t>(tensor.varint());
+                    break;
+                case 8:
+                    data.name = tensor.string();
+                    break;
+                case 9:
+                {
+                    Message bytes = tensor.delimited();
+                    data.offset   = bytes.cursor() - model;
+                    data.length   = bytes.remaining();
+                    raw           = true;
+                    break;
+                }
+                case 13:
+                {
+                    std::string key, value;
+                    Message entry = tensor.delimited();
+                    while (entry.next())
+                    {
+                        if (entry.field == 1)
+                        {
+                            key = entry.string();
+                        }
+                        else if (entry.field == 2)
+                        {
+                            value = entry.string();
+                        }
+                        else
+                        {
+                            entry.skip();
+                        }
+                    }
+                    if (key == "location")
+                    {
+                        data.location = value;
+                    }
+                    else if (key == "offset")
+                    {
+                        data.offset = std::stoull(value);
+                    }
+                    else if (key == "length")
+                    {
+                        data.length = std::stoull(value);
+                    }
+                    break;
+                }
+                case 14:
+                    location = static_cast<int32_t>(tensor.varint());
+                    break;
+                default:
+                    tensor.skip();
+            }
+        }
+        if (location == LOCATION_EXTERNAL ? !data.location.empty() : raw)
+        {
+            if (location != LOCATION_EXTERNAL)
+            {
+                data.location.clear();
+            }
+            found.push_back(std::move(data));
+        }
+    });
+    return found;
+}
+
+std::string
+stripInitializers(const char* model,
+                  size_t size,
+                  const std::set<std::string>& names,
+                  const std::map<std::string, std::string>& inlined)
+{
+    // Rebuilt field by field; everything but the stripped tensors' data
+    // fields is copied verbatim
+    std::string out;
+    Message top(model, model + size);
+    while (true)
+    {
+        const char* start = top.cursor();
+        if (!top.next())
+        {
+            break;
+        }
+        if (top.field != 7 || top.wire != DELIMITED)
+        {
+            top.skip();
+            out.append(start, top.cursor());
+            continue;
+        }
+        std::string graphBytes;
+        Message graph = top.delimited();
+        while (true)
+        {
+            const char* fieldStart = graph.cursor();
+            if (!graph.next())
+            {
+                break;
+            }
+            if (graph.field != 5 || graph.wire != DELIMITED)
+            {
+                graph.skip();
+                graphBytes.append(fieldStart, graph.cursor());
+                continue;
+            }
+            Message tensor   = graph.delimited();
+            std::string name = tensorName(tensor);
+            auto bytes       = inlined.find(name);
+            if (!names.count(name) && bytes == inlined.end())
+            {
+                graphBytes.append(fieldStart, graph.cursor());
+                continue;
+            }
+            std::string tensorBytes;
+            while (true)
+            {
+                const char* tensorField = tensor.cursor();
+                if (!tensor.next())
+                {
+                    break;
+                }
+                int field = tensor.field;
+                tensor.skip();
+                if (field != 9 && field != 13 && field != 14)
+                {
+                    tensorBytes.append(tensorField, tensor.cursor());
+                }
+            }
+            if (bytes != inlined.end())
+            {
+                appendDelimited(tensorBytes, 9, bytes->second);
+            }
+            else
+            {
+                std::string entry;
+                appendDelimited(entry, 1, "location");
+                appendDelimited(entry, 2, SUPPLIED_LOCATION);
+                appendDelimited(tensorBytes, 13, entry);
+                appendVarint(tensorBytes, 14 << 3 | VARINT);
+                appendVarint(tensorBytes, LOCATION_EXTERNAL);
+            }
+            appendDelimited(graphBytes, 5, tensorBytes);
+        }
+        appendDelimited(out, 7, graphBytes);
+    }
+    return out;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Minimal reader for .onnx files: nodes, attributes, initializers and the
+// graph's input / output names, decoded straight from the protobuf wire
+// format so the native engine needs no protobuf or ORT dependency.
+// Weights stored in external data files are not supported.
+
+enum class ElementType
+{
+    Float,
+    Int64 // also holds int32 and bool tensors
+};
+
+struct OnnxTensor
+{
+    std::string name;
+    ElementType type = ElementType::Float;
+    std::vector<int64_t> shape;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+};
+
+struct OnnxAttribute
+{
+    float f   = 0.0f;
+    int64_t i = 0;
+    std::string s;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+    std::vector<OnnxTensor> tensors; // at most one, for Constant's `value`
+};
+
+struct OnnxNode
+{
+    std::string name;
+    std::string opType;
+    std::string domain;
+    std::vector<std::string> inputs; // "" marks an omitted optional input
+    std::vector<std::string> outputs;
+    std::map<std::string, OnnxAttribute> attributes;
+
+    int64_t intAttr(const char* key, int64_t fallback) const;
+    float floatAttr(const char* key, float fallback) const;
+    std::vector<int64_t> intsAttr(const char* key) const;
+};
+
+struct OnnxGraph
+{
+    std::vector<OnnxNode> nodes; // topologically sorted, as ONNX requires
+    std::vector<OnnxTensor> initializers;
+    std::vector<std::string> inputs; // excluding initializers
+    std::vector<std::string> outputs;
+};
+
+// One stage of a split model, serialized as a self-contained model that ORT
+// can load from memory
+struct OnnxStage
+{
+    std::string model;
+    std::vector<std::string> inputs;  // graph inputs or earlier stages' values
+    std::vector<std::string> outputs; // graph outputs or values read later
+};
+
+// Where one initializer's bytes are stored
+struct InitializerData
+{
+    std::string name;
+    int32_t dataType = 0; // onnx.proto TensorProto.DataType
+    std::vector<int64_t> shape;
+    std::string location; // external data file, or empty for raw_data
+    size_t offset = 0;    // into the model bytes or the external file
+    size_t length = 0;    // in bytes
+};
+
+// Throws std::runtime_error on I/O errors or malformed files
+OnnxGraph
+loadOnnxGraph(const std::string& path);
+
+// The main graph's initializers that are stored as raw bytes, inline or
+// in external data files (a length of 0 there means "to the end of the
+// file"); those held in typed fields such as float_data are not listed
+std::vector<InitializerData>
+locateInitializers(const char* model, size_t size);
+
+// A copy of `model` in which the initializers in `names` carry no data and
+// are marked external, for ORT to take from
+// SessionOptions::AddExternalInitializers instead. Those in `inlined` get
+// the given bytes as raw_data in place of any external reference.
+std::string
+stripInitializers(const char* model,
+                  size_t size,
+                  const std::set<std::string>& names,
+                  const std::map<std::string, std::string>& inlined = {});
+
+// Splits the model into cuts.size() + 1 stages. Stage k holds the nodes
+// tensor cuts[k] depends on that no earlier stage holds, the last stage
+// those the first graph output depends on, and any other node (such as a
+// state update) joins the earliest stage that has its inputs. Values thus
+// only flow from earlier stages to later ones. Values crossing a cut are
+// declared float unless the model's value_info says otherwise. Throws
+// std::runtime_error for unknown or empty cuts.
+std::vector<OnnxStage>
+splitOnnxModel(const std::string& path, const std::vector<std::string>& cuts);
+
+// A stand-in model with the given float inputs and outputs, for running
+// benchmarks without real weights: output k is input k scaled by one half.
+// Shapes are left open, so any block size is accepted. Serialized for
+// ORT's in-memory session constructor.
+std::string
+syntheticOnnxModel(const std::vector<std::string>& inputs,
+                   const std::vector<std::string>& outputs);
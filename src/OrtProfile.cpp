@@ -0,0 +1,407 @@
+#include "OrtProfile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+// Just enough JSON to walk ORT's trace: strings and numbers are decoded,
+// everything else is skipped structurally.
+class JsonReader
+{
+  public:
+    explicit JsonReader(const std::string& text)
+      : begin(text.data())
+      , p(text.data())
+      , end(text.data() + text.size())
+    {
+    }
+
+    void expect(char c)
+    {
+        if (!consume(c))
+        {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (p < end && *p == c)
+        {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    char peek()
+    {
+        skipSpace();
+        return p < end ? *p : '\0';
+    }
+
+    std::string readString()
+    {
+        expect('"');
+        std::string out;
+        while (p < end && *p != '"')
+        {
+            char c = *p++;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (p >= end)
+            {
+                break;
+            }
+            switch (char e = *p++)
+            {
+                case 'n':
+                    out += '\n';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'u':
+                    appendCodePoint(out);
+                    break;
+                default: // '"', '\\', '/'
+                    out += e;
+            }
+        }
+        expect('"');
+        return out;
+    }
+
+    double readNumber()
+    {
+        skipSpace();
+        char* stop   = nullptr;
+        double value = std::strtod(p, &stop);
+        if (stop == p)
+        {
+            fail("expected a number");
+        }
+        p = stop;
+        return value;
+    }
+
+    // Numbers are sometimes written as strings (e.g. in args)
+    double readNumberOrString()
+    {
+        if (peek() == '"')
+        {
+            return std::strtod(readString().c_str(), nullptr);
+        }
+        return readNumber();
+    }
+
+    void skipValue()
+    {
+        switch (peek())
+        {
+            case '"':
+                readString();
+                return;
+            case '{':
+                ++p;
+                if (!consume('}'))
+                {
+                    do
+                    {
+                        readString();
+                        expect(':');
+                        skipValue();
+                    } while (consume(','));
+                    expect('}');
+                }
+                return;
+            case '[':
+                ++p;
+                if (!consume(']'))
+                {
+                    do
+                    {
+                        skipValue();
+                    } while (consume(','));
+                    expect(']');
+                }
+                return;
+            default:
+                // true / false / null or a number
+                while (p < end &&
+                       (std::isalnum(static_cast<unsigned char>(*p)) ||
+                        std::strchr("+-.", *p)))
+                {
+                    ++p;
+                }
+        }
+    }
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw std::runtime_error("profile JSON: " + message + " at offset " +
+                                 std::to_string(p - begin));
+    }
+
+  private:
+    void skipSpace()
+    {
+        while (p < end && std::isspace(static_cast<unsigned char>(*p)))
+        {
+            ++p;
+        }
+    }
+
+    void appendCodePoint(std::string& out)
+    {
+        if (end - p < 4)
+        {
+            fail("bad \\u escape");
+        }
+        unsigned cp = std::strtoul(std::string(p, 4).c_str(), nullptr, 16);
+        p += 4;
+        if (cp < 0x80)
+        {
+            out += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
+    const char* begin;
+    const char* p;
+    const char* end;
+};
+
+ProfileEvent
+readEvent(JsonReader& reader)
+{
+    ProfileEvent event;
+    reader.expect('{');
+    if (reader.consume('}'))
+    {
+        return event;
+    }
+    do
+    {
+        std::string key = reader.readString();
+        reader.expect(':');
+        if (key == "cat")
+        {
+            event.category = reader.readString();
+        }
+        else if (key == "name")
+        {
+            event.name = reader.readString();
+        }
+        else if (key == "ts")
+        {
+            event.timestamp = static_cast<int64_t>(reader.readNumberOrString());
+        }
+        else if (key == "dur")
+        {
+            event.duration = static_cast<int64_t>(reader.readNumberOrString());
+        }
+        else if (key == "args" && reader.peek() == '{')
+        {
+            reader.expect('{');
+            if (!reader.consume('}'))
+            {
+                do
+                {
+                    std::string arg = reader.readString();
+                    reader.expect(':');
+                    if (arg == "op_name" && reader.peek() == '"')
+                    {
+                        event.opName = reader.readString();
+                    }
+                    else if (arg == "provider" && reader.peek() == '"')
+                    {
+                        event.provider = reader.readString();
+                    }
+                    else
+                    {
+                        reader.skipValue();
+                    }
+                } while (reader.consume(','));
+                reader.expect('}');
+            }
+        }
+        else
+        {
+            reader.skipValue();
+        }
+    } while (reader.consume(','));
+    reader.expect('}');
+    return event;
+}
+
+const char KERNEL_SUFFIX[] = "_kernel_time";
+
+bool
+endsWith(const std::string& text, const char* suffix)
+{
+    size_t length = std::strlen(suffix);
+    return text.size() >= length &&
+           text.compare(text.size() - length, length, suffix) == 0;
+}
+
+std::vector<KernelTime>
+ranked(const std::unordered_map<std::string, KernelTime>& totals)
+{
+    std::vector<KernelTime> out;
+    out.reserve(totals.size());
+    for (const auto& entry : totals)
+    {
+        out.push_back(entry.second);
+    }
+    std::sort(out.begin(),
+              out.end(),
+              [](const KernelTime& a, const KernelTime& b) {
+                  return a.totalUs != b.totalUs ? a.totalUs > b.totalUs
+                                                : a.name < b.name;
+              });
+    return out;
+}
+} // namespace
+
+std::vector<ProfileEvent>
+parseProfile(const std::string& json)
+{
+    JsonReader reader(json);
+    std::vector<ProfileEvent> events;
+    reader.expect('[');
+    if (reader.consume(']'))
+    {
+        return events;
+    }
+    do
+    {
+        if (reader.peek() == ']')
+        {
+            break; // tolerate a trailing comma
+        }
+        events.push_back(readEvent(reader));
+    } while (reader.consume(','));
+    reader.expect(']');
+    return events;
+}
+
+std::vector<ProfileEvent>
+loadProfile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open profile " + path);
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return parseProfile(text.str());
+}
+
+double
+sessionEventMs(const std::vector<ProfileEvent>& events, const char* name)
+{
+    int64_t total = 0;
+    for (const ProfileEvent& event : events)
+    {
+        if (event.category == "Session" && event.name == name)
+        {
+            total += event.duration;
+        }
+    }
+    return total / 1000.0;
+}
+
+ProfileSummary
+summarizeProfile(const std::vector<ProfileEvent>& events, size_t skipRuns)
+{
+    // Runs are not nested, so the warm-up ends where the last skipped
+    // model_run does
+    std::vector<const ProfileEvent*> runs;
+    for (const ProfileEvent& event : events)
+    {
+        if (event.category == "Session" && event.name == "model_run")
+        {
+            runs.push_back(&event);
+        }
+    }
+    std::sort(runs.begin(),
+              runs.end(),
+              [](const ProfileEvent* a, const ProfileEvent* b) {
+                  return a->timestamp < b->timestamp;
+              });
+
+    ProfileSummary summary;
+    int64_t start = 0;
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        if (i < skipRuns)
+        {
+            start = runs[i]->timestamp + runs[i]->duration;
+            continue;
+        }
+        ++summary.runs;
+        summary.runUs += runs[i]->duration;
+    }
+
+    // Fence and other bookkeeping events are not kernel time
+    std::unordered_map<std::string, KernelTime> byOp;
+    std::unordered_map<std::string, KernelTime> byNode;
+    for (const ProfileEvent& event : events)
+    {
+        if (event.category != "Node" || event.timestamp < start ||
+            !endsWith(event.name, KERNEL_SUFFIX))
+        {
+            continue;
+        }
+        std::string node =
+          event.name.substr(0, event.name.size() - std::strlen(KERNEL_SUFFIX));
+
+        KernelTime& op = byOp[event.opName];
+        op.name        = event.opName;
+        op.opType      = event.opName;
+        ++op.calls;
+        op.totalUs += event.duration;
+
+        KernelTime& kernel = byNode[node];
+        kernel.name        = node;
+        kernel.opType      = event.opName;
+        ++kernel.calls;
+        kernel.totalUs += event.duration;
+
+        summary.kernelUs += event.duration;
+    }
+    summary.operators = ranked(byOp);
+    summary.nodes     = ranked(byNode);
+    return summary;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reader for the JSON trace ORT writes when profiling is enabled
+// (SessionOptions::EnableProfiling). The trace is an array of events:
+// "Session" events time model loading, initialization and each Run;
+// "Node" events time every kernel, with the operator type in args.
+
+struct ProfileEvent
+{
+    std::string category; // "Session" or "Node"
+    std::string name;     // e.g. "model_loading_uri", "Conv_12_kernel_time"
+    std::string opName;   // args.op_name (Node events)
+    std::string provider; // args.provider (Node events)
+    int64_t timestamp = 0; // us since the profiler started
+    int64_t duration  = 0; // us
+};
+
+// Throws std::runtime_error on I/O or syntax errors
+std::vector<ProfileEvent>
+parseProfile(const std::string& json);
+
+std::vector<ProfileEvent>
+loadProfile(const std::string& path);
+
+// Total duration in ms of the Session events called `name`
+double
+sessionEventMs(const std::vector<ProfileEvent>& events, const char* name);
+
+// Kernel time of one operator type or one graph node, summed over runs
+struct KernelTime
+{
+    std::string name; // node name, or the operator type for per-op totals
+    std::string opType;
+    size_t calls    = 0;
+    int64_t totalUs = 0;
+};
+
+struct ProfileSummary
+{
+    size_t runs      = 0; // model_run events aggregated
+    int64_t runUs    = 0; // their total wall time
+    int64_t kernelUs = 0; // total of all kernels in those runs
+    std::vector<KernelTime> operators; // descending by totalUs
+    std::vector<KernelTime> nodes;     // descending by totalUs
+};
+
+// Aggregates kernel events by operator type and by node, ignoring
+// everything up to the end of the first `skipRuns` runs (warm-up)
+ProfileSummary
+summarizeProfile(const std::vector<ProfileEvent>& events, size_t skipRuns);
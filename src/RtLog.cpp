@@ -0,0 +1,150 @@
+#include "RtLog.h"
+#include <chrono>
+
+namespace
+{
+const auto WRITE_INTERVAL = std::chrono::milliseconds(10);
+
+int64_t
+steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+RtLog::RtLog(size_t capacity, std::ostream& out)
+  : out(out)
+  , startNanos(steadyNanos())
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    records = std::vector<Record>(size);
+    mask    = size - 1;
+    for (size_t i = 0; i < size; ++i)
+    {
+        records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread([this] { run(); });
+}
+
+RtLog::~RtLog()
+{
+    stopping.store(true);
+    writer.join();
+}
+
+bool
+RtLog::log(const char* message)
+{
+    return push(message, 0, 0, 0);
+}
+
+bool
+RtLog::log(const char* message, int64_t value)
+{
+    return push(message, 1, value, 0);
+}
+
+bool
+RtLog::log(const char* message, int64_t value, int64_t value2)
+{
+    return push(message, 2, value, value2);
+}
+
+bool
+RtLog::push(const char* message, int valueCount, int64_t a, int64_t b)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Record* record;
+    while (true)
+    {
+        record          = &records[pos & mask];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        intptr_t diff   = static_cast<intptr_t>(sequence - pos);
+        if (diff == 0)
+        {
+            // The slot is free for this lap; claim it
+            if (enqueuePos.compare_exchange_weak(
+                  pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false; // full: the writer has not reached this slot yet
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    record->nanos      = steadyNanos();
+    record->message    = message;
+    record->values[0]  = a;
+    record->values[1]  = b;
+    record->valueCount = valueCount;
+    record->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t
+RtLog::drain()
+{
+    size_t count = 0;
+    while (true)
+    {
+        Record& record  = records[dequeuePos & mask];
+        size_t sequence = record.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1)
+        {
+            break; // empty, or the producer is still filling it in
+        }
+        out << "[" << (record.nanos - startNanos) / 1e9 << " s] "
+            << record.message;
+        for (int v = 0; v < record.valueCount; ++v)
+        {
+            out << (v == 0 ? ": " : ", ") << record.values[v];
+        }
+        out << '\n';
+        record.sequence.store(dequeuePos + records.size(),
+                              std::memory_order_release);
+        ++dequeuePos;
+        ++count;
+    }
+    return count;
+}
+
+void
+RtLog::run()
+{
+    size_t reportedDrops = 0;
+    bool last            = false;
+    while (!last)
+    {
+        last         = stopping.load();
+        size_t count = drain();
+        size_t total = dropped();
+        if (total != reportedDrops)
+        {
+            out << "[log] " << total - reportedDrops
+                << " records dropped, ring full\n";
+            reportedDrops = total;
+        }
+        if (count > 0 || last)
+        {
+            writes.fetch_add(count, std::memory_order_relaxed);
+            out.flush();
+        }
+        if (!last)
+        {
+            std::this_thread::sleep_for(WRITE_INTERVAL);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Logging that is safe to call from the audio callback and other real-time
+// threads: log() copies a fixed-size record into a preallocated ring with a
+// few atomic operations, and a background thread formats and writes the
+// records. Nothing on the calling side locks, allocates or blocks; when the
+// ring is full the record is dropped and counted instead.
+//
+// The ring is a bounded multi-producer queue with per-slot sequence numbers
+// (after Vyukov), drained by the writer thread alone.
+
+class RtLog
+{
+  public:
+    // `capacity` is rounded up to a power of two
+    explicit RtLog(size_t capacity, std::ostream& out);
+
+    // Writes what is still queued, then stops the writer
+    ~RtLog();
+
+    RtLog(const RtLog&) = delete;
+    RtLog& operator=(const RtLog&) = delete;
+
+    // `message` must outlive the log (a string literal); only the pointer
+    // is stored. Up to two integers are printed after it. Returns false if
+    // the record was dropped.
+    bool log(const char* message);
+    bool log(const char* message, int64_t value);
+    bool log(const char* message, int64_t value, int64_t value2);
+
+    size_t dropped() const { return drops.load(std::memory_order_relaxed); }
+    size_t written() const { return writes.load(std::memory_order_relaxed); }
+
+  private:
+    struct Record
+    {
+        std::atomic<size_t> sequence{ 0 };
+        int64_t nanos; // steady clock
+        const char* message;
+        int64_t values[2];
+        int valueCount;
+    };
+
+    bool push(const char* message, int valueCount, int64_t a, int64_t b);
+    size_t drain();
+    void run();
+
+    std::vector<Record> records;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+    alignas(64) size_t dequeuePos = 0; // writer thread only
+    std::atomic<size_t> drops{ 0 };
+    std::atomic<size_t> writes{ 0 };
+    std::ostream& out;
+    int64_t startNanos;
+    std::atomic<bool> stopping{ false };
+    std::thread writer;
+};
@@ -0,0 +1,317 @@
+#include "ShmTransport.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+[[noreturn]] void
+throwErrno(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+size_t
+alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t
+ringBytes(const ShmHeader& header)
+{
+    return alignUp(
+      size_t(header.ringBlocks) * header.blockSize * sizeof(float), 64);
+}
+
+// Futex words live in a shared mapping, so the non-private ops are used
+int
+futex(std::atomic<uint32_t>& word, int op, uint32_t value, timespec* timeout)
+{
+    return static_cast<int>(syscall(SYS_futex,
+                                    reinterpret_cast<uint32_t*>(&word),
+                                    op,
+                                    value,
+                                    timeout,
+                                    nullptr,
+                                    0));
+}
+} // namespace
+
+void
+ringDoorbell(ShmDoorbell& bell)
+{
+    bell.sequence.fetch_add(1, std::memory_order_seq_cst);
+    if (bell.sleeping.load(std::memory_order_seq_cst))
+    {
+        futex(bell.sequence, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+}
+
+void
+waitDoorbell(ShmDoorbell& bell, uint32_t seen, int timeoutMs)
+{
+    // Any ring after `seen` was read changes the sequence, so the kernel
+    // returns immediately instead of missing the wake-up.
+    timespec timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000000L };
+    bell.sleeping.store(1, std::memory_order_seq_cst);
+    futex(bell.sequence, FUTEX_WAIT, seen, &timeout);
+    bell.sleeping.store(0, std::memory_order_relaxed);
+}
+
+ShmSegment::ShmSegment(void* base,
+                       size_t size,
+                       const std::string& name,
+                       bool owner)
+  : base(base)
+  , size(size)
+  , name(name)
+  , owner(owner)
+{
+}
+
+ShmSegment::ShmSegment(ShmSegment&& other) noexcept
+  : base(other.base)
+  , size(other.size)
+  , name(std::move(other.name))
+  , owner(other.owner)
+{
+    other.base  = nullptr;
+    other.owner = false;
+}
+
+ShmSegment::~ShmSegment()
+{
+    if (base)
+    {
+        munmap(base, size);
+    }
+    if (owner)
+    {
+        shm_unlink(name.c_str());
+    }
+}
+
+ShmSegment
+ShmSegment::create(const std::string& name,
+                   uint32_t maxStreams,
+                   uint32_t blockSize,
+                   uint32_t ringBlocks,
+                   uint32_t workers)
+{
+    if (workers == 0 || workers > SHM_MAX_WORKERS || maxStreams == 0 ||
+        blockSize == 0 || ringBlocks == 0)
+    {
+        throw std::invalid_argument("invalid shared memory layout");
+    }
+
+    ShmHeader layout{};
+    layout.blockSize  = blockSize;
+    layout.ringBlocks = ringBlocks;
+    layout.slotOffset = alignUp(sizeof(ShmHeader), 64);
+    layout.slotStride =
+      alignUp(sizeof(ShmSlot), 64) + 2 * ringBytes(layout);
+    size_t size = layout.slotOffset + size_t(maxStreams) * layout.slotStride;
+
+    // Replace a segment left behind by a crashed daemon
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0)
+    {
+        throwErrno("shm_open " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        throwErrno("ftruncate " + name);
+    }
+    void* base =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throwErrno("mmap " + name);
+    }
+
+    // ftruncate zero-fills, which is a valid initial state for every atomic
+    ShmSegment segment(base, size, name, true);
+    ShmHeader& header = segment.header();
+    header.version    = SHM_VERSION;
+    header.maxStreams = maxStreams;
+    header.blockSize  = blockSize;
+    header.ringBlocks = ringBlocks;
+    header.workers    = workers;
+    header.slotOffset = layout.slotOffset;
+    header.slotStride = layout.slotStride;
+    for (uint32_t i = 0; i < maxStreams; ++i)
+    {
+        segment.slot(i).worker = i % workers;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header.magic = SHM_MAGIC;
+    return segment;
+}
+
+ShmSegment
+ShmSegment::attach(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        throwErrno("shm_open " + name);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        throwErrno("fstat " + name);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* base =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        throwErrno("mmap " + name);
+    }
+
+    ShmSegment segment(base, size, name, false);
+    const ShmHeader& header = segment.header();
+    if (size < sizeof(ShmHeader) || header.magic != SHM_MAGIC ||
+        header.version != SHM_VERSION ||
+        size < header.slotOffset + header.maxStreams * header.slotStride)
+    {
+        throw std::runtime_error(name + " is not an LLVC shared segment");
+    }
+    return segment;
+}
+
+ShmSlot&
+ShmSegment::slot(uint32_t index) const
+{
+    const ShmHeader& h = header();
+    char* p = static_cast<char*>(base) + h.slotOffset + index * h.slotStride;
+    return *reinterpret_cast<ShmSlot*>(p);
+}
+
+float*
+ShmSegment::inputBlock(uint32_t index, uint64_t position) const
+{
+    const ShmHeader& h = header();
+    char* p = reinterpret_cast<char*>(&slot(index)) +
+              alignUp(sizeof(ShmSlot), 64);
+    return reinterpret_cast<float*>(p) +
+           (position % h.ringBlocks) * h.blockSize;
+}
+
+float*
+ShmSegment::outputBlock(uint32_t index, uint64_t position) const
+{
+    const ShmHeader& h = header();
+    char* p = reinterpret_cast<char*>(&slot(index)) +
+              alignUp(sizeof(ShmSlot), 64) + ringBytes(h);
+    return reinterpret_cast<float*>(p) +
+           (position % h.ringBlocks) * h.blockSize;
+}
+
+ShmStreamClient::ShmStreamClient(const std::string& name)
+  : segment(ShmSegment::attach(name))
+  , index(0)
+  , slot(nullptr)
+{
+    const ShmHeader& header = segment.header();
+    for (uint32_t i = 0; i < header.maxStreams; ++i)
+    {
+        uint32_t expected = SLOT_FREE;
+        if (segment.slot(i).state.compare_exchange_strong(expected,
+                                                          SLOT_ATTACHED))
+        {
+            index = i;
+            slot  = &segment.slot(i);
+            slot->owner.store(getpid(), std::memory_order_release);
+            ringDoorbell(segment.header().workerBells[slot->worker]);
+            return;
+        }
+    }
+    throw std::runtime_error("no free stream slot in " + name);
+}
+
+ShmStreamClient::~ShmStreamClient()
+{
+    slot->state.store(SLOT_DETACHING, std::memory_order_release);
+    ringDoorbell(segment.header().workerBells[slot->worker]);
+}
+
+float*
+ShmStreamClient::acquireInput()
+{
+    uint64_t tail = slot->input.tail.load(std::memory_order_relaxed);
+    uint64_t head = slot->input.head.load(std::memory_order_acquire);
+    if (tail - head == segment.header().ringBlocks)
+    {
+        return nullptr; // Ring is full
+    }
+    return segment.inputBlock(index, tail);
+}
+
+void
+ShmStreamClient::submitInput()
+{
+    uint64_t tail = slot->input.tail.load(std::memory_order_relaxed);
+    slot->input.tail.store(tail + 1, std::memory_order_release);
+    ringDoorbell(segment.header().workerBells[slot->worker]);
+}
+
+const float*
+ShmStreamClient::tryOutput()
+{
+    uint64_t head = slot->output.head.load(std::memory_order_relaxed);
+    if (slot->output.tail.load(std::memory_order_acquire) == head)
+    {
+        return nullptr;
+    }
+    return segment.outputBlock(index, head);
+}
+
+const float*
+ShmStreamClient::waitOutput(int timeoutMs)
+{
+    auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        uint32_t seen = slot->clientBell.sequence.load();
+        if (const float* block = tryOutput())
+        {
+            return block;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+            return nullptr;
+        }
+        waitDoorbell(
+          slot->clientBell, seen, static_cast<int>(remaining.count()));
+    }
+}
+
+void
+ShmStreamClient::releaseOutput()
+{
+    uint64_t head = slot->output.head.load(std::memory_order_relaxed);
+    slot->output.head.store(head + 1, std::memory_order_release);
+    // The daemon may be waiting for room in the output ring
+    ringDoorbell(segment.header().workerBells[slot->worker]);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shared-memory transport for processes on the same host. A POSIX shm
+// segment holds one slot per stream; each slot has an input ring (client ->
+// daemon) and an output ring (daemon -> client) of fixed-size blocks, so
+// both sides read and write samples in place without copying through the
+// kernel. Futex words in the segment act as doorbells and are only rung
+// when the other side has announced that it is going to sleep. A slot
+// records the PID of the client holding it, so the daemon can take back the
+// slot of a client that died without detaching.
+//
+// Linux only (shm_open + futex).
+
+const uint32_t SHM_MAGIC       = 0x4c4c5643; // "LLVC"
+const uint32_t SHM_VERSION     = 2;
+const uint32_t SHM_MAX_WORKERS = 64;
+
+enum ShmSlotState : uint32_t
+{
+    SLOT_FREE      = 0,
+    SLOT_ATTACHED  = 1,
+    SLOT_DETACHING = 2 // client left; daemon resets the slot to FREE
+};
+
+struct alignas(64) ShmDoorbell
+{
+    std::atomic<uint32_t> sequence; // futex word, bumped on every ring
+    std::atomic<uint32_t> sleeping; // waiter is (about to be) in futex_wait
+};
+
+// Single-producer / single-consumer ring of whole blocks; the sample
+// storage for each ring follows the slot header in the segment.
+struct ShmRing
+{
+    alignas(64) std::atomic<uint64_t> head; // next block to consume
+    alignas(64) std::atomic<uint64_t> tail; // next block to produce
+};
+
+struct ShmSlot
+{
+    alignas(64) std::atomic<uint32_t> state;
+    uint32_t worker;            // daemon worker whose doorbell serves this slot
+    std::atomic<int32_t> owner; // client PID once attached, else 0
+    ShmDoorbell clientBell;
+    ShmRing input;
+    ShmRing output;
+};
+
+struct ShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t maxStreams;
+    uint32_t blockSize;  // samples per block
+    uint32_t ringBlocks; // blocks per ring
+    uint32_t workers;
+    uint64_t slotOffset; // byte offset of slot 0
+    uint64_t slotStride; // bytes per slot including both rings
+    ShmDoorbell workerBells[SHM_MAX_WORKERS];
+};
+
+// Rings a doorbell; only enters the kernel when the waiter is asleep
+void
+ringDoorbell(ShmDoorbell& bell);
+
+// Sleeps until the doorbell moves past `seen` or the timeout expires
+void
+waitDoorbell(ShmDoorbell& bell, uint32_t seen, int timeoutMs);
+
+// A mapping of the shared segment. The daemon creates it, clients attach.
+class ShmSegment
+{
+  public:
+    static ShmSegment create(const std::string& name,
+                             uint32_t maxStreams,
+                             uint32_t blockSize,
+                             uint32_t ringBlocks,
+                             uint32_t workers);
+    static ShmSegment attach(const std::string& name);
+
+    ShmSegment(ShmSegment&& other) noexcept;
+    ShmSegment& operator=(ShmSegment&& other) = delete;
+    ShmSegment(const ShmSegment&)            = delete;
+    ~ShmSegment();
+
+    ShmHeader& header() const { return *static_cast<ShmHeader*>(base); }
+    ShmSlot& slot(uint32_t index) const;
+    float* inputBlock(uint32_t index, uint64_t position) const;
+    float* outputBlock(uint32_t index, uint64_t position) const;
+
+  private:
+    ShmSegment(void* base, size_t size, const std::string& name, bool owner);
+
+    void* base;
+    size_t size;
+    std::string name;
+    bool owner; // unlinks the segment on destruction
+};
+
+// Client side of one stream. Attaching claims a free slot; blocks are
+// written straight into the input ring and read straight from the output
+// ring:
+//
+//   float* in = client.acquireInput();   // fill blockSize() samples
+//   client.submitInput();
+//   const float* out = client.waitOutput(100);
+//   ...                                  // consume blockSize() samples
+//   client.releaseOutput();
+class ShmStreamClient
+{
+  public:
+    explicit ShmStreamClient(const std::string& name);
+    ~ShmStreamClient();
+
+    size_t blockSize() const { return segment.header().blockSize; }
+
+    // Next free input block, or nullptr if the input ring is full
+    float* acquireInput();
+    void submitInput();
+
+    // Next converted block, or nullptr if none is ready (in time)
+    const float* tryOutput();
+    const float* waitOutput(int timeoutMs);
+    void releaseOutput();
+
+  private:
+    ShmSegment segment;
+    uint32_t index;
+    ShmSlot* slot;
+};
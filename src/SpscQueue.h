@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free single-producer / single-consumer queue. Capacity is
+// rounded up to a power of two; push fails when full so the producer can
+// apply backpressure instead of growing memory.
+template <typename T>
+class SpscQueue
+{
+  public:
+    explicit SpscQueue(size_t minCapacity)
+      : head(0)
+      , tail(0)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+        {
+            capacity <<= 1;
+        }
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    bool tryPush(T&& item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size())
+        {
+            return false; // Queue is full
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h)
+        {
+            return false; // Queue is empty
+        }
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only exact when called from the producer or consumer thread
+    size_t sizeApprox() const
+    {
+        return tail.load(std::memory_order_acquire) -
+               head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+  private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
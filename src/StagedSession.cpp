@@ -0,0 +1,395 @@
+#include "StagedSession.h"
+#include "OnnxGraph.h"
+#include "llvc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const int SPIN_ATTEMPTS = 64; // yields before a waiting stage sleeps
+const auto IDLE_SLEEP   = std::chrono::microseconds(50);
+
+void
+backOff(int& attempt)
+{
+    if (attempt++ < SPIN_ATTEMPTS)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+}
+
+void
+pinToCore(int core)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0)
+    {
+        std::cerr << "Could not pin stage to CPU " << core << ": "
+                  << std::strerror(rc) << std::endl;
+    }
+#else
+    (void)core;
+#endif
+}
+
+int
+stageReading(const std::vector<OnnxStage>& split, const std::string& name)
+{
+    int reader = -1;
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        const std::vector<std::string>& inputs = split[k].inputs;
+        if (std::find(inputs.begin(), inputs.end(), name) == inputs.end())
+        {
+            continue;
+        }
+        if (reader >= 0)
+        {
+            throw std::runtime_error("state " + name + " is read by stages " +
+                                     std::to_string(reader) + " and " +
+                                     std::to_string(k) + "; move the cut");
+        }
+        reader = static_cast<int>(k);
+    }
+    return reader;
+}
+
+int
+stageWriting(const std::vector<OnnxStage>& split, const std::string& name)
+{
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        const std::vector<std::string>& outputs = split[k].outputs;
+        if (std::find(outputs.begin(), outputs.end(), name) != outputs.end())
+        {
+            return static_cast<int>(k);
+        }
+    }
+    return -1;
+}
+} // namespace
+
+StagedSession::StagedSession(Ort::Env& env,
+                             const std::string& modelPath,
+                             const std::vector<std::string>& cuts,
+                             const Ort::SessionOptions& options,
+                             const std::vector<int>& cores,
+                             size_t depth)
+{
+    std::vector<OnnxStage> split = splitOnnxModel(modelPath, cuts);
+    if (!cores.empty() && cores.size() != split.size())
+    {
+        throw std::runtime_error(std::to_string(split.size()) +
+                                 " stages need as many cores, got " +
+                                 std::to_string(cores.size()));
+    }
+
+    // Packet slots: the audio block plus every value a stage hands on
+    std::map<std::string, int> slotOf;
+    slotOf[INPUT_NAMES[0]] = 0;
+    for (const OnnxStage& stage : split)
+    {
+        for (const std::string& output : stage.outputs)
+        {
+            slotOf.emplace(output, static_cast<int>(slotOf.size()));
+        }
+    }
+    slotCount   = slotOf.size();
+    audioInSlot = 0;
+    if (!slotOf.count(OUTPUT_NAMES[0]))
+    {
+        throw std::runtime_error("model has no output " +
+                                 std::string(OUTPUT_NAMES[0]));
+    }
+    audioOutSlot = slotOf[OUTPUT_NAMES[0]];
+
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        auto stage  = std::make_unique<Stage>();
+        stage->core = cores.empty() ? -1 : cores[k];
+        stages.push_back(std::move(stage));
+    }
+
+    // Zeroed states, each held by the one stage that reads it
+    StreamState initial         = createStreamState();
+    Ort::Value* initialValues[] = { initial.enc_buf_tensor.get(),
+                                    initial.dec_buf_tensor.get(),
+                                    initial.out_buf_tensor.get(),
+                                    initial.convnet_pre_ctx_tensor.get() };
+    std::map<std::string, int> stateOf;
+    states.resize(4);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        states[i].value = std::move(*initialValues[i]);
+        int reader      = stageReading(split, INPUT_NAMES[i + 1]);
+        if (reader < 0)
+        {
+            continue;
+        }
+        int writer = stageWriting(split, OUTPUT_NAMES[i + 1]);
+        if (writer < 0 || writer > reader)
+        {
+            throw std::runtime_error(
+              std::string("state ") + INPUT_NAMES[i + 1] +
+              " would be updated after the stage reading it; move the cut");
+        }
+        states[i].nextSlot = slotOf[OUTPUT_NAMES[i + 1]];
+        stages[reader]->states.push_back(i);
+        stateOf[INPUT_NAMES[i + 1]] = static_cast<int>(i);
+    }
+
+    std::vector<int> lastReader(slotCount, -1);
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        Stage& stage      = *stages[k];
+        stage.inputNames  = split[k].inputs;
+        stage.outputNames = split[k].outputs;
+        for (const std::string& name : stage.inputNames)
+        {
+            auto state = stateOf.find(name);
+            auto slot  = slotOf.find(name);
+            if (state != stateOf.end())
+            {
+                stage.inputSlot.push_back(-1);
+                stage.inputState.push_back(state->second);
+            }
+            else if (slot != slotOf.end())
+            {
+                stage.inputSlot.push_back(slot->second);
+                stage.inputState.push_back(-1);
+                lastReader[slot->second] = static_cast<int>(k);
+            }
+            else
+            {
+                throw std::runtime_error("stage " + std::to_string(k) +
+                                         " reads unknown input " + name);
+            }
+            stage.inputs.push_back(name.c_str());
+            stage.feeds.emplace_back(nullptr);
+        }
+        for (const std::string& name : stage.outputNames)
+        {
+            stage.outputSlot.push_back(slotOf[name]);
+            stage.outputs.push_back(name.c_str());
+        }
+    }
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        for (size_t state : stages[k]->states)
+        {
+            // The holding stage moves the update out of the packet
+            if (lastReader[states[state].nextSlot] > static_cast<int>(k))
+            {
+                throw std::runtime_error(
+                  std::string(OUTPUT_NAMES[state + 1]) +
+                  " is read after its stage; move the cut");
+            }
+        }
+    }
+    for (size_t slot = 0; slot < slotCount; ++slot)
+    {
+        if (lastReader[slot] >= 0 && static_cast<int>(slot) != audioOutSlot)
+        {
+            stages[lastReader[slot]]->releaseSlots.push_back(slot);
+        }
+    }
+
+    for (size_t k = 0; k < split.size(); ++k)
+    {
+        stages[k]->session = std::make_unique<Ort::Session>(
+          env, split[k].model.data(), split[k].model.size(), options);
+        stages[k]->queue = std::make_unique<SpscQueue<Packet>>(depth);
+    }
+    finished = std::make_unique<SpscQueue<Packet>>(depth);
+
+    for (size_t k = 0; k < stages.size(); ++k)
+    {
+        stages[k]->thread = std::thread([this, k] { run(k); });
+    }
+}
+
+StagedSession::~StagedSession()
+{
+    stopping.store(true);
+    for (auto& stage : stages)
+    {
+        if (stage->thread.joinable())
+        {
+            stage->thread.join();
+        }
+    }
+}
+
+bool
+StagedSession::trySubmit(const float* samples, size_t count)
+{
+    rethrowFailure();
+    Packet packet;
+    packet.slots.reserve(slotCount);
+    for (size_t s = 0; s < slotCount; ++s)
+    {
+        packet.slots.emplace_back(nullptr);
+    }
+    Ort::AllocatorWithDefaultOptions allocator;
+    const int64_t shape[] = { 1, 1, static_cast<int64_t>(count) };
+    Ort::Value audio = Ort::Value::CreateTensor<float>(allocator, shape, 3);
+    std::copy(samples, samples + count, audio.GetTensorMutableData<float>());
+    packet.slots[audioInSlot] = std::move(audio);
+    return stages[0]->queue->tryPush(std::move(packet));
+}
+
+bool
+StagedSession::tryReceive(float* samples, size_t count)
+{
+    rethrowFailure();
+    Packet packet;
+    if (!finished->tryPop(packet))
+    {
+        return false;
+    }
+    const Ort::Value& audio = packet.slots[audioOutSlot];
+    const float* data       = audio.GetTensorData<float>();
+    size_t size = audio.GetTensorTypeAndShapeInfo().GetElementCount();
+    std::copy(data, data + std::min(size, count), samples);
+    return true;
+}
+
+const std::vector<std::string>&
+StagedSession::stageOutputs(size_t stage) const
+{
+    return stages.at(stage)->outputNames;
+}
+
+StageTiming
+StagedSession::timing(size_t stage) const
+{
+    StageTiming result;
+    result.blocks      = stages.at(stage)->blocks.load();
+    result.busySeconds = stages.at(stage)->busyNanos.load() / 1e9;
+    return result;
+}
+
+void
+StagedSession::run(size_t index)
+{
+    Stage& stage = *stages[index];
+    SpscQueue<Packet>& next =
+      index + 1 < stages.size() ? *stages[index + 1]->queue : *finished;
+    if (stage.core >= 0)
+    {
+        pinToCore(stage.core);
+    }
+
+    Packet packet;
+    int attempt = 0;
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        if (!stage.queue->tryPop(packet))
+        {
+            backOff(attempt);
+            continue;
+        }
+        try
+        {
+            runBlock(stage, packet);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(failureMutex);
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+            failed.store(true, std::memory_order_release);
+            return;
+        }
+        for (attempt = 0; !next.tryPush(std::move(packet));)
+        {
+            if (stopping.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            backOff(attempt);
+        }
+        attempt = 0;
+    }
+}
+
+void
+StagedSession::runBlock(Stage& stage, Packet& packet)
+{
+    auto start = Clock::now();
+    for (size_t i = 0; i < stage.feeds.size(); ++i)
+    {
+        stage.feeds[i] = stage.inputState[i] >= 0
+                           ? std::move(states[stage.inputState[i]].value)
+                           : std::move(packet.slots[stage.inputSlot[i]]);
+    }
+    std::vector<Ort::Value> results =
+      stage.session->Run(Ort::RunOptions{ nullptr },
+                         stage.inputs.data(),
+                         stage.feeds.data(),
+                         stage.feeds.size(),
+                         stage.outputs.data(),
+                         stage.outputs.size());
+
+    // Run only reads its feeds; hand them back before anything is released
+    for (size_t i = 0; i < stage.feeds.size(); ++i)
+    {
+        if (stage.inputState[i] >= 0)
+        {
+            states[stage.inputState[i]].value = std::move(stage.feeds[i]);
+        }
+        else
+        {
+            packet.slots[stage.inputSlot[i]] = std::move(stage.feeds[i]);
+        }
+    }
+    for (size_t o = 0; o < results.size(); ++o)
+    {
+        packet.slots[stage.outputSlot[o]] = std::move(results[o]);
+    }
+    for (size_t state : stage.states)
+    {
+        states[state].value = std::move(packet.slots[states[state].nextSlot]);
+    }
+    for (int slot : stage.releaseSlots)
+    {
+        packet.slots[slot] = Ort::Value(nullptr);
+    }
+
+    stage.blocks.fetch_add(1, std::memory_order_relaxed);
+    stage.busyNanos.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+        .count(),
+      std::memory_order_relaxed);
+}
+
+void
+StagedSession::rethrowFailure()
+{
+    if (failed.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        std::rethrow_exception(failure);
+    }
+}
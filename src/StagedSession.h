@@ -0,0 +1,108 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include <onnxruntime_cxx_api.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the streaming model as a pipeline of stage sessions, one thread per
+// stage, so consecutive blocks overlap: while stage 1 works on block n,
+// stage 0 already runs block n + 1. The graph is split at cut tensors with
+// splitOnnxModel (e.g. after the encoder and after the decoder), each stage
+// is its own single-threaded session, optionally pinned to a core, and the
+// tensors crossing a cut are handed on through SpscQueues.
+//
+// Every recurrent state must be read and updated inside one stage, which
+// holds it between blocks; the split already places state updates that
+// way, and a cut that would carry a state backwards is rejected.
+
+struct StageTiming
+{
+    size_t blocks      = 0;
+    double busySeconds = 0.0; // inside session.Run
+};
+
+class StagedSession
+{
+  public:
+    // `cores` is empty (no pinning) or names one CPU per stage; `depth` is
+    // the number of blocks each queue holds. Throws std::runtime_error for
+    // invalid cuts and Ort::Exception if a stage does not load.
+    StagedSession(Ort::Env& env,
+                  const std::string& modelPath,
+                  const std::vector<std::string>& cuts,
+                  const Ort::SessionOptions& options,
+                  const std::vector<int>& cores,
+                  size_t depth);
+    ~StagedSession();
+
+    StagedSession(const StagedSession&) = delete;
+    StagedSession& operator=(const StagedSession&) = delete;
+
+    // Queues one block; false when the first stage's queue is full
+    bool trySubmit(const float* samples, size_t count);
+
+    // Takes the oldest finished block (blocks leave in submission order);
+    // false when none is ready. `samples` holds the submitted count.
+    bool tryReceive(float* samples, size_t count);
+
+    // Both rethrow the first error raised on a stage thread
+
+    size_t stageCount() const { return stages.size(); }
+    const std::vector<std::string>& stageOutputs(size_t stage) const;
+    StageTiming timing(size_t stage) const;
+
+    struct Packet
+    {
+        std::vector<Ort::Value> slots; // one per value crossing a cut
+    };
+
+  private:
+    struct Stage
+    {
+        std::unique_ptr<Ort::Session> session;
+        std::vector<std::string> inputNames;
+        std::vector<std::string> outputNames;
+        std::vector<const char*> inputs;
+        std::vector<const char*> outputs;
+        std::vector<int> inputSlot;  // -1 for a state this stage holds
+        std::vector<int> inputState; // index into `states`, or -1
+        std::vector<int> outputSlot;
+        std::vector<int> releaseSlots; // read for the last time here
+        std::vector<Ort::Value> feeds;
+        std::vector<size_t> states; // states updated after each run
+        std::unique_ptr<SpscQueue<Packet>> queue; // blocks waiting
+        std::thread thread;
+        int core = -1;
+        std::atomic<size_t> blocks{ 0 };
+        std::atomic<uint64_t> busyNanos{ 0 };
+    };
+
+    struct State
+    {
+        Ort::Value value{ nullptr };
+        int nextSlot = -1; // slot of the updated state after a run
+    };
+
+    void run(size_t index);
+    void runBlock(Stage& stage, Packet& packet);
+    void rethrowFailure();
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::vector<State> states;
+    std::unique_ptr<SpscQueue<Packet>> finished;
+    size_t slotCount  = 0;
+    int audioInSlot   = -1;
+    int audioOutSlot  = -1;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> failed{ false };
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+};
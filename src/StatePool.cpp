@@ -0,0 +1,266 @@
+#include "StatePool.h"
+#include "Numa.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+
+namespace
+{
+const size_t TENSOR_ALIGN   = 64;
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+size_t
+alignUp(size_t bytes, size_t alignment)
+{
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+template <size_t N>
+size_t
+elementCount(const std::array<int64_t, N>& shape)
+{
+    size_t count = 1;
+    for (int64_t dim : shape)
+    {
+        count *= static_cast<size_t>(dim);
+    }
+    return count;
+}
+
+// Byte offset of each state tensor within a bank
+struct BankLayout
+{
+    size_t offsets[4];
+    size_t counts[4];
+    size_t bytes;
+};
+
+BankLayout
+bankLayout()
+{
+    BankLayout layout;
+    layout.counts[0] = elementCount(ENC_BUF_SHAPE);
+    layout.counts[1] = elementCount(DEC_BUF_SHAPE);
+    layout.counts[2] = elementCount(OUT_BUF_SHAPE);
+    layout.counts[3] = elementCount(CONVNET_PRE_CTX_SHAPE);
+    size_t offset    = 0;
+    for (size_t t = 0; t < 4; ++t)
+    {
+        layout.offsets[t] = offset;
+        offset += alignUp(layout.counts[t] * sizeof(float), TENSOR_ALIGN);
+    }
+    layout.bytes = offset;
+    return layout;
+}
+
+template <size_t N>
+Ort::Value
+wrap(const Ort::MemoryInfo& memoryInfo,
+     char* bank,
+     const BankLayout& layout,
+     size_t t,
+     const std::array<int64_t, N>& shape)
+{
+    return Ort::Value::CreateTensor<float>(
+      memoryInfo,
+      reinterpret_cast<float*>(bank + layout.offsets[t]),
+      layout.counts[t],
+      shape.data(),
+      shape.size());
+}
+
+std::vector<Ort::Value>
+wrapBank(const Ort::MemoryInfo& memoryInfo,
+         char* bank,
+         const BankLayout& layout)
+{
+    std::vector<Ort::Value> values;
+    values.reserve(5);
+    values.emplace_back(nullptr);
+    values.push_back(wrap(memoryInfo, bank, layout, 0, ENC_BUF_SHAPE));
+    values.push_back(wrap(memoryInfo, bank, layout, 1, DEC_BUF_SHAPE));
+    values.push_back(wrap(memoryInfo, bank, layout, 2, OUT_BUF_SHAPE));
+    values.push_back(wrap(memoryInfo, bank, layout, 3, CONVNET_PRE_CTX_SHAPE));
+    return values;
+}
+} // namespace
+
+StatePool::StatePool(size_t capacity,
+                     bool hugePages,
+                     bool prefault,
+                     int numaNode)
+  : memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+{
+    if (capacity == 0)
+    {
+        throw std::runtime_error("state pool needs at least one slot");
+    }
+    const BankLayout layout = bankLayout();
+    slotBytes               = 2 * layout.bytes;
+
+    // A node-bound slab is populated only after binding
+    bool populate = prefault && numaNode < 0;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (populate ? MAP_POPULATE : 0);
+    if (hugePages)
+    {
+        mappedBytes = alignUp(capacity * slotBytes, HUGE_PAGE_SIZE);
+        slab        = mmap(nullptr,
+                           mappedBytes,
+                           PROT_READ | PROT_WRITE,
+                           flags | MAP_HUGETLB,
+                           -1,
+                           0);
+        hugeTlb = slab != MAP_FAILED;
+    }
+    if (!hugeTlb)
+    {
+        mappedBytes = capacity * slotBytes;
+        slab = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (slab == MAP_FAILED)
+        {
+            throw std::runtime_error("failed to map state pool of " +
+                                     std::to_string(mappedBytes) + " bytes");
+        }
+#ifdef MADV_HUGEPAGE
+        if (hugePages)
+        {
+            madvise(slab, mappedBytes, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    if (numaNode >= 0)
+    {
+        bindMemory(slab, mappedBytes, numaNode);
+        if (prefault)
+        {
+            volatile char* bytes = static_cast<char*>(slab);
+            for (size_t offset = 0; offset < mappedBytes; offset += 4096)
+            {
+                bytes[offset] = 0;
+            }
+        }
+    }
+
+    // Anonymous mappings start zeroed, so fresh slots need no reset
+    slots.reserve(capacity);
+    freeSlots.reserve(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        char* base = static_cast<char*>(slab) + i * slotBytes;
+        PooledState state;
+        state.banks[0]   = reinterpret_cast<float*>(base);
+        state.banks[1]   = reinterpret_cast<float*>(base + layout.bytes);
+        state.bankBytes  = layout.bytes;
+        state.index      = static_cast<uint32_t>(i);
+        state.memoryInfo = &memoryInfo;
+        for (int b = 0; b < 2; ++b)
+        {
+            char* bank       = base + b * layout.bytes;
+            state.inputs[b]  = wrapBank(memoryInfo, bank, layout);
+            state.outputs[b] = wrapBank(memoryInfo, bank, layout);
+        }
+        slots.push_back(std::move(state));
+        freeSlots.push_back(static_cast<uint32_t>(capacity - 1 - i));
+    }
+}
+
+StatePool::~StatePool()
+{
+    // Drop the wrappers before the memory they point into
+    slots.clear();
+    munmap(slab, mappedBytes);
+}
+
+PooledState*
+StatePool::acquire()
+{
+    std::lock_guard<std::mutex> lock(freeMutex);
+    if (freeSlots.empty())
+    {
+        return nullptr;
+    }
+    PooledState* state = &slots[freeSlots.back()];
+    freeSlots.pop_back();
+    peak = std::max(peak, slots.size() - freeSlots.size());
+    return state;
+}
+
+void
+StatePool::release(PooledState* state)
+{
+    reset(*state);
+    std::lock_guard<std::mutex> lock(freeMutex);
+    freeSlots.push_back(state->index);
+}
+
+void
+StatePool::reset(PooledState& state)
+{
+    state.current = 0;
+    state.dirty   = true;
+}
+
+size_t
+StatePool::inUse() const
+{
+    std::lock_guard<std::mutex> lock(freeMutex);
+    return slots.size() - freeSlots.size();
+}
+
+size_t
+StatePool::peakInUse() const
+{
+    std::lock_guard<std::mutex> lock(freeMutex);
+    return peak;
+}
+
+void
+processBlock(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t samples,
+             PooledState& state)
+{
+    if (state.dirty)
+    {
+        // Only the bank being read needs zeros; the other is overwritten
+        std::memset(state.banks[state.current], 0, state.bankBytes);
+        state.dirty = false;
+    }
+    if (samples != state.audioSamples)
+    {
+        state.audioOut     = Ort::Value(nullptr);
+        state.audioSamples = samples;
+    }
+
+    const int64_t input_shape[] = { 1, 1, static_cast<int64_t>(samples) };
+    std::vector<Ort::Value>& inputs  = state.inputs[state.current];
+    std::vector<Ort::Value>& outputs = state.outputs[state.current ^ 1];
+    inputs[0]  = Ort::Value::CreateTensor<float>(*state.memoryInfo,
+                                                const_cast<float*>(input),
+                                                samples,
+                                                input_shape,
+                                                3);
+    outputs[0] = std::move(state.audioOut);
+
+    session.Run(Ort::RunOptions{ nullptr },
+                INPUT_NAMES,
+                inputs.data(),
+                5,
+                OUTPUT_NAMES,
+                outputs.data(),
+                5);
+
+    // The audio output lives in its own ORT tensor so `input` and `output`
+    // may alias; keep it for the next call of the same size
+    state.audioOut           = std::move(outputs[0]);
+    const float* output_data = state.audioOut.GetTensorData<float>();
+    size_t output_size =
+      state.audioOut.GetTensorTypeAndShapeInfo().GetElementCount();
+    std::copy(
+      output_data, output_data + std::min(output_size, samples), output);
+    state.current ^= 1;
+}
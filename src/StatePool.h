@@ -0,0 +1,82 @@
+#pragma once
+
+#include "llvc.h"
+#include <onnxruntime_cxx_api.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Fixed-capacity pool of stream states carved out of one slab, so streams
+// connecting and disconnecting never touch the heap. Every slot holds two
+// banks of the four state tensors (each tensor 64-byte aligned): a block
+// reads one bank and ORT writes the new state straight into the other, so
+// Run needs no output allocations and no state is copied.
+
+struct PooledState
+{
+    float* banks[2];
+    size_t bankBytes;
+    int current = 0;     // bank holding the latest state
+    bool dirty  = false; // zero `current` before the next block
+    uint32_t index;
+    // Tensor wrappers over each bank, in model input / output order. Slot 0
+    // is the audio, bound per call.
+    std::vector<Ort::Value> inputs[2];
+    std::vector<Ort::Value> outputs[2];
+    Ort::Value audioOut{ nullptr }; // ORT-allocated, reused across calls
+    size_t audioSamples = 0;
+    const Ort::MemoryInfo* memoryInfo;
+};
+
+class StatePool
+{
+  public:
+    // hugePages tries MAP_HUGETLB, then falls back to transparent huge
+    // pages; prefault populates the slab up front instead of on first use.
+    // numaNode >= 0 places the slab on that node (see Numa.h).
+    StatePool(size_t capacity,
+              bool hugePages = false,
+              bool prefault  = false,
+              int numaNode   = -1);
+    ~StatePool();
+
+    StatePool(const StatePool&) = delete;
+    StatePool& operator=(const StatePool&) = delete;
+
+    // O(1); returns nullptr when every slot is taken. The state reads as
+    // zeros on its first block.
+    PooledState* acquire();
+    void release(PooledState* state);
+
+    // Zeroes the state lazily, e.g. when a stream restarts
+    static void reset(PooledState& state);
+
+    size_t capacity() const { return slots.size(); }
+    size_t inUse() const;
+    size_t peakInUse() const;
+    size_t bytesPerStream() const { return slotBytes; }
+    size_t slabBytes() const { return mappedBytes; }
+    bool hugePages() const { return hugeTlb; }
+
+  private:
+    Ort::MemoryInfo memoryInfo;
+    void* slab         = nullptr;
+    size_t mappedBytes = 0;
+    size_t slotBytes   = 0;
+    bool hugeTlb       = false;
+    std::vector<PooledState> slots;
+
+    mutable std::mutex freeMutex;
+    std::vector<uint32_t> freeSlots;
+    size_t peak = 0;
+};
+
+// Runs one block on a pooled state and flips its banks. `input` and
+// `output` may alias.
+void
+processBlock(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t samples,
+             PooledState& state);
@@ -0,0 +1,437 @@
+#include "StateSnapshot.h"
+#include <cstring>
+#include <stdexcept>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+const char SNAPSHOT_MAGIC[4]     = { 'L', 'V', 'S', 'T' };
+const uint16_t SNAPSHOT_VERSION  = 1;
+const uint8_t SNAPSHOT_TENSORS   = 4;
+const size_t SNAPSHOT_HEADER     = 8;
+const size_t TENSOR_HEADER       = 8;
+
+size_t
+padded(size_t bytes)
+{
+    return (bytes + 7) & ~size_t(7);
+}
+
+uint16_t
+floatToHalfScalar(float value)
+{
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint32_t sign     = (x >> 16) & 0x8000;
+    uint32_t mantissa = x & 0x7fffff;
+    int32_t exponent  = static_cast<int32_t>((x >> 23) & 0xff);
+
+    if (exponent == 0xff) // inf / nan
+    {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    exponent = exponent - 127 + 15;
+    if (exponent >= 0x1f) // overflow to inf
+    {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    uint32_t half;
+    uint32_t remainder;
+    uint32_t midpoint;
+    if (exponent <= 0) // subnormal or zero
+    {
+        if (exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        half           = mantissa >> shift;
+        remainder      = mantissa & ((1u << shift) - 1);
+        midpoint       = 1u << (shift - 1);
+    }
+    else
+    {
+        half      = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        remainder = mantissa & 0x1fff;
+        midpoint  = 0x1000;
+    }
+    // Round to nearest even; a carry correctly bumps the exponent
+    if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+    {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+float
+halfToFloatScalar(uint16_t value)
+{
+    uint32_t sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t x;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            x = sign;
+        }
+        else // subnormal: renormalize
+        {
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    }
+    else if (exponent == 0x1f)
+    {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &x, sizeof(result));
+    return result;
+}
+
+Ort::Value*
+stateTensor(const StreamState& state, size_t index)
+{
+    switch (index)
+    {
+        case 0:
+            return state.enc_buf_tensor.get();
+        case 1:
+            return state.dec_buf_tensor.get();
+        case 2:
+            return state.out_buf_tensor.get();
+        default:
+            return state.convnet_pre_ctx_tensor.get();
+    }
+}
+
+// The bank a pooled state's next block reads; slot 0 of the wrappers is
+// the audio
+Ort::Value*
+pooledTensor(const PooledState& state, size_t index)
+{
+    return const_cast<Ort::Value*>(&state.inputs[state.current][index + 1]);
+}
+
+class BlobReader
+{
+  public:
+    BlobReader(const uint8_t* data, size_t size)
+      : data(data)
+      , left(size)
+    {
+    }
+
+    const uint8_t* take(size_t bytes)
+    {
+        if (bytes > left)
+        {
+            throw std::runtime_error("state snapshot is truncated");
+        }
+        const uint8_t* p = data;
+        data += bytes;
+        left -= bytes;
+        return p;
+    }
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    size_t remaining() const { return left; }
+
+  private:
+    const uint8_t* data;
+    size_t left;
+};
+
+// Parses the blob header and calls fn(index, shape, payload) per tensor
+template <typename Fn>
+void
+parseSnapshot(const uint8_t* data, size_t size, Fn&& fn)
+{
+    BlobReader reader(data, size);
+    if (std::memcmp(reader.take(4), SNAPSHOT_MAGIC, 4) != 0)
+    {
+        throw std::runtime_error("not a state snapshot");
+    }
+    if (reader.read<uint16_t>() != SNAPSHOT_VERSION)
+    {
+        throw std::runtime_error("unsupported state snapshot version");
+    }
+    uint8_t precision = reader.read<uint8_t>();
+    if (precision > static_cast<uint8_t>(SnapshotPrecision::Float16))
+    {
+        throw std::runtime_error("unknown state snapshot precision");
+    }
+    if (reader.read<uint8_t>() != SNAPSHOT_TENSORS)
+    {
+        throw std::runtime_error("state snapshot has wrong tensor count");
+    }
+    const size_t elementBytes =
+      precision == static_cast<uint8_t>(SnapshotPrecision::Float16) ? 2 : 4;
+
+    for (size_t t = 0; t < SNAPSHOT_TENSORS; ++t)
+    {
+        uint8_t rank = reader.take(TENSOR_HEADER)[0];
+        std::vector<int64_t> shape(rank);
+        size_t count = 1;
+        for (auto& dim : shape)
+        {
+            dim = reader.read<int64_t>();
+            if (dim <= 0 || dim > (1 << 24))
+            {
+                throw std::runtime_error("state snapshot has a bad shape");
+            }
+            count *= static_cast<size_t>(dim);
+        }
+        const uint8_t* payload = reader.take(padded(count * elementBytes));
+        fn(t, shape, count, payload, elementBytes == 2);
+    }
+    if (reader.remaining() != 0)
+    {
+        throw std::runtime_error("state snapshot has trailing bytes");
+    }
+}
+} // namespace
+
+void
+floatToHalf(const float* in, uint16_t* out, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i),
+                                    _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        out[i] = floatToHalfScalar(in[i]);
+    }
+}
+
+void
+halfToFloat(const uint16_t* in, float* out, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i h =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        out[i] = halfToFloatScalar(in[i]);
+    }
+}
+
+namespace
+{
+// Serializes the tensors tensor(0..3), or zeros of their shapes when
+// `zeros` is set (a pooled state reset lazily)
+template <typename Tensor>
+void
+writeSnapshot(Tensor tensor,
+              bool zeros,
+              SnapshotPrecision precision,
+              std::vector<uint8_t>& blob)
+{
+    const size_t elementBytes =
+      precision == SnapshotPrecision::Float16 ? 2 : 4;
+
+    // Size the blob once, then fill it in place
+    size_t size = SNAPSHOT_HEADER;
+    for (size_t t = 0; t < SNAPSHOT_TENSORS; ++t)
+    {
+        const Ort::Value* value = tensor(t);
+        auto info               = value->GetTensorTypeAndShapeInfo();
+        size += TENSOR_HEADER + info.GetDimensionsCount() * sizeof(int64_t) +
+                padded(info.GetElementCount() * elementBytes);
+    }
+    blob.resize(size);
+
+    uint8_t* p = blob.data();
+    std::memcpy(p, SNAPSHOT_MAGIC, 4);
+    std::memcpy(p + 4, &SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION));
+    p[6] = static_cast<uint8_t>(precision);
+    p[7] = SNAPSHOT_TENSORS;
+    p += SNAPSHOT_HEADER;
+
+    for (size_t t = 0; t < SNAPSHOT_TENSORS; ++t)
+    {
+        const Ort::Value* value    = tensor(t);
+        auto info                  = value->GetTensorTypeAndShapeInfo();
+        std::vector<int64_t> shape = info.GetShape();
+        size_t count               = info.GetElementCount();
+
+        std::memset(p, 0, TENSOR_HEADER);
+        p[0] = static_cast<uint8_t>(shape.size());
+        p += TENSOR_HEADER;
+        std::memcpy(p, shape.data(), shape.size() * sizeof(int64_t));
+        p += shape.size() * sizeof(int64_t);
+
+        const float* data = value->GetTensorData<float>();
+        if (zeros)
+        {
+            std::memset(p, 0, count * elementBytes); // +0.0 in both
+        }
+        else if (precision == SnapshotPrecision::Float16)
+        {
+            if (reinterpret_cast<uintptr_t>(p) % alignof(uint16_t) == 0)
+            {
+                floatToHalf(data, reinterpret_cast<uint16_t*>(p), count);
+            }
+            else
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    uint16_t h = floatToHalfScalar(data[i]);
+                    std::memcpy(p + 2 * i, &h, sizeof(h));
+                }
+            }
+        }
+        else
+        {
+            std::memcpy(p, data, count * sizeof(float));
+        }
+        std::memset(p + count * elementBytes,
+                    0,
+                    padded(count * elementBytes) - count * elementBytes);
+        p += padded(count * elementBytes);
+    }
+}
+
+// Overwrites tensor(0..3) from the blob
+template <typename Tensor>
+void
+readSnapshot(const uint8_t* data, size_t size, Tensor tensor)
+{
+    // The whole blob is checked before any tensor is written, so a bad
+    // snapshot leaves the state as it was
+    parseSnapshot(data,
+                  size,
+                  [&](size_t t,
+                      const std::vector<int64_t>& shape,
+                      size_t,
+                      const uint8_t*,
+                      bool) {
+                      const Ort::Value* value = tensor(t);
+                      if (value->GetTensorTypeAndShapeInfo().GetShape() !=
+                          shape)
+                      {
+                          throw std::runtime_error(
+                            "state snapshot shape mismatch");
+                      }
+                  });
+
+    parseSnapshot(
+      data,
+      size,
+      [&](size_t t,
+          const std::vector<int64_t>&,
+          size_t count,
+          const uint8_t* payload,
+          bool half) {
+          Ort::Value* value = tensor(t);
+          float* out        = value->GetTensorMutableData<float>();
+          if (!half)
+          {
+              std::memcpy(out, payload, count * sizeof(float));
+          }
+          else if (reinterpret_cast<uintptr_t>(payload) % 2 == 0)
+          {
+              halfToFloat(
+                reinterpret_cast<const uint16_t*>(payload), out, count);
+          }
+          else
+          {
+              for (size_t i = 0; i < count; ++i)
+              {
+                  uint16_t h;
+                  std::memcpy(&h, payload + 2 * i, sizeof(h));
+                  out[i] = halfToFloatScalar(h);
+              }
+          }
+      });
+}
+} // namespace
+
+void
+snapshotState(const StreamState& state,
+              SnapshotPrecision precision,
+              std::vector<uint8_t>& blob)
+{
+    writeSnapshot([&](size_t t) { return stateTensor(state, t); },
+                  false,
+                  precision,
+                  blob);
+}
+
+void
+snapshotState(const PooledState& state,
+              SnapshotPrecision precision,
+              std::vector<uint8_t>& blob)
+{
+    writeSnapshot([&](size_t t) { return pooledTensor(state, t); },
+                  state.dirty,
+                  precision,
+                  blob);
+}
+
+std::vector<uint8_t>
+snapshotState(const StreamState& state, SnapshotPrecision precision)
+{
+    std::vector<uint8_t> blob;
+    snapshotState(state, precision, blob);
+    return blob;
+}
+
+void
+restoreState(const uint8_t* data, size_t size, StreamState& state)
+{
+    readSnapshot(
+      data, size, [&](size_t t) { return stateTensor(state, t); });
+}
+
+void
+restoreState(const uint8_t* data, size_t size, PooledState& state)
+{
+    readSnapshot(
+      data, size, [&](size_t t) { return pooledTensor(state, t); });
+    state.dirty = false; // the bank now holds the restored state
+}
+
+StreamState
+restoreState(const uint8_t* data, size_t size)
+{
+    StreamState state = createStreamState();
+    restoreState(data, size, state);
+    return state;
+}
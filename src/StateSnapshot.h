@@ -0,0 +1,63 @@
+#pragma once
+
+#include "StatePool.h"
+#include "llvc.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Snapshot / restore of a stream's recurrent state. A blob is
+// self-describing (shapes and precision are stored with the data), so it
+// can be restored into any worker or process running the same model, e.g.
+// to move a stream off an overloaded worker or to resume a dropped call
+// without re-warming the model.
+//
+// Blob layout (little-endian):
+//   "LVST" | u16 version | u8 precision | u8 tensor count
+//   per tensor: u8 rank, 7 pad bytes | i64 dims[rank] | f32 or f16 data,
+//               zero-padded to a multiple of 8 bytes
+
+enum class SnapshotPrecision : uint8_t
+{
+    Float32 = 0,
+    Float16 = 1 // half the size; ~1e-3 relative error on restore
+};
+
+// Serializes into `blob`, reusing its capacity
+void
+snapshotState(const StreamState& state,
+              SnapshotPrecision precision,
+              std::vector<uint8_t>& blob);
+
+std::vector<uint8_t>
+snapshotState(const StreamState& state,
+              SnapshotPrecision precision = SnapshotPrecision::Float32);
+
+// The same for a pooled state: its current bank, or zeros if it was reset
+// and has not run since
+void
+snapshotState(const PooledState& state,
+              SnapshotPrecision precision,
+              std::vector<uint8_t>& blob);
+
+// Overwrites the tensors of an existing state in place (no allocation).
+// Throws std::runtime_error if the blob is malformed or shapes differ, in
+// which case the state is left unchanged.
+void
+restoreState(const uint8_t* data, size_t size, StreamState& state);
+
+// Restores into the bank the pooled state's next block reads and clears a
+// pending reset
+void
+restoreState(const uint8_t* data, size_t size, PooledState& state);
+
+// Allocates a fresh state from the blob
+StreamState
+restoreState(const uint8_t* data, size_t size);
+
+// Bulk float <-> IEEE half conversion (F16C when compiled with -mf16c)
+void
+floatToHalf(const float* in, uint16_t* out, size_t count);
+
+void
+halfToFloat(const uint16_t* in, float* out, size_t count);
@@ -0,0 +1,270 @@
+#include "StreamAccounting.h"
+#include "llvc.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <time.h>
+
+namespace
+{
+// Audio seconds over which the recent CPU per audio second is averaged
+// (exponentially)
+const double LOAD_WINDOW_SECONDS = 5.0;
+
+double
+threadCpuSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+double
+wallSeconds()
+{
+    return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool
+heavier(const StreamUsage& a, const StreamUsage& b)
+{
+    return a.cpuSeconds > b.cpuSeconds;
+}
+
+// Label values may not contain raw quotes, backslashes or newlines
+std::string
+escapeLabel(const std::string& value)
+{
+    std::string escaped;
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+} // namespace
+
+class StreamAccounting::Account
+{
+  public:
+    StreamUsage usage;
+};
+
+RunTimer::RunTimer()
+  : cpuStart(threadCpuSeconds())
+  , wallStart(wallSeconds())
+{
+}
+
+RunCost
+RunTimer::elapsed() const
+{
+    RunCost cost;
+    cost.cpuSeconds  = threadCpuSeconds() - cpuStart;
+    cost.wallSeconds = wallSeconds() - wallStart;
+    return cost;
+}
+
+StreamAccounting::StreamAccounting(size_t keepClosed)
+  : keepClosed(keepClosed)
+{
+    total.open = false;
+}
+
+StreamAccounting::~StreamAccounting() = default;
+
+StreamAccounting::Account*
+StreamAccounting::open(uint64_t id, const std::string& label)
+{
+    auto account         = std::make_unique<Account>();
+    account->usage.id    = id;
+    account->usage.label = label;
+    Account* handle      = account.get();
+    std::lock_guard<std::mutex> lock(mutex);
+    accounts.emplace(handle, std::move(account));
+    return handle;
+}
+
+void
+StreamAccounting::setLabel(Account* account, const std::string& label)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    account->usage.label = label;
+}
+
+StreamUsage
+StreamAccounting::close(Account* account)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    StreamUsage final = account->usage;
+    final.open        = false;
+    accounts.erase(account);
+
+    if (keepClosed > 0)
+    {
+        closed.insert(
+          std::upper_bound(closed.begin(), closed.end(), final, heavier),
+          final);
+        if (closed.size() > keepClosed)
+        {
+            closed.pop_back();
+        }
+    }
+    return final;
+}
+
+void
+StreamAccounting::charge(Account& account,
+                         size_t samples,
+                         const RunCost& cost)
+{
+    double audio = static_cast<double>(samples) / SAMPLE_RATE;
+    for (StreamUsage* usage : { &account.usage, &total })
+    {
+        ++usage->blocks;
+        usage->cpuSeconds += cost.cpuSeconds;
+        usage->wallSeconds += cost.wallSeconds;
+        usage->audioSeconds += audio;
+        if (audio > 0.0)
+        {
+            // Weighted by duration, so the average spans the same audio
+            // time whatever the block size
+            double weight = 1.0 - std::exp(-audio / LOAD_WINDOW_SECONDS);
+            usage->cpuPerAudioSecond +=
+              weight * (cost.cpuSeconds / audio - usage->cpuPerAudioSecond);
+        }
+    }
+}
+
+void
+StreamAccounting::record(Account* account,
+                         size_t samples,
+                         const RunCost& cost)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    charge(*account, samples, cost);
+}
+
+void
+StreamAccounting::recordBatch(
+  const std::vector<std::pair<Account*, size_t>>& items,
+  const RunCost& cost)
+{
+    size_t samples = 0;
+    for (const auto& item : items)
+    {
+        samples += item.second;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& item : items)
+    {
+        double share = samples > 0
+                         ? static_cast<double>(item.second) / samples
+                         : 1.0 / items.size();
+        RunCost part;
+        part.cpuSeconds  = cost.cpuSeconds * share;
+        part.wallSeconds = cost.wallSeconds * share;
+        charge(*item.first, item.second, part);
+    }
+}
+
+StreamUsage
+StreamAccounting::usage(const Account* account) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return account->usage;
+}
+
+std::vector<StreamUsage>
+StreamAccounting::top(size_t count) const
+{
+    std::vector<StreamUsage> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = closed;
+        for (const auto& entry : accounts)
+        {
+            result.push_back(entry.second->usage);
+        }
+    }
+    size_t kept = std::min(count, result.size());
+    std::partial_sort(
+      result.begin(), result.begin() + kept, result.end(), heavier);
+    result.resize(kept);
+    return result;
+}
+
+StreamUsage
+StreamAccounting::totals() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+}
+
+std::string
+StreamAccounting::render(size_t count) const
+{
+    std::vector<StreamUsage> heaviest = top(count);
+    StreamUsage all                   = totals();
+
+    std::ostringstream out;
+    out.precision(12);
+    out << "# HELP llvc_inference_cpu_seconds_total Thread CPU time of all"
+           " Runs\n"
+        << "# TYPE llvc_inference_cpu_seconds_total counter\n"
+        << "llvc_inference_cpu_seconds_total " << all.cpuSeconds << "\n";
+
+    struct Family
+    {
+        const char* name;
+        const char* type;
+        const char* help;
+        double StreamUsage::*value;
+    };
+    static const Family FAMILIES[] = {
+        { "llvc_stream_cpu_seconds_total",
+          "counter",
+          "Inference CPU time of the heaviest streams",
+          &StreamUsage::cpuSeconds },
+        { "llvc_stream_wall_seconds_total",
+          "counter",
+          "Inference wall time of the heaviest streams",
+          &StreamUsage::wallSeconds },
+        { "llvc_stream_audio_seconds_total",
+          "counter",
+          "Audio converted by the heaviest streams",
+          &StreamUsage::audioSeconds },
+        { "llvc_stream_cpu_per_audio_second",
+          "gauge",
+          "Recent CPU seconds per audio second of the heaviest streams",
+          &StreamUsage::cpuPerAudioSecond },
+    };
+    for (const Family& family : FAMILIES)
+    {
+        out << "# HELP " << family.name << " " << family.help << "\n"
+            << "# TYPE " << family.name << " " << family.type << "\n";
+        for (const StreamUsage& usage : heaviest)
+        {
+            out << family.name << "{stream=\"" << usage.id << "\",label=\""
+                << escapeLabel(usage.label) << "\",open=\""
+                << (usage.open ? "1" : "0") << "\"} "
+                << usage.*family.value << "\n";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Per-stream inference cost, for billing and fair-share throttling. Every
+// Run is timed on the thread that calls it, in thread CPU time and wall
+// time, and charged to the stream it served; a Run covering several
+// streams is split between them by their share of the samples. CPU time is
+// exact as long as ORT runs the graph on the calling thread
+// (SetIntraOpNumThreads(1), as every tool here does); time spent on ORT's
+// own pool threads would not be counted.
+
+// Cost of one Run
+struct RunCost
+{
+    double cpuSeconds  = 0.0;
+    double wallSeconds = 0.0;
+};
+
+// Measures the calling thread from construction to elapsed()
+class RunTimer
+{
+  public:
+    RunTimer();
+    RunCost elapsed() const;
+
+  private:
+    double cpuStart;
+    double wallStart;
+};
+
+struct StreamUsage
+{
+    uint64_t id = 0;
+    std::string label; // tenant, voice, ... as given by the caller
+    size_t blocks            = 0;
+    double cpuSeconds        = 0.0;
+    double wallSeconds       = 0.0;
+    double audioSeconds      = 0.0;
+    // Recent CPU seconds per audio second: the inverse of the real-time
+    // factor the tools print, so higher means heavier
+    double cpuPerAudioSecond = 0.0;
+    bool open                = true;
+
+    // Over the stream's lifetime
+    double averageCpuPerAudioSecond() const
+    {
+        return audioSeconds > 0.0 ? cpuSeconds / audioSeconds : 0.0;
+    }
+};
+
+class StreamAccounting
+{
+  public:
+    class Account;
+
+    // The `keepClosed` heaviest closed streams stay visible to top()
+    explicit StreamAccounting(size_t keepClosed = 16);
+    ~StreamAccounting();
+
+    StreamAccounting(const StreamAccounting&) = delete;
+    StreamAccounting& operator=(const StreamAccounting&) = delete;
+
+    Account* open(uint64_t id, const std::string& label = "");
+    void setLabel(Account* account, const std::string& label);
+    // Returns the final usage; the account is freed
+    StreamUsage close(Account* account);
+
+    void record(Account* account, size_t samples, const RunCost& cost);
+    // One Run over several streams: (account, samples) per stream
+    void recordBatch(const std::vector<std::pair<Account*, size_t>>& items,
+                     const RunCost& cost);
+
+    StreamUsage usage(const Account* account) const;
+    // Heaviest first by CPU time, open and recently closed streams alike
+    std::vector<StreamUsage> top(size_t count) const;
+    // Every stream ever opened, closed ones included
+    StreamUsage totals() const;
+
+    // Prometheus text for the `count` heaviest streams and the totals, for
+    // MetricsRegistry::collector
+    std::string render(size_t count) const;
+
+  private:
+    void charge(Account& account, size_t samples, const RunCost& cost);
+
+    const size_t keepClosed;
+    mutable std::mutex mutex;
+    std::unordered_map<Account*, std::unique_ptr<Account>> accounts;
+    std::vector<StreamUsage> closed; // heaviest first, at most keepClosed
+    StreamUsage total;
+};
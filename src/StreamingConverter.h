@@ -0,0 +1,272 @@
+#pragma once
+
+#include "llvc.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+// A converter specialised at compile time for one block size and state
+// layout. Shapes and buffer sizes are constants and the audio and state
+// live in fixed, 64-byte aligned arrays wrapped as tensors once, so a block
+// is two fixed-length copies and a Run, with no shape construction and no
+// allocation. The state is double buffered as in StatePool: a block reads
+// one bank and ORT writes the new state straight into the other.
+//
+// The model must return exactly BlockSize samples per block.
+
+// State shapes of the LLVC streaming model (llvc.h). Other layouts provide
+// the same four members.
+struct LlvcStateLayout
+{
+    static constexpr auto ENC_BUF         = ENC_BUF_SHAPE;
+    static constexpr auto DEC_BUF         = DEC_BUF_SHAPE;
+    static constexpr auto OUT_BUF         = OUT_BUF_SHAPE;
+    static constexpr auto CONVNET_PRE_CTX = CONVNET_PRE_CTX_SHAPE;
+};
+
+template <size_t N>
+constexpr size_t
+shapeElements(const std::array<int64_t, N>& shape)
+{
+    size_t count = 1;
+    for (size_t d = 0; d < N; ++d)
+    {
+        count *= static_cast<size_t>(shape[d]);
+    }
+    return count;
+}
+
+template <size_t BlockSize, typename StateLayout = LlvcStateLayout>
+class StreamingConverter
+{
+  public:
+    static constexpr size_t BLOCK_SIZE = BlockSize;
+    static constexpr std::array<int64_t, 3> AUDIO_SHAPE = {
+        1, 1, static_cast<int64_t>(BlockSize)
+    };
+
+    static_assert(BlockSize > 0, "blocks must hold at least one sample");
+    static_assert(std::size(INPUT_NAMES) == 5 && std::size(OUTPUT_NAMES) == 5,
+                  "the model has the audio and four state tensors");
+
+    explicit StreamingConverter(Ort::Session& session)
+      : session(&session)
+      , memoryInfo(
+          Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+      , storage(std::make_unique<Storage>())
+    {
+        for (int b = 0; b < 2; ++b)
+        {
+            inputs[b]  = wrapBank(storage->input, storage->banks[b]);
+            outputs[b] = wrapBank(storage->output, storage->banks[b ^ 1]);
+        }
+    }
+
+    StreamingConverter(StreamingConverter&&) = default;
+    StreamingConverter& operator=(StreamingConverter&&) = default;
+
+    // Converts exactly BlockSize samples; `input` and `output` may alias
+    void process(const float* input, float* output)
+    {
+        std::copy_n(input, BlockSize, storage->input.data());
+        session->Run(Ort::RunOptions{ nullptr },
+                     INPUT_NAMES,
+                     inputs[current].data(),
+                     5,
+                     OUTPUT_NAMES,
+                     outputs[current].data(),
+                     5);
+        std::copy_n(storage->output.data(), BlockSize, output);
+        current ^= 1;
+    }
+
+    // Back to silence, e.g. when the stream restarts
+    void reset()
+    {
+        Bank& bank = storage->banks[current];
+        bank.encBuf.fill(0.0f);
+        bank.decBuf.fill(0.0f);
+        bank.outBuf.fill(0.0f);
+        bank.convnetPreCtx.fill(0.0f);
+    }
+
+    // crossfade() from HotSwap.h over one block
+    static void crossfade(const float* from,
+                          const float* to,
+                          float* out,
+                          float startGain,
+                          float endGain)
+    {
+        const float step = (endGain - startGain) / BlockSize;
+        for (size_t i = 0; i < BlockSize; ++i)
+        {
+            float gain = startGain + step * i;
+            out[i]     = from[i] * (1.0f - gain) + to[i] * gain;
+        }
+    }
+
+  private:
+    struct Bank
+    {
+        alignas(64) std::array<float, shapeElements(StateLayout::ENC_BUF)>
+          encBuf;
+        alignas(64) std::array<float, shapeElements(StateLayout::DEC_BUF)>
+          decBuf;
+        alignas(64) std::array<float, shapeElements(StateLayout::OUT_BUF)>
+          outBuf;
+        alignas(64) std::array<float,
+                               shapeElements(StateLayout::CONVNET_PRE_CTX)>
+          convnetPreCtx;
+    };
+
+    // On the heap, as the state alone is over a megabyte; value
+    // initialization starts both banks at zero
+    struct Storage
+    {
+        alignas(64) std::array<float, BlockSize> input;
+        alignas(64) std::array<float, BlockSize> output;
+        Bank banks[2];
+    };
+
+    template <size_t Elements, size_t Rank>
+    Ort::Value wrap(std::array<float, Elements>& buffer,
+                    const std::array<int64_t, Rank>& shape)
+    {
+        return Ort::Value::CreateTensor<float>(
+          memoryInfo, buffer.data(), Elements, shape.data(), Rank);
+    }
+
+    // Audio in slot 0, then the state tensors in model order
+    std::vector<Ort::Value> wrapBank(std::array<float, BlockSize>& audio,
+                                     Bank& bank)
+    {
+        std::vector<Ort::Value> values;
+        values.reserve(5);
+        values.push_back(wrap(audio, AUDIO_SHAPE));
+        values.push_back(wrap(bank.encBuf, StateLayout::ENC_BUF));
+        values.push_back(wrap(bank.decBuf, StateLayout::DEC_BUF));
+        values.push_back(wrap(bank.outBuf, StateLayout::OUT_BUF));
+        values.push_back(
+          wrap(bank.convnetPreCtx, StateLayout::CONVNET_PRE_CTX));
+        return values;
+    }
+
+    Ort::Session* session;
+    Ort::MemoryInfo memoryInfo;
+    std::unique_ptr<Storage> storage;
+    std::vector<Ort::Value> inputs[2];  // reading bank b
+    std::vector<Ort::Value> outputs[2]; // writing the other bank
+    int current = 0;                    // bank holding the latest state
+};
+
+// The common block sizes behind one runtime-selected type, for callers
+// whose block size comes from a flag or a client
+class BlockConverter
+{
+  public:
+    // What processBlock() below takes as the state; the converter keeps
+    // its own
+    struct State
+    {
+    };
+
+    // Throws std::invalid_argument unless supports(blockSize)
+    BlockConverter(Ort::Session& session, size_t blockSize)
+      : converter(make(session, blockSize))
+    {
+    }
+
+    static bool supports(size_t blockSize)
+    {
+        return blockSize == 256 || blockSize == 512 || blockSize == 1024;
+    }
+
+    size_t blockSize() const
+    {
+        return std::visit([](const auto& c) { return c.BLOCK_SIZE; },
+                          converter);
+    }
+
+    void process(const float* input, float* output)
+    {
+        std::visit([&](auto& c) { c.process(input, output); }, converter);
+    }
+
+    void reset()
+    {
+        std::visit([](auto& c) { c.reset(); }, converter);
+    }
+
+    void crossfade(const float* from,
+                   const float* to,
+                   float* out,
+                   float startGain,
+                   float endGain) const
+    {
+        std::visit(
+          [&](const auto& c) {
+              c.crossfade(from, to, out, startGain, endGain);
+          },
+          converter);
+    }
+
+  private:
+    using Converters = std::variant<StreamingConverter<256>,
+                                    StreamingConverter<512>,
+                                    StreamingConverter<1024>>;
+
+    static Converters make(Ort::Session& session, size_t blockSize)
+    {
+        switch (blockSize)
+        {
+            case 256:
+                return StreamingConverter<256>(session);
+            case 512:
+                return StreamingConverter<512>(session);
+            case 1024:
+                return StreamingConverter<1024>(session);
+            default:
+                throw std::invalid_argument(
+                  "no converter for blocks of " + std::to_string(blockSize) +
+                  " samples (256, 512 or 1024)");
+        }
+    }
+
+    Converters converter;
+};
+
+// The llvc.h processBlock() overloads for a BlockConverter, so code written
+// against them (VadGate, the command-line tools) runs it too. `samples`
+// must be the converter's block size.
+inline size_t
+processBlock(BlockConverter& converter,
+             const float* input,
+             float* output,
+             size_t samples,
+             BlockConverter::State&)
+{
+    if (samples != converter.blockSize())
+    {
+        throw std::invalid_argument(
+          std::to_string(samples) + "-sample block for a converter of " +
+          std::to_string(converter.blockSize()));
+    }
+    converter.process(input, output);
+    return samples;
+}
+
+inline void
+processBlock(BlockConverter& converter,
+             std::vector<float>& block,
+             BlockConverter::State& state)
+{
+    processBlock(converter, block.data(), block.data(), block.size(), state);
+}
@@ -0,0 +1,147 @@
+#include "VadGate.h"
+#include <cmath>
+
+namespace
+{
+float
+rmsDb(const float* samples, size_t count)
+{
+    double energy = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        energy += static_cast<double>(samples[i]) * samples[i];
+    }
+    double rms = std::sqrt(energy / std::max<size_t>(count, 1));
+    return static_cast<float>(20.0 * std::log10(std::max(rms, 1e-10)));
+}
+} // namespace
+
+double
+VadStats::skipRate() const
+{
+    return blocks ? static_cast<double>(skipped) / blocks : 0.0;
+}
+
+double
+VadStats::savedSeconds() const
+{
+    if (modelRuns == 0)
+    {
+        return 0.0;
+    }
+    double perRun = modelSeconds / modelRuns;
+    return perRun * (static_cast<double>(skipped) - warmupRuns);
+}
+
+VadStats&
+VadStats::operator+=(const VadStats& other)
+{
+    blocks += other.blocks;
+    skipped += other.skipped;
+    warmupRuns += other.warmupRuns;
+    modelRuns += other.modelRuns;
+    modelSeconds += other.modelSeconds;
+    return *this;
+}
+
+std::ostream&
+operator<<(std::ostream& out, const VadStats& stats)
+{
+    double spent = stats.modelSeconds;
+    double saved = stats.savedSeconds();
+    out << "VAD skipped " << stats.skipped << " of " << stats.blocks
+        << " blocks (" << 100.0 * stats.skipRate() << "%), "
+        << stats.warmupRuns << " warm-up runs, saved ~" << saved * 1000.0
+        << " ms of model time ("
+        << (spent + saved > 0.0 ? 100.0 * saved / (spent + saved) : 0.0)
+        << "% CPU)";
+    return out;
+}
+
+VadGate::VadGate(const VadOptions& options)
+  : options(options)
+  , history(options.warmupBlocks)
+{
+}
+
+bool
+VadGate::classify(const float* input, size_t samples, size_t& warmup)
+{
+    ++stats.blocks;
+    float level = rmsDb(input, samples);
+    bool speech = level >= (speaking ? options.closeDb : options.openDb);
+
+    bool run = false;
+    if (speech)
+    {
+        if (skipping)
+        {
+            warmup = historyCount;
+        }
+        speaking = true;
+        hangover = options.hangoverBlocks;
+        run      = true;
+    }
+    else
+    {
+        speaking = false;
+        if (hangover > 0)
+        {
+            --hangover; // let the model ring out naturally
+            run = true;
+        }
+    }
+
+    if (run)
+    {
+        skipping     = false;
+        fadeGain     = 1.0f;
+        fadeOffset   = 0;
+        historyCount = 0;
+        return true;
+    }
+
+    // Keep the block for warm-up; copied before `output` may overwrite it
+    if (!history.empty())
+    {
+        history[historyNext].assign(input, input + samples);
+        historyNext  = (historyNext + 1) % history.size();
+        historyCount = std::min(historyCount + 1, history.size());
+    }
+    skipping = true;
+    ++stats.skipped;
+    return false;
+}
+
+void
+VadGate::skip(float* output, size_t samples)
+{
+    if (options.skipOutput == VadSkipOutput::Silence || fadeGain < 1e-4f ||
+        lastOutput.empty())
+    {
+        std::fill(output, output + samples, 0.0f);
+        return;
+    }
+
+    // Ramp from the current gain to the next one across the block, reading
+    // the last output backwards from its final sample, then forwards, ...
+    size_t n   = lastOutput.size();
+    float next = fadeGain * options.fadeDecay;
+    float step = (next - fadeGain) / std::max<size_t>(samples, 1);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        size_t m  = (fadeOffset + i) % (2 * n);
+        output[i] = lastOutput[m < n ? n - 1 - m : m - n] *
+                    (fadeGain + step * i);
+    }
+    fadeOffset += samples;
+    fadeGain = next;
+}
+
+const std::vector<float>&
+VadGate::replayBlock(size_t count, size_t i) const
+{
+    // Oldest first
+    size_t n = history.size();
+    return history[(historyNext + n - count + i) % n];
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Energy gate in front of processBlock. Silent blocks bypass the model and
+// leave the recurrent state frozen where speech ended; on speech onset the
+// last few skipped blocks are replayed through the model (output discarded)
+// so the state catches up before the first syllable is converted.
+
+enum class VadSkipOutput
+{
+    Silence, // zeros
+    // The last converted block, played back and forth from its end so the
+    // waveform stays continuous, faded out over a few blocks. The input is
+    // never passed through, as it is the source speaker's voice.
+    Fade
+};
+
+struct VadOptions
+{
+    float openDb             = -45.0f; // block RMS (dBFS) that starts speech
+    float closeDb            = -51.0f; // speech lasts until RMS drops below
+    size_t hangoverBlocks    = 4;      // still converted after speech ends
+    size_t warmupBlocks      = 2;      // skipped blocks replayed on onset
+    VadSkipOutput skipOutput = VadSkipOutput::Fade;
+    float fadeDecay          = 0.25f; // Fade gain multiplier per block
+};
+
+struct VadStats
+{
+    size_t blocks       = 0;
+    size_t skipped      = 0;
+    size_t warmupRuns   = 0;
+    size_t modelRuns    = 0;
+    double modelSeconds = 0.0; // time spent in the model, warm-up included
+
+    double skipRate() const;
+    // Model time avoided by skipping, net of the warm-up replays
+    double savedSeconds() const;
+    VadStats& operator+=(const VadStats& other);
+};
+
+std::ostream&
+operator<<(std::ostream& out, const VadStats& stats);
+
+class VadGate
+{
+  public:
+    explicit VadGate(const VadOptions& options = VadOptions());
+
+    // Converts one block with processBlock(session, ..., state), or writes
+    // the skip output without running the model. Works with any session
+    // and state types that have a pointer processBlock overload (an
+    // Ort::Session, or a NativeEngine). `input` and `output` may alias.
+    // Returns true if the model ran on this block.
+    template <typename Session, typename State>
+    bool process(Session& session,
+                 const float* input,
+                 float* output,
+                 size_t samples,
+                 State& state)
+    {
+        size_t warmup = 0;
+        if (!classify(input, samples, warmup))
+        {
+            skip(output, samples);
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < warmup; ++i)
+        {
+            const std::vector<float>& block = replayBlock(warmup, i);
+            scratch.resize(std::max(scratch.size(), block.size()));
+            processBlock(
+              session, block.data(), scratch.data(), block.size(), state);
+        }
+        processBlock(session, input, output, samples, state);
+        lastOutput.assign(output, output + samples);
+        stats.modelSeconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+        stats.warmupRuns += warmup;
+        stats.modelRuns += warmup + 1;
+        return true;
+    }
+
+    const VadStats& statistics() const { return stats; }
+
+  private:
+    bool classify(const float* input, size_t samples, size_t& warmup);
+    void skip(float* output, size_t samples);
+    const std::vector<float>& replayBlock(size_t count, size_t i) const;
+
+    VadOptions options;
+    VadStats stats;
+    bool speaking     = false;
+    bool skipping     = false; // previous block bypassed the model
+    size_t hangover   = 0;
+    float fadeGain    = 0.0f; // nothing to fade out before the first speech
+    size_t fadeOffset = 0;    // samples of the fade written so far
+    std::vector<float> lastOutput; // most recent converted block, to fade
+    // Most recent skipped input blocks, for warm-up on onset
+    std::vector<std::vector<float>> history;
+    size_t historyNext  = 0;
+    size_t historyCount = 0;
+    std::vector<float> scratch;
+};
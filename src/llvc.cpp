@@ -0,0 +1,184 @@
+#include "llvc.h"
+#include <algorithm>
+
+namespace
+{
+template <size_t N>
+std::unique_ptr<Ort::Value>
+createZeroTensor(OrtAllocator* allocator,
+                 std::array<int64_t, N> shape,
+                 size_t batch)
+{
+    shape[0] = static_cast<int64_t>(batch);
+    std::unique_ptr<Ort::Value> tensor = std::make_unique<Ort::Value>(
+      Ort::Value::CreateTensor<float>(allocator, shape.data(), shape.size()));
+    float* data = tensor->GetTensorMutableData<float>();
+    std::fill(
+      data, data + tensor->GetTensorTypeAndShapeInfo().GetElementCount(), 0.0f);
+    return tensor;
+}
+} // namespace
+
+StreamState
+createStreamState(size_t batch)
+{
+    Ort::AllocatorWithDefaultOptions allocator;
+
+    StreamState state;
+    state.enc_buf_tensor = createZeroTensor(allocator, ENC_BUF_SHAPE, batch);
+    state.dec_buf_tensor = createZeroTensor(allocator, DEC_BUF_SHAPE, batch);
+    state.out_buf_tensor = createZeroTensor(allocator, OUT_BUF_SHAPE, batch);
+    state.convnet_pre_ctx_tensor =
+      createZeroTensor(allocator, CONVNET_PRE_CTX_SHAPE, batch);
+    return state;
+}
+
+bool
+acceptsBatch(Ort::Session& session)
+{
+    for (size_t i = 0; i < session.GetInputCount(); ++i)
+    {
+        std::vector<int64_t> shape = session.GetInputTypeInfo(i)
+                                       .GetTensorTypeAndShapeInfo()
+                                       .GetShape();
+        // No shape at all is as good as a symbolic one
+        if (!shape.empty() && shape[0] >= 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace
+{
+// Returns the samples written per stream, at most `samples`
+size_t
+runBlock(Ort::Session& session,
+         const float* input,
+         float* output,
+         size_t batch,
+         size_t samples,
+         std::unique_ptr<Ort::Value>& enc_buf_tensor,
+         std::unique_ptr<Ort::Value>& dec_buf_tensor,
+         std::unique_ptr<Ort::Value>& out_buf_tensor,
+         std::unique_ptr<Ort::Value>& convnet_pre_ctx_tensor)
+{
+    // Prepare input tensors; ORT only reads from the input buffer
+    Ort::MemoryInfo memory_info =
+      Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+    const int64_t input_shape[] = { static_cast<int64_t>(batch),
+                                    1,
+                                    static_cast<int64_t>(samples) };
+    Ort::Value input_tensor =
+      Ort::Value::CreateTensor<float>(memory_info,
+                                      const_cast<float*>(input),
+                                      batch * samples,
+                                      input_shape,
+                                      3);
+
+    // Run inference
+    Ort::Value ort_inputs[] = { std::move(input_tensor),
+                                std::move(*enc_buf_tensor),
+                                std::move(*dec_buf_tensor),
+                                std::move(*out_buf_tensor),
+                                std::move(*convnet_pre_ctx_tensor) };
+
+    auto output_tensors = session.Run(Ort::RunOptions{ nullptr },
+                                      INPUT_NAMES,
+                                      ort_inputs,
+                                      5,
+                                      OUTPUT_NAMES,
+                                      5);
+
+    // Process output writing to the block, stream by stream: the model may
+    // return a different length than it was given, so the streams are
+    // spaced by the output's last dimension, not by `samples`
+    const float* output_data = output_tensors[0].GetTensorData<float>();
+    Ort::TensorTypeAndShapeInfo output_info =
+      output_tensors[0].GetTensorTypeAndShapeInfo();
+    std::vector<int64_t> output_shape = output_info.GetShape();
+    size_t stride = output_shape.empty()
+                      ? output_info.GetElementCount() / batch
+                      : static_cast<size_t>(output_shape.back());
+    size_t produced = std::min(stride, samples);
+    for (size_t b = 0; b < batch; ++b)
+    {
+        std::copy(output_data + b * stride,
+                  output_data + b * stride + produced,
+                  output + b * samples);
+    }
+
+    // Update state tensors with new values, reusing the existing wrappers
+    *enc_buf_tensor         = std::move(output_tensors[1]);
+    *dec_buf_tensor         = std::move(output_tensors[2]);
+    *out_buf_tensor         = std::move(output_tensors[3]);
+    *convnet_pre_ctx_tensor = std::move(output_tensors[4]);
+    return produced;
+}
+} // namespace
+
+void
+processBlock(Ort::Session& session,
+             std::vector<float>& block,
+             std::unique_ptr<Ort::Value>& enc_buf_tensor,
+             std::unique_ptr<Ort::Value>& dec_buf_tensor,
+             std::unique_ptr<Ort::Value>& out_buf_tensor,
+             std::unique_ptr<Ort::Value>& convnet_pre_ctx_tensor)
+{
+    runBlock(session,
+             block.data(),
+             block.data(),
+             1,
+             block.size(),
+             enc_buf_tensor,
+             dec_buf_tensor,
+             out_buf_tensor,
+             convnet_pre_ctx_tensor);
+}
+
+void
+processBlock(Ort::Session& session,
+             std::vector<float>& block,
+             StreamState& state)
+{
+    processBlock(session, block.data(), block.data(), block.size(), state);
+}
+
+size_t
+processBlock(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t samples,
+             StreamState& state)
+{
+    return runBlock(session,
+                    input,
+                    output,
+                    1,
+                    samples,
+                    state.enc_buf_tensor,
+                    state.dec_buf_tensor,
+                    state.out_buf_tensor,
+                    state.convnet_pre_ctx_tensor);
+}
+
+size_t
+processBatch(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t batch,
+             size_t samples,
+             StreamState& state)
+{
+    return runBlock(session,
+                    input,
+                    output,
+                    batch,
+                    samples,
+                    state.enc_buf_tensor,
+                    state.dec_buf_tensor,
+                    state.out_buf_tensor,
+                    state.convnet_pre_ctx_tensor);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// I/O signature of the exported LLVC streaming model: a mono 16 kHz block
+// plus four recurrent state tensors that are fed back on every call.
+const int SAMPLE_RATE = 16000;
+
+constexpr std::array<int64_t, 3> ENC_BUF_SHAPE         = { 1, 512, 510 };
+constexpr std::array<int64_t, 4> DEC_BUF_SHAPE         = { 1, 2, 13, 256 };
+constexpr std::array<int64_t, 3> OUT_BUF_SHAPE         = { 1, 512, 4 };
+constexpr std::array<int64_t, 3> CONVNET_PRE_CTX_SHAPE = { 1, 1, 24 };
+
+const char* const INPUT_NAMES[] = {
+    "input", "enc_buf", "dec_buf", "out_buf", "convnet_pre_ctx"
+};
+const char* const OUTPUT_NAMES[] = { "output",
+                                     "new_enc_buf",
+                                     "new_dec_buf",
+                                     "new_out_buf",
+                                     "new_convnet_pre_ctx" };
+
+// The recurrent state of one stream, owned by ORT once the first block ran
+struct StreamState
+{
+    std::unique_ptr<Ort::Value> enc_buf_tensor;
+    std::unique_ptr<Ort::Value> dec_buf_tensor;
+    std::unique_ptr<Ort::Value> out_buf_tensor;
+    std::unique_ptr<Ort::Value> convnet_pre_ctx_tensor;
+};
+
+// Allocates zeroed state tensors from the default ORT allocator, for
+// `batch` streams run together by processBatch
+StreamState
+createStreamState(size_t batch = 1);
+
+// True if the model leaves the batch dimension of every input symbolic, so
+// one Run can carry several streams
+bool
+acceptsBatch(Ort::Session& session);
+
+// Takes in a ref to the session, and does inference on the input block
+void
+processBlock(Ort::Session& session,
+             std::vector<float>& block,
+             std::unique_ptr<Ort::Value>& enc_buf_tensor,
+             std::unique_ptr<Ort::Value>& dec_buf_tensor,
+             std::unique_ptr<Ort::Value>& out_buf_tensor,
+             std::unique_ptr<Ort::Value>& convnet_pre_ctx_tensor);
+
+void
+processBlock(Ort::Session& session,
+             std::vector<float>& block,
+             StreamState& state);
+
+// Pointer variant for callers that own their sample memory (e.g. shared
+// memory rings). `input` and `output` may alias. Returns the samples
+// written, which is less than `samples` if the model returned fewer.
+size_t
+processBlock(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t samples,
+             StreamState& state);
+
+// Runs `batch` independent streams in one Run, e.g. the channels of a
+// file. `input` and `output` hold `samples` per stream, stream after
+// stream, and may alias; `state` comes from createStreamState(batch).
+// Returns the samples written per stream, as processBlock does.
+size_t
+processBatch(Ort::Session& session,
+             const float* input,
+             float* output,
+             size_t batch,
+             size_t samples,
+             StreamState& state);
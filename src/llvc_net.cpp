@@ -0,0 +1,240 @@
+#include "llvc_net.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+[[noreturn]] void
+throwErrno(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+struct Endpoint
+{
+    bool isUnix = false;
+    std::string host; // tcp host or unix path
+    std::string port;
+};
+
+Endpoint
+parseEndpoint(const std::string& endpoint)
+{
+    Endpoint ep;
+    if (endpoint.rfind("unix:", 0) == 0)
+    {
+        ep.isUnix = true;
+        ep.host   = endpoint.substr(5);
+        return ep;
+    }
+
+    std::string rest =
+      endpoint.rfind("tcp:", 0) == 0 ? endpoint.substr(4) : endpoint;
+    size_t colon = rest.rfind(':');
+    if (colon == std::string::npos)
+    {
+        ep.host = "127.0.0.1";
+        ep.port = rest;
+    }
+    else
+    {
+        ep.host = rest.substr(0, colon);
+        ep.port = rest.substr(colon + 1);
+    }
+    return ep;
+}
+
+sockaddr_un
+unixAddress(const std::string& path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        throw std::runtime_error("unix socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+addrinfo*
+resolve(const Endpoint& ep, bool passive)
+{
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : 0;
+
+    addrinfo* result = nullptr;
+    int err = getaddrinfo(ep.host.c_str(), ep.port.c_str(), &hints, &result);
+    if (err != 0)
+    {
+        throw std::runtime_error("cannot resolve " + ep.host + ":" + ep.port +
+                                 ": " + gai_strerror(err));
+    }
+    return result;
+}
+} // namespace
+
+int
+listenOn(const std::string& endpoint, int backlog)
+{
+    Endpoint ep = parseEndpoint(endpoint);
+    int fd      = -1;
+
+    if (ep.isUnix)
+    {
+        sockaddr_un addr = unixAddress(ep.host);
+        unlink(ep.host.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(fd);
+            throwErrno("bind " + endpoint);
+        }
+    }
+    else
+    {
+        addrinfo* info = resolve(ep, true);
+        fd = socket(info->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            freeaddrinfo(info);
+            throwErrno("socket");
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, info->ai_addr, info->ai_addrlen) < 0)
+        {
+            freeaddrinfo(info);
+            close(fd);
+            throwErrno("bind " + endpoint);
+        }
+        freeaddrinfo(info);
+    }
+
+    if (listen(fd, backlog) < 0)
+    {
+        close(fd);
+        throwErrno("listen " + endpoint);
+    }
+    return fd;
+}
+
+int
+connectTo(const std::string& endpoint)
+{
+    Endpoint ep = parseEndpoint(endpoint);
+
+    if (ep.isUnix)
+    {
+        sockaddr_un addr = unixAddress(ep.host);
+        int fd           = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(fd);
+            throwErrno("connect " + endpoint);
+        }
+        return fd;
+    }
+
+    addrinfo* info = resolve(ep, false);
+    int fd         = socket(info->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        freeaddrinfo(info);
+        throwErrno("socket");
+    }
+    if (connect(fd, info->ai_addr, info->ai_addrlen) < 0)
+    {
+        freeaddrinfo(info);
+        close(fd);
+        throwErrno("connect " + endpoint);
+    }
+    freeaddrinfo(info);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+void
+setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        throwErrno("fcntl O_NONBLOCK");
+    }
+}
+
+bool
+readFully(int fd, void* data, size_t size)
+{
+    char* out   = static_cast<char*>(data);
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = read(fd, out + done, size - done);
+        if (n == 0)
+        {
+            return false;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ECONNRESET)
+            {
+                return false;
+            }
+            throwErrno("read");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool
+writeFully(int fd, const void* data, size_t size)
+{
+    const char* in = static_cast<const char*>(data);
+    size_t done    = 0;
+    while (done < size)
+    {
+        ssize_t n = send(fd, in + done, size - done, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EPIPE || errno == ECONNRESET)
+            {
+                return false;
+            }
+            throwErrno("write");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
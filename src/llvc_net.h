@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Small socket helpers shared by the server and its clients. Endpoints are
+// written as "tcp:HOST:PORT" or "unix:PATH". Failures throw
+// std::runtime_error with the errno text.
+
+// Creates a listening socket; stale unix socket files are replaced
+int
+listenOn(const std::string& endpoint, int backlog = 1024);
+
+// Connects a blocking socket (TCP_NODELAY set for tcp endpoints)
+int
+connectTo(const std::string& endpoint);
+
+void
+setNonBlocking(int fd);
+
+// Blocking helpers: return false on EOF / closed peer
+bool
+readFully(int fd, void* data, size_t size);
+
+bool
+writeFully(int fd, const void* data, size_t size);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// Framed PCM protocol spoken by llvc_server. Every message is a FrameHeader
+// followed by `length` payload bytes; integers and samples are little-endian.
+//
+//   client -> server: HELLO once, then AUDIO frames, then BYE
+//   server -> client: one AUDIO frame per AUDIO frame received, in order,
+//                     or ERROR followed by closing the connection
+//
+// AUDIO payloads are float32 samples at 16 kHz mono. Each connection is one
+// stream and owns its own recurrent state on the server.
+//
+// A stream's state can be carried to another connection or server (to
+// resume a dropped call or move off a busy server) as a StateSnapshot.h
+// blob: SNAPSHOT asks for the state after every AUDIO frame sent before
+// it, and the server answers with a STATE frame in line with the AUDIO
+// replies; an optional one-byte payload picks the SnapshotPrecision. A
+// STATE frame sent after HELLO and before any AUDIO restores that state.
+const uint32_t LLVC_PROTOCOL_VERSION = 1;
+const uint32_t MAX_FRAME_SAMPLES     = 16384;
+const uint32_t MAX_VOICE_NAME        = 64;
+const uint32_t MAX_STATE_BYTES       = 16 << 20;
+
+enum FrameType : uint32_t
+{
+    FRAME_HELLO    = 1,
+    FRAME_AUDIO    = 2,
+    FRAME_BYE      = 3,
+    FRAME_ERROR    = 4,
+    FRAME_STATE    = 5,
+    FRAME_SNAPSHOT = 6
+};
+
+struct FrameHeader
+{
+    uint32_t type;
+    uint32_t length; // payload bytes following the header
+};
+static_assert(sizeof(FrameHeader) == 8, "FrameHeader must be packed");
+
+// HELLO payload. An optional voice name (up to MAX_VOICE_NAME bytes, no
+// terminator) follows; servers with a model directory load that voice.
+struct HelloPayload
+{
+    uint32_t version;
+    uint32_t sampleRate;
+};
+static_assert(sizeof(HelloPayload) == 8, "HelloPayload must be packed");
@@ -0,0 +1,217 @@
+#include "llvc_startup.h"
+#include "MappedModel.h"
+#include "OrtProfile.h"
+#include "llvc.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const size_t STEADY_WINDOW    = 3;
+const double STEADY_TOLERANCE = 0.15; // spread allowed within the window
+
+std::atomic<unsigned> profileCount{ 0 };
+
+double
+millisSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+double
+median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+bool
+settled(const std::vector<double>& times)
+{
+    if (times.size() < STEADY_WINDOW + 1) // never count the first run
+    {
+        return false;
+    }
+    auto last  = times.end() - STEADY_WINDOW;
+    auto range = std::minmax_element(last, times.end());
+    return *range.second - *range.first <= STEADY_TOLERANCE * *range.second;
+}
+
+// Constructs the session with `construct`, which is handed a copy of
+// `options` with profiling enabled
+template <typename Construct>
+std::unique_ptr<Ort::Session>
+profiledSession(const Ort::SessionOptions& options,
+                StartupReport& report,
+                Construct construct)
+{
+    // ORT only appends a timestamp, so sessions loading at the same time,
+    // in this process or another, need prefixes of their own
+    std::string prefix =
+      (std::filesystem::temp_directory_path() /
+       ("llvc_startup_" + std::to_string(getpid()) + "_" +
+        std::to_string(profileCount.fetch_add(1))))
+        .string();
+    Ort::SessionOptions profiled = options.Clone();
+    profiled.EnableProfiling(prefix.c_str());
+
+    auto start       = Clock::now();
+    auto session     = construct(profiled);
+    report.sessionMs = millisSince(start);
+
+    // Ending the profile here also keeps later Runs from being traced
+    Ort::AllocatorWithDefaultOptions allocator;
+    Ort::AllocatedStringPtr path = session->EndProfilingAllocated(allocator);
+    try
+    {
+        std::vector<ProfileEvent> events = loadProfile(path.get());
+        report.modelLoadMs = sessionEventMs(events, "model_loading_uri") +
+                             sessionEventMs(events, "model_loading_array");
+        report.initializationMs =
+          sessionEventMs(events, "session_initialization");
+    }
+    catch (const std::exception&)
+    {
+        // The breakdown is best effort; the wall-clock total is still valid
+    }
+    std::remove(path.get());
+    return session;
+}
+} // namespace
+
+std::unique_ptr<Ort::Session>
+createSession(Ort::Env& env,
+              const char* modelPath,
+              const Ort::SessionOptions& options,
+              StartupReport& report)
+{
+    return profiledSession(options, report, [&](Ort::SessionOptions& opts) {
+        return std::make_unique<Ort::Session>(env, modelPath, opts);
+    });
+}
+
+std::unique_ptr<Ort::Session>
+createSession(Ort::Env& env,
+              const MappedModel& model,
+              const Ort::SessionOptions& options,
+              StartupReport& report)
+{
+    report.mappedWeightBytes = model.mappedBytes();
+    return profiledSession(options, report, [&](Ort::SessionOptions& opts) {
+        Ort::SessionOptions mapped = model.sessionOptions(opts);
+        const std::string& bytes   = model.modelBytes();
+        return std::make_unique<Ort::Session>(
+          env, bytes.data(), bytes.size(), mapped);
+    });
+}
+
+void
+readResidentMemory(StartupReport& report)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        size_t kb = 0;
+        fields >> key >> kb;
+        if (key == "RssAnon:")
+        {
+            report.privateBytes = kb * 1024;
+        }
+        else if (key == "RssFile:")
+        {
+            report.fileBytes = kb * 1024;
+        }
+    }
+}
+
+void
+warmUpSession(Ort::Session& session,
+              const std::vector<size_t>& blockSizes,
+              StartupReport& report,
+              size_t maxRuns)
+{
+    // Low-level noise rather than zeros, so no kernel takes a shortcut
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+
+    auto total = Clock::now();
+    for (size_t blockSize : blockSizes)
+    {
+        StreamState state = createStreamState();
+        std::vector<float> block(blockSize);
+        std::vector<double> times;
+
+        while (times.size() < std::max<size_t>(maxRuns, 1) && !settled(times))
+        {
+            std::generate(
+              block.begin(), block.end(), [&] { return noise(rng); });
+            auto start = Clock::now();
+            processBlock(session, block, state);
+            times.push_back(millisSince(start));
+        }
+
+        WarmupTiming timing;
+        timing.blockSize = blockSize;
+        timing.runs      = times.size();
+        timing.firstMs   = times.front();
+        timing.steadyMs  = median(std::vector<double>(
+          times.end() - std::min(times.size(), STEADY_WINDOW), times.end()));
+        report.warmups.push_back(timing);
+    }
+    report.warmupMs += millisSince(total);
+}
+
+void
+printStartupReport(std::ostream& out, const StartupReport& report)
+{
+    out << "Startup: ";
+    if (report.mapMs > 0.0)
+    {
+        out << "mapping " << report.mapMs << " ms, ";
+    }
+    out << "session " << report.sessionMs << " ms";
+    if (report.modelLoadMs > 0.0 || report.initializationMs > 0.0)
+    {
+        out << " (model load " << report.modelLoadMs
+            << " ms, optimization + init " << report.initializationMs
+            << " ms)";
+    }
+    out << ", warm-up " << report.warmupMs << " ms" << std::endl;
+    for (const WarmupTiming& timing : report.warmups)
+    {
+        out << "  block " << timing.blockSize << ": first run "
+            << timing.firstMs << " ms, steady " << timing.steadyMs
+            << " ms after " << timing.runs << " runs" << std::endl;
+    }
+    if (report.privateBytes || report.fileBytes)
+    {
+        out << "  resident: " << report.privateBytes / 1048576.0
+            << " MB private, " << report.fileBytes / 1048576.0
+            << " MB file-backed";
+        if (report.mappedWeightBytes)
+        {
+            out << " (" << report.mappedWeightBytes / 1048576.0
+                << " MB of weights mapped)";
+        }
+        out << std::endl;
+    }
+    if (report.firstBlockMs >= 0.0)
+    {
+        out << "  first live block: " << report.firstBlockMs << " ms"
+            << std::endl;
+    }
+}
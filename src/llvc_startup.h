@@ -0,0 +1,70 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+class MappedModel;
+
+// Session start-up with a timing breakdown and warm-up. The first Run after
+// construction pays for arena growth, lazy allocations and kernel selection;
+// running a few dummy blocks at every block size the caller will use moves
+// that cost out of the first live block.
+
+struct WarmupTiming
+{
+    size_t blockSize = 0;
+    size_t runs      = 0;
+    double firstMs   = 0.0;
+    double steadyMs  = 0.0; // median of the last few runs
+};
+
+struct StartupReport
+{
+    double mapMs            = 0.0; // mapping and scanning (MappedModel)
+    double sessionMs        = 0.0; // Session constructor, wall clock
+    double modelLoadMs      = 0.0; // from ORT's profiler
+    double initializationMs = 0.0; // graph optimization and kernel setup
+    std::vector<WarmupTiming> warmups;
+    double warmupMs     = 0.0;
+    double firstBlockMs = -1.0; // first live block, measured by the caller
+    // Process RSS after warm-up (see readResidentMemory)
+    size_t privateBytes      = 0; // anonymous: heap, arenas, copied weights
+    size_t fileBytes         = 0; // file-backed: code and mapped weights
+    size_t mappedWeightBytes = 0; // left in a shared mapping (MappedModel)
+};
+
+// Creates the session with ORT profiling enabled only for construction, to
+// split load from initialization. Profiling is turned on in a copy of
+// `options`; the caller's options, which may be shared, are not modified.
+std::unique_ptr<Ort::Session>
+createSession(Ort::Env& env,
+              const char* modelPath,
+              const Ort::SessionOptions& options,
+              StartupReport& report);
+
+// The same from a MappedModel, sharing its weights
+std::unique_ptr<Ort::Session>
+createSession(Ort::Env& env,
+              const MappedModel& model,
+              const Ort::SessionOptions& options,
+              StartupReport& report);
+
+// Fills in privateBytes and fileBytes from /proc/self/status (Linux only).
+// File-backed pages are shared with every other process mapping the same
+// files; private pages are this process's alone.
+void
+readResidentMemory(StartupReport& report);
+
+// Runs dummy blocks on fresh state at each size until block latency
+// settles (at most maxRuns per size)
+void
+warmUpSession(Ort::Session& session,
+              const std::vector<size_t>& blockSizes,
+              StartupReport& report,
+              size_t maxRuns = 16);
+
+void
+printStartupReport(std::ostream& out, const StartupReport& report);
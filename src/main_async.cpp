@@ -0,0 +1,293 @@
+#include "llvc.h"
+#include "AsyncConverter.h"
+#include "Numa.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Drives many streams through the AsyncConverter from one event-loop
+// thread: the loop only submits blocks and collects completions, which the
+// callbacks post to its inbox. Reports throughput, completion latency and
+// whether every stream's blocks came back in order. With --numa the
+// converter gets one session, worker set and state pool per NUMA node;
+// compare against a run without it to see what local placement buys. Each
+// stream's Runs are charged to it (StreamAccounting.h), and the spread
+// between the lightest and heaviest stream is reported.
+
+using Clock = std::chrono::steady_clock;
+
+struct Completed
+{
+    size_t stream;
+    size_t sequence;
+    Clock::time_point submitted;
+    bool failed;
+};
+
+// The event loop's queue; callbacks run on inference threads
+struct Inbox
+{
+    std::mutex mutex;
+    std::condition_variable posted;
+    std::vector<Completed> items;
+};
+
+struct StreamDriver
+{
+    AsyncConverter::Stream* stream = nullptr;
+    size_t submitted               = 0;
+    size_t expected                = 0; // next sequence to complete
+};
+
+static void
+fillBlock(std::vector<float>& block, size_t index)
+{
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        double t = static_cast<double>(index * block.size() + i) / SAMPLE_RATE;
+        block[i] = static_cast<float>(0.3 * std::sin(2 * M_PI * 140.0 * t) +
+                                      0.1 * std::sin(2 * M_PI * 430.0 * t));
+    }
+}
+
+static double
+percentile(std::vector<double>& values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* modelPath = nullptr;
+    size_t streams        = 64;
+    size_t threads        = 4;
+    size_t depth          = 2;
+    size_t blockSize      = 1024;
+    size_t blocks         = 50; // per stream
+    bool numa             = false;
+    bool usage            = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+        std::string arg = argv[i];
+        size_t* target  = nullptr;
+        if (arg == "--numa")
+        {
+            numa = true;
+            continue;
+        }
+        if (arg == "--streams")
+        {
+            target = &streams;
+        }
+        else if (arg == "--threads")
+        {
+            target = &threads;
+        }
+        else if (arg == "--depth")
+        {
+            target = &depth;
+        }
+        else if (arg == "--block-size")
+        {
+            target = &blockSize;
+        }
+        else if (arg == "--blocks")
+        {
+            target = &blocks;
+        }
+        else if (!modelPath && arg[0] != '-')
+        {
+            modelPath = argv[i];
+            continue;
+        }
+        if (!target || i + 1 >= argc)
+        {
+            usage = true;
+            break;
+        }
+        *target = std::strtoul(argv[++i], nullptr, 10);
+        usage   = *target == 0;
+    }
+    if (usage || !modelPath)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> [--streams N] [--threads N] [--depth N]"
+                     " [--block-size N] [--blocks N] [--numa]"
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_async");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+
+        // Without --numa: one session wherever the loader thread ran, and
+        // workers free to migrate. With it: a session per node, created
+        // there, and the thread and stream counts split across the nodes.
+        std::vector<NumaNode> nodes;
+        std::vector<std::unique_ptr<Ort::Session>> sessions;
+        if (numa)
+        {
+            nodes = numaTopology();
+            for (const NumaNode& node : nodes)
+            {
+                std::cout << "NUMA node " << node.id << ": " << node.cpus.size()
+                          << " CPUs" << std::endl;
+                sessions.push_back(createSessionOnNode(
+                  env, modelPath, session_options, node));
+            }
+        }
+        else
+        {
+            sessions.push_back(
+              std::make_unique<Ort::Session>(env, modelPath, session_options));
+        }
+
+        Inbox inbox; // outlives the converter's threads
+        StreamAccounting accounting(streams);
+        std::unique_ptr<AsyncConverter> converter;
+        if (numa)
+        {
+            std::vector<Ort::Session*> perNode;
+            for (auto& session : sessions)
+            {
+                perNode.push_back(session.get());
+            }
+            size_t count       = nodes.size();
+            size_t nodeThreads = (threads + count - 1) / count;
+            size_t nodeStreams = (streams + count - 1) / count;
+            converter          = std::make_unique<AsyncConverter>(
+              nodes, perNode, nodeThreads, nodeStreams, depth, &accounting);
+        }
+        else
+        {
+            converter = std::make_unique<AsyncConverter>(
+              *sessions[0], threads, streams, depth, &accounting);
+        }
+        std::vector<StreamDriver> drivers(streams);
+        for (StreamDriver& driver : drivers)
+        {
+            driver.stream = converter->openStream();
+        }
+
+        std::vector<double> latencies;
+        std::vector<float> block(blockSize);
+        size_t completed = 0;
+        size_t failed    = 0;
+        size_t reordered = 0;
+        size_t peak      = 0;
+        auto start       = Clock::now();
+        while (completed < streams * blocks)
+        {
+            // Top every stream up to its in-flight limit
+            for (size_t s = 0; s < streams; ++s)
+            {
+                StreamDriver& driver = drivers[s];
+                while (driver.submitted < blocks)
+                {
+                    fillBlock(block, driver.submitted);
+                    size_t sequence = driver.submitted;
+                    auto submitted  = Clock::now();
+                    auto done       = [&inbox, s, sequence, submitted](
+                                  std::vector<float>,
+                                  std::exception_ptr error) {
+                        {
+                            std::lock_guard<std::mutex> lock(inbox.mutex);
+                            inbox.items.push_back(
+                              { s, sequence, submitted, error != nullptr });
+                        }
+                        inbox.posted.notify_one();
+                    };
+                    if (!converter->submit(driver.stream, block, done))
+                    {
+                        break;
+                    }
+                    ++driver.submitted;
+                }
+            }
+            peak = std::max(peak, converter->inFlight());
+
+            std::vector<Completed> items;
+            {
+                std::unique_lock<std::mutex> lock(inbox.mutex);
+                inbox.posted.wait(lock, [&] { return !inbox.items.empty(); });
+                items.swap(inbox.items);
+            }
+            auto now = Clock::now();
+            for (const Completed& item : items)
+            {
+                StreamDriver& driver = drivers[item.stream];
+                reordered += item.sequence != driver.expected;
+                driver.expected = item.sequence + 1;
+                failed += item.failed;
+                latencies.push_back(
+                  std::chrono::duration<double, std::milli>(now -
+                                                            item.submitted)
+                    .count());
+            }
+            completed += items.size();
+        }
+        double wallSeconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+        for (StreamDriver& driver : drivers)
+        {
+            converter->closeStream(driver.stream);
+        }
+        size_t shards = converter->shardCount();
+        converter.reset(); // every stream's account is closed
+        std::vector<StreamUsage> heaviest = accounting.top(streams);
+
+        double audioSeconds =
+          static_cast<double>(completed * blockSize) / SAMPLE_RATE;
+        std::cout << streams << " streams, " << threads
+                  << " inference threads, depth " << depth << ", "
+                  << blockSize << "-sample blocks, "
+                  << (numa ? "NUMA-local placement on " +
+                               std::to_string(shards) + " nodes"
+                           : std::string("NUMA-oblivious placement"))
+                  << std::endl;
+        std::cout << "Converted " << completed << " blocks in " << wallSeconds
+                  << " s (" << completed / wallSeconds << " blocks/s, "
+                  << audioSeconds / wallSeconds << "x real time)" << std::endl;
+        std::cout << "Completion latency: p50 " << percentile(latencies, 0.5)
+                  << " ms, p99 " << percentile(latencies, 0.99) << " ms"
+                  << std::endl;
+        if (!heaviest.empty())
+        {
+            std::cout << "CPU per stream: " << heaviest.back().cpuSeconds
+                      << " s to " << heaviest.front().cpuSeconds << " s"
+                      << std::endl;
+        }
+        std::cout << "Peak in flight: " << peak << ", failed: " << failed
+                  << ", out of order: " << reordered << std::endl;
+        return failed == 0 && reordered == 0 ? 0 : 1;
+    }
+    catch (const Ort::Exception& exception)
+    {
+        std::cerr << "ONNX Runtime error: " << exception.what() << std::endl;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << "An error occurred: " << exception.what() << std::endl;
+    }
+    return 1;
+}
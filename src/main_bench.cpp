@@ -0,0 +1,339 @@
+#include "llvc.h"
+#include "CircularBuffer.h"
+#include "HotSwap.h"
+#include "OnnxGraph.h"
+#include "SpscQueue.h"
+#include "StreamingConverter.h"
+#include "myk_tiny.h"
+#include <benchmark/benchmark.h>
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the hot paths. The model cases run a synthetic model
+// with the streaming model's inputs and outputs (see syntheticOnnxModel),
+// so they need no weights and measure the per-block overhead around Run;
+// pass --model <model.onnx> to time the real model instead. Every other
+// flag goes to Google Benchmark (--benchmark_filter=..., etc.).
+
+const int WAV_CHUNK = 44100; // frames per tinywav call, as in myk_tiny
+
+// Set up in main before the benchmarks run
+static Ort::Session* benchSession = nullptr;
+
+static std::vector<float>
+testSignal(size_t samples)
+{
+    std::vector<float> signal(samples);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        double t  = static_cast<double>(i) / SAMPLE_RATE;
+        signal[i] = static_cast<float>(0.3 * std::sin(2 * M_PI * 140.0 * t));
+    }
+    return signal;
+}
+
+static std::string
+scratchWav(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// One streaming block through the session, states fed back as in
+// production; the argument is the block size in samples
+static void
+BM_ProcessBlock(benchmark::State& state)
+{
+    size_t samples           = static_cast<size_t>(state.range(0));
+    std::vector<float> block = testSignal(samples);
+    StreamState stream       = createStreamState();
+    for (auto _ : state)
+    {
+        processBlock(*benchSession, block, stream);
+        benchmark::DoNotOptimize(block.data());
+    }
+    state.SetItemsProcessed(state.iterations() * samples);
+    state.counters["x_realtime"] = benchmark::Counter(
+      static_cast<double>(samples) / SAMPLE_RATE,
+      benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ProcessBlock)
+  ->Arg(256)
+  ->Arg(512)
+  ->Arg(1024)
+  ->Arg(2048)
+  ->Arg(4096)
+  ->Unit(benchmark::kMicrosecond);
+
+// The same through the compile-time specialised converters, whose shapes
+// and buffers are fixed per block size
+static void
+BM_BlockConverter(benchmark::State& state)
+{
+    size_t samples           = static_cast<size_t>(state.range(0));
+    std::vector<float> block = testSignal(samples);
+    BlockConverter converter(*benchSession, samples);
+    for (auto _ : state)
+    {
+        converter.process(block.data(), block.data());
+        benchmark::DoNotOptimize(block.data());
+    }
+    state.SetItemsProcessed(state.iterations() * samples);
+    state.counters["x_realtime"] = benchmark::Counter(
+      static_cast<double>(samples) / SAMPLE_RATE,
+      benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BlockConverter)
+  ->Arg(256)
+  ->Arg(512)
+  ->Arg(1024)
+  ->Unit(benchmark::kMicrosecond);
+
+// Hot-swap crossfade over one block, with a runtime and a constant length
+static void
+BM_Crossfade(benchmark::State& state)
+{
+    std::vector<float> from = testSignal(1024);
+    std::vector<float> to   = testSignal(1024);
+    std::vector<float> out(1024);
+    for (auto _ : state)
+    {
+        crossfade(from.data(), to.data(), out.data(), out.size(), 0.0f, 1.0f);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_Crossfade);
+
+static void
+BM_CrossfadeFixed(benchmark::State& state)
+{
+    std::vector<float> from = testSignal(1024);
+    std::vector<float> to   = testSignal(1024);
+    std::vector<float> out(1024);
+    for (auto _ : state)
+    {
+        StreamingConverter<1024>::crossfade(
+          from.data(), to.data(), out.data(), 0.0f, 1.0f);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_CrossfadeFixed);
+
+// Zeroed state tensors for a new stream
+static void
+BM_CreateStreamState(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        StreamState stream = createStreamState();
+        benchmark::DoNotOptimize(stream.enc_buf_tensor.get());
+    }
+}
+BENCHMARK(BM_CreateStreamState)->Unit(benchmark::kMicrosecond);
+
+// The per-block tensor setup processBlock does before Run
+static void
+BM_WrapInputTensor(benchmark::State& state)
+{
+    std::vector<float> block(static_cast<size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        Ort::MemoryInfo memoryInfo =
+          Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        const int64_t shape[] = { 1, 1, static_cast<int64_t>(block.size()) };
+        Ort::Value tensor     = Ort::Value::CreateTensor<float>(
+          memoryInfo, block.data(), block.size(), shape, 3);
+        benchmark::DoNotOptimize(tensor);
+    }
+}
+BENCHMARK(BM_WrapInputTensor)->Arg(1024);
+
+// Ring hand-off of one block: CircularBuffer copies it in and out,
+// SpscQueue moves it. Both run on one thread, so this is the cost of the
+// copies and index updates without cross-core traffic.
+static void
+BM_CircularBufferPushPop(benchmark::State& state)
+{
+    size_t samples = static_cast<size_t>(state.range(0));
+    CircularBuffer ring(64, samples);
+    std::vector<float> in = testSignal(samples);
+    std::vector<float> out(samples);
+    for (auto _ : state)
+    {
+        ring.push(in);
+        ring.pop(out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * samples * sizeof(float));
+}
+BENCHMARK(BM_CircularBufferPushPop)->Arg(1024)->Arg(4096);
+
+static void
+BM_SpscQueuePushPop(benchmark::State& state)
+{
+    size_t samples = static_cast<size_t>(state.range(0));
+    SpscQueue<std::vector<float>> ring(64);
+    std::vector<float> block = testSignal(samples);
+    for (auto _ : state)
+    {
+        ring.tryPush(std::move(block));
+        ring.tryPop(block);
+        benchmark::DoNotOptimize(block.data());
+    }
+    state.SetBytesProcessed(state.iterations() * samples * sizeof(float));
+}
+BENCHMARK(BM_SpscQueuePushPop)->Arg(1024)->Arg(4096);
+
+// tinywav's float <-> int16 conversion and file I/O; the argument is
+// seconds of mono 16 kHz audio
+static void
+BM_TinywavWrite(benchmark::State& state)
+{
+    std::vector<float> audio = testSignal(state.range(0) * SAMPLE_RATE);
+    std::string path         = scratchWav("llvc_bench_write.wav");
+    for (auto _ : state)
+    {
+        TinyWav wav;
+        tinywav_open_write(
+          &wav, 1, SAMPLE_RATE, TW_INT16, TW_INLINE, path.c_str());
+        for (size_t offset = 0; offset < audio.size(); offset += WAV_CHUNK)
+        {
+            int frames = static_cast<int>(
+              std::min<size_t>(WAV_CHUNK, audio.size() - offset));
+            tinywav_write_f(&wav, audio.data() + offset, frames);
+        }
+        tinywav_close_write(&wav);
+    }
+    state.SetBytesProcessed(state.iterations() * audio.size() *
+                            sizeof(int16_t));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_TinywavWrite)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+static void
+BM_TinywavRead(benchmark::State& state)
+{
+    std::vector<float> audio = testSignal(state.range(0) * SAMPLE_RATE);
+    std::string path         = scratchWav("llvc_bench_read.wav");
+    myk_tiny::saveWav(audio, 1, SAMPLE_RATE, path);
+    std::vector<float> chunk(WAV_CHUNK);
+    for (auto _ : state)
+    {
+        TinyWav wav;
+        tinywav_open_read(&wav, path.c_str(), TW_INLINE);
+        while (tinywav_read_f(&wav, chunk.data(), WAV_CHUNK) > 0)
+        {
+            benchmark::DoNotOptimize(chunk.data());
+        }
+        tinywav_close_read(&wav);
+    }
+    state.SetBytesProcessed(state.iterations() * audio.size() *
+                            sizeof(int16_t));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_TinywavRead)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+// The whole-file helpers, including their buffer allocations
+static void
+BM_MykSaveWav(benchmark::State& state)
+{
+    std::vector<float> audio = testSignal(state.range(0) * SAMPLE_RATE);
+    std::string path         = scratchWav("llvc_bench_save.wav");
+    for (auto _ : state)
+    {
+        myk_tiny::saveWav(audio, 1, SAMPLE_RATE, path);
+    }
+    state.SetBytesProcessed(state.iterations() * audio.size() *
+                            sizeof(int16_t));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_MykSaveWav)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+static void
+BM_MykLoadWav(benchmark::State& state)
+{
+    std::vector<float> audio = testSignal(state.range(0) * SAMPLE_RATE);
+    std::string path         = scratchWav("llvc_bench_load.wav");
+    myk_tiny::saveWav(audio, 1, SAMPLE_RATE, path);
+    for (auto _ : state)
+    {
+        std::vector<float> loaded = myk_tiny::loadWav(path);
+        benchmark::DoNotOptimize(loaded.data());
+    }
+    state.SetBytesProcessed(state.iterations() * audio.size() *
+                            sizeof(int16_t));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_MykLoadWav)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+int
+main(int argc, char* argv[])
+{
+    // Take --model out before Google Benchmark sees the arguments
+    const char* modelPath = nullptr;
+    int kept              = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            modelPath = argv[++i];
+            continue;
+        }
+        argv[kept++] = argv[i];
+    }
+    argc = kept;
+
+    try
+    {
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_bench");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+
+        std::unique_ptr<Ort::Session> session;
+        if (modelPath)
+        {
+            session = std::make_unique<Ort::Session>(
+              env, modelPath, session_options);
+        }
+        else
+        {
+            std::string model = syntheticOnnxModel(
+              std::vector<std::string>(std::begin(INPUT_NAMES),
+                                       std::end(INPUT_NAMES)),
+              std::vector<std::string>(std::begin(OUTPUT_NAMES),
+                                       std::end(OUTPUT_NAMES)));
+            session = std::make_unique<Ort::Session>(
+              env, model.data(), model.size(), session_options);
+        }
+        benchSession = session.get();
+        benchmark::AddCustomContext("model",
+                                    modelPath ? modelPath : "synthetic");
+
+        benchmark::Initialize(&argc, argv);
+        if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        {
+            return 1;
+        }
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+        return 0;
+    }
+    catch (const Ort::Exception& exception)
+    {
+        std::cerr << "ONNX Runtime error: " << exception.what() << std::endl;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << "An error occurred: " << exception.what() << std::endl;
+    }
+    return 1;
+}
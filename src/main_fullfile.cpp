@@ -1,10 +1,24 @@
 #include <onnxruntime_cxx_api.h>
 #include "../lib/tinywav/myk_tiny.h"
+#include "ChannelLayout.h"
+#include "llvc.h"
+#include "StreamAccounting.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
 
+// Converts a whole file in one pass. Each channel is an independent stream
+// with its own state, and all of them go through one batched Run when the
+// model's batch dimension is symbolic (one Run per channel otherwise).
+// --downmix averages the channels to mono first instead. The CPU time is
+// charged to the channels (StreamAccounting.h) and reported per channel.
+
 int
-main()
+main(int argc, char* argv[])
 {
     const char* inputPath  = "/Users/thomaspower/Developer/Koala/LLVC_Test/"
                              "test_audio/174-50561-0000.wav";
@@ -12,21 +26,50 @@ main()
                              "output_audio/outputsample.wav";
     const char* modelPath  = "/Users/thomaspower/Developer/Koala/LLVC_Test/"
                              "onnx_models/llvc_model.onnx";
+    bool downmix           = false;
+
+    const char** positional[] = { &inputPath, &outputPath, &modelPath };
+    size_t given              = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--downmix") == 0)
+        {
+            downmix = true;
+        }
+        else if (given < 3)
+        {
+            *positional[given++] = argv[i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [input.wav [output.wav [model.onnx]]] [--downmix]"
+                      << std::endl;
+            return 1;
+        }
+    }
 
     try
     {
         // Load audio
-        int inputSampleRate, inputChannels;
-        std::vector<float> audio = myk_tiny::loadWav(inputPath);
-        std::vector<float> outSignal(audio.size(), 0.0f);
+        int inputSampleRate = 0, inputChannels = 0;
+        std::vector<float> audio =
+          myk_tiny::loadWav(inputPath, inputSampleRate, inputChannels);
         if (audio.empty())
         {
             std::cerr << "Failed to load audio or audio is empty." << std::endl;
             return 1;
         }
-        std::cout << "Loaded audio. Sample count: " << audio.size()
+        size_t channels = static_cast<size_t>(inputChannels);
+        size_t frames   = audio.size() / channels;
+        std::cout << "Loaded audio. Sample count: " << frames
                   << ", Sample rate: " << inputSampleRate
                   << ", Channels: " << inputChannels << std::endl;
+        if (inputSampleRate != SAMPLE_RATE)
+        {
+            std::cerr << "Warning: the model expects " << SAMPLE_RATE
+                      << " Hz audio." << std::endl;
+        }
 
         // Set up ONNX Runtime
         Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_test");
@@ -37,90 +80,81 @@ main()
 
         Ort::Session session(env, modelPath, session_options);
 
-        // Prepare input tensors
-        Ort::MemoryInfo memory_info =
-          Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-        std::vector<int64_t> input_shape = {
-            1, 1, static_cast<int64_t>(audio.size())
-        };
-        Ort::Value input_tensor =
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          audio.data(),
-                                          audio.size(),
-                                          input_shape.data(),
-                                          input_shape.size());
-
-        std::vector<float> enc_buf(1 * 512 * 510, 0.0f);
-        std::vector<int64_t> enc_buf_shape = { 1, 512, 510 };
-        Ort::Value enc_buf_tensor =
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          enc_buf.data(),
-                                          enc_buf.size(),
-                                          enc_buf_shape.data(),
-                                          enc_buf_shape.size());
-
-        std::vector<float> dec_buf(1 * 2 * 13 * 256, 0.0f);
-        std::vector<int64_t> dec_buf_shape = { 1, 2, 13, 256 };
-        Ort::Value dec_buf_tensor =
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          dec_buf.data(),
-                                          dec_buf.size(),
-                                          dec_buf_shape.data(),
-                                          dec_buf_shape.size());
-
-        std::vector<float> out_buf(1 * 512 * 4, 0.0f);
-        std::vector<int64_t> out_buf_shape = { 1, 512, 4 };
-        Ort::Value out_buf_tensor =
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          out_buf.data(),
-                                          out_buf.size(),
-                                          out_buf_shape.data(),
-                                          out_buf_shape.size());
-
-        std::vector<float> convnet_pre_ctx(1 * 1 * 24, 0.0f);
-        std::vector<int64_t> convnet_pre_ctx_shape = { 1, 1, 24 };
-        Ort::Value convnet_pre_ctx_tensor =
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          convnet_pre_ctx.data(),
-                                          convnet_pre_ctx.size(),
-                                          convnet_pre_ctx_shape.data(),
-                                          convnet_pre_ctx_shape.size());
-
-        // Prepare input and output names
-        const char* input_names[] = {
-            "input", "enc_buf", "dec_buf", "out_buf", "convnet_pre_ctx"
-        };
-        const char* output_names[] = { "output",
-                                       "new_enc_buf",
-                                       "new_dec_buf",
-                                       "new_out_buf",
-                                       "new_convnet_pre_ctx" };
-
-        // Run inference
-        std::vector<Ort::Value> ort_inputs;
-        ort_inputs.push_back(std::move(input_tensor));
-        ort_inputs.push_back(std::move(enc_buf_tensor));
-        ort_inputs.push_back(std::move(dec_buf_tensor));
-        ort_inputs.push_back(std::move(out_buf_tensor));
-        ort_inputs.push_back(std::move(convnet_pre_ctx_tensor));
-
-        auto output_tensors = session.Run(Ort::RunOptions{ nullptr },
-                                          input_names,
-                                          ort_inputs.data(),
-                                          ort_inputs.size(),
-                                          output_names,
-                                          5);
+        // One stream per channel, laid out channel after channel
+        std::vector<float> streams(frames * channels);
+        if (downmix && channels > 1)
+        {
+            streams.resize(frames);
+            downmixToMono(audio.data(), frames, channels, streams.data());
+            std::cout << "Downmixed " << channels << " channels to mono ("
+                      << downmixIsa() << ")." << std::endl;
+            channels = 1;
+        }
+        else
+        {
+            deinterleave(audio.data(), frames, channels, streams.data());
+        }
 
-        // Process output
-        float* output_data = output_tensors[0].GetTensorMutableData<float>();
-        std::vector<int64_t> output_shape =
-          output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
-        std::vector<float> output_audio(
-          output_data, output_data + output_shape[1] * output_shape[2]);
+        // The model may return fewer samples than it was given; only
+        // those are written
+        size_t produced = frames;
+        StreamAccounting accounting(0);
+        std::vector<std::pair<StreamAccounting::Account*, size_t>> accounts;
+        for (size_t c = 0; c < channels; ++c)
+        {
+            accounts.emplace_back(
+              accounting.open(c, "channel " + std::to_string(c)), frames);
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (channels == 1 || acceptsBatch(session))
+        {
+            StreamState state = createStreamState(channels);
+            RunTimer timer;
+            produced = processBatch(session,
+                                    streams.data(),
+                                    streams.data(),
+                                    channels,
+                                    frames,
+                                    state);
+            accounting.recordBatch(accounts, timer.elapsed());
+        }
+        else
+        {
+            std::cout << "The model has a fixed batch size; converting the "
+                      << channels << " channels one at a time." << std::endl;
+            for (size_t c = 0; c < channels; ++c)
+            {
+                StreamState state = createStreamState();
+                float* channel    = streams.data() + c * frames;
+                RunTimer timer;
+                produced = std::min(
+                  produced,
+                  processBlock(session, channel, channel, frames, state));
+                accounting.record(accounts[c].first, frames, timer.elapsed());
+            }
+        }
+        std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+        std::cout << "Converted " << channels << " channel(s) in "
+                  << elapsed.count() << " seconds." << std::endl;
+        for (const auto& account : accounts)
+        {
+            StreamUsage usage = accounting.usage(account.first);
+            std::cout << "  " << usage.label << ": " << usage.cpuSeconds
+                      << " CPU seconds" << std::endl;
+        }
 
-        // Save output audio
-        myk_tiny::saveWav(output_audio, 1, 16000, outputPath);
+        // Save output audio, packing the streams to `produced` first
+        for (size_t c = 1; c < channels && produced < frames; ++c)
+        {
+            const float* channel = streams.data() + c * frames;
+            std::copy(
+              channel, channel + produced, streams.data() + c * produced);
+        }
+        std::vector<float> output_audio(produced * channels);
+        interleave(streams.data(), produced, channels, output_audio.data());
+        myk_tiny::saveWav(
+          output_audio, static_cast<int>(channels), SAMPLE_RATE, outputPath);
         std::cout << "Saved processed audio to " << outputPath << std::endl;
     }
     catch (const Ort::Exception& e)
@@ -135,4 +169,4 @@ main()
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,264 @@
+#include "llvc_net.h"
+#include "llvc_protocol.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Load generator for llvc_server: opens N concurrent streams, sends blocks
+// of synthetic speech-band audio and reports round-trip latency percentiles.
+// Closed loop by default (next block after the reply); --realtime paces each
+// stream at the audio rate like a live caller.
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions
+{
+    std::string endpoint;
+    size_t streams   = 16;
+    size_t blocks    = 200;
+    size_t blockSize = 1024;
+    bool realtime    = false;
+    std::vector<std::string> voices; // assigned to streams round-robin
+};
+
+struct StreamResult
+{
+    std::vector<double> latenciesMs;
+    bool failed = false;
+    std::string error;
+};
+
+static void
+fillBlock(std::vector<float>& block, size_t stream, size_t index)
+{
+    // A gliding tone per stream so inputs are not all identical
+    const double twoPi = 6.283185307179586;
+    double f0          = 120.0 + 15.0 * static_cast<double>(stream % 16);
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        double t = static_cast<double>(index * block.size() + i) / 16000.0;
+        block[i] = static_cast<float>(0.3 * std::sin(twoPi * f0 * t) +
+                                      0.1 * std::sin(twoPi * 3.1 * f0 * t));
+    }
+}
+
+static void
+runStream(const LoadOptions& options,
+          size_t streamIndex,
+          const std::atomic<bool>& go,
+          StreamResult& result)
+{
+    try
+    {
+        int fd = connectTo(options.endpoint);
+
+        std::string voice =
+          options.voices.empty()
+            ? std::string()
+            : options.voices[streamIndex % options.voices.size()];
+        FrameHeader header{ FRAME_HELLO,
+                            static_cast<uint32_t>(sizeof(HelloPayload) +
+                                                  voice.size()) };
+        HelloPayload hello{ LLVC_PROTOCOL_VERSION, 16000 };
+        writeFully(fd, &header, sizeof(header));
+        writeFully(fd, &hello, sizeof(hello));
+        writeFully(fd, voice.data(), voice.size());
+
+        std::vector<float> block(options.blockSize);
+        std::vector<float> reply(MAX_FRAME_SAMPLES);
+        result.latenciesMs.reserve(options.blocks);
+
+        while (!go.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+
+        const auto blockPeriod = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(options.blockSize / 16000.0));
+        auto nextSend = Clock::now();
+
+        for (size_t b = 0; b < options.blocks; ++b)
+        {
+            fillBlock(block, streamIndex, b);
+            if (options.realtime)
+            {
+                std::this_thread::sleep_until(nextSend);
+                nextSend += blockPeriod;
+            }
+
+            auto sent = Clock::now();
+            FrameHeader audio{ FRAME_AUDIO,
+                               static_cast<uint32_t>(block.size() *
+                                                     sizeof(float)) };
+            if (!writeFully(fd, &audio, sizeof(audio)) ||
+                !writeFully(fd, block.data(), audio.length))
+            {
+                throw std::runtime_error("server closed the connection");
+            }
+
+            FrameHeader response;
+            if (!readFully(fd, &response, sizeof(response)) ||
+                response.length > reply.size() * sizeof(float) ||
+                !readFully(fd, reply.data(), response.length))
+            {
+                throw std::runtime_error("server closed the connection");
+            }
+            if (response.type == FRAME_ERROR)
+            {
+                throw std::runtime_error(
+                  "server error: " +
+                  std::string(reinterpret_cast<const char*>(reply.data()),
+                              response.length));
+            }
+
+            result.latenciesMs.push_back(
+              std::chrono::duration<double, std::milli>(Clock::now() - sent)
+                .count());
+        }
+
+        FrameHeader bye{ FRAME_BYE, 0 };
+        writeFully(fd, &bye, sizeof(bye));
+        close(fd);
+    }
+    catch (const std::exception& e)
+    {
+        result.failed = true;
+        result.error  = e.what();
+    }
+}
+
+static double
+percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <tcp:HOST:PORT|unix:PATH> [--streams N] [--blocks M]"
+                     " [--block SAMPLES] [--realtime] [--voices A,B,...]"
+                  << std::endl;
+        return 1;
+    }
+
+    LoadOptions options;
+    options.endpoint = argv[1];
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--streams" && i + 1 < argc)
+        {
+            options.streams = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--blocks" && i + 1 < argc)
+        {
+            options.blocks = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            options.blockSize = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--realtime")
+        {
+            options.realtime = true;
+        }
+        else if (arg == "--voices" && i + 1 < argc)
+        {
+            std::stringstream list(argv[++i]);
+            std::string voice;
+            while (std::getline(list, voice, ','))
+            {
+                options.voices.push_back(voice);
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (options.blockSize == 0 || options.blockSize > MAX_FRAME_SAMPLES)
+    {
+        std::cerr << "Block size must be between 1 and " << MAX_FRAME_SAMPLES
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<StreamResult> results(options.streams);
+    std::vector<std::thread> threads;
+    std::atomic<bool> go(false);
+    for (size_t s = 0; s < options.streams; ++s)
+    {
+        threads.emplace_back(
+          [&, s] { runStream(options, s, go, results[s]); });
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    double wallSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    size_t failures = 0;
+    for (const StreamResult& result : results)
+    {
+        latencies.insert(latencies.end(),
+                         result.latenciesMs.begin(),
+                         result.latenciesMs.end());
+        if (result.failed)
+        {
+            if (failures == 0)
+            {
+                std::cerr << "Stream failed: " << result.error << std::endl;
+            }
+            ++failures;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double audioSeconds =
+      static_cast<double>(latencies.size() * options.blockSize) / 16000.0;
+    double blockMs = 1000.0 * options.blockSize / 16000.0;
+
+    std::cout << options.streams << " streams, " << latencies.size()
+              << " blocks of " << options.blockSize << " samples ("
+              << blockMs << " ms) in " << wallSeconds << " s"
+              << (options.realtime ? " [realtime pacing]" : " [closed loop]")
+              << std::endl;
+    std::cout << "Round-trip latency ms: p50 " << percentile(latencies, 0.50)
+              << ", p90 " << percentile(latencies, 0.90) << ", p99 "
+              << percentile(latencies, 0.99) << ", max "
+              << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    std::cout << "Throughput: " << latencies.size() / wallSeconds
+              << " blocks/s, " << audioSeconds / wallSeconds
+              << "x real time aggregate" << std::endl;
+    if (failures > 0)
+    {
+        std::cout << failures << " streams failed." << std::endl;
+        return 1;
+    }
+    return 0;
+}
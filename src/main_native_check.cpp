@@ -0,0 +1,247 @@
+#include "llvc.h"
+#include "NativeEngine.h"
+#include "NativeKernels.h"
+#include "StreamingConverter.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Runs the same synthetic audio through ONNX Runtime and the native engine,
+// block by block with each engine carrying its own state, and reports the
+// largest output and state differences and the time per block. Exits
+// nonzero when a difference exceeds the tolerance, so a model can be
+// checked before the native engine is trusted with it. Block sizes that
+// BlockConverter supports also run through one, and its output is held to
+// the same tolerance against processBlock's.
+
+using Clock = std::chrono::steady_clock;
+
+const std::vector<size_t> DEFAULT_BLOCK_SIZES = { 128, 256, 1024 };
+
+struct CheckResult
+{
+    float outputError    = 0.0f;
+    float stateError     = 0.0f;
+    float converterError = -1.0f; // -1: no BlockConverter for the size
+    double ortUs         = 0.0;
+    double nativeUs      = 0.0;
+};
+
+static void
+fillBlock(std::vector<float>& block, size_t index)
+{
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        double t = static_cast<double>(index * block.size() + i) / SAMPLE_RATE;
+        block[i] = static_cast<float>(0.3 * std::sin(2 * M_PI * 140.0 * t) +
+                                      0.1 * std::sin(2 * M_PI * 430.0 * t));
+    }
+}
+
+static float
+maxAbsDiff(const float* a, const float* b, size_t count)
+{
+    float diff = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        diff = std::max(diff, std::fabs(a[i] - b[i]));
+    }
+    return diff;
+}
+
+static float
+stateError(const StreamState& ort, const NativeState& native)
+{
+    const Ort::Value* tensors[] = { ort.enc_buf_tensor.get(),
+                                    ort.dec_buf_tensor.get(),
+                                    ort.out_buf_tensor.get(),
+                                    ort.convnet_pre_ctx_tensor.get() };
+    float diff = 0.0f;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        size_t count =
+          tensors[k]->GetTensorTypeAndShapeInfo().GetElementCount();
+        if (count != native.buffers[k].size())
+        {
+            return INFINITY;
+        }
+        diff = std::max(diff,
+                        maxAbsDiff(tensors[k]->GetTensorData<float>(),
+                                   native.buffers[k].data(),
+                                   count));
+    }
+    return diff;
+}
+
+static CheckResult
+check(Ort::Session& session,
+      NativeEngine& engine,
+      size_t blockSize,
+      int blocks)
+{
+    CheckResult result;
+    StreamState ortState    = createStreamState();
+    NativeState nativeState = engine.createState();
+    std::vector<float> input(blockSize);
+    std::vector<float> ortOut(blockSize);
+    std::vector<float> nativeOut(blockSize);
+    std::vector<float> converterOut(blockSize);
+    std::unique_ptr<BlockConverter> converter;
+    if (BlockConverter::supports(blockSize))
+    {
+        converter = std::make_unique<BlockConverter>(session, blockSize);
+        result.converterError = 0.0f;
+    }
+
+    // Block 0 plans the native engine and warms ORT; neither is timed
+    for (int b = 0; b <= blocks; ++b)
+    {
+        fillBlock(input, b);
+        auto start = Clock::now();
+        processBlock(session, input.data(), ortOut.data(), blockSize, ortState);
+        auto middle = Clock::now();
+        engine.process(input.data(), nativeOut.data(), blockSize, nativeState);
+        auto end = Clock::now();
+        if (b > 0)
+        {
+            result.ortUs +=
+              std::chrono::duration<double, std::micro>(middle - start).count();
+            result.nativeUs +=
+              std::chrono::duration<double, std::micro>(end - middle).count();
+        }
+        result.outputError =
+          std::max(result.outputError,
+                   maxAbsDiff(ortOut.data(), nativeOut.data(), blockSize));
+        if (converter)
+        {
+            converter->process(input.data(), converterOut.data());
+            result.converterError = std::max(
+              result.converterError,
+              maxAbsDiff(ortOut.data(), converterOut.data(), blockSize));
+        }
+    }
+    result.stateError = stateError(ortState, nativeState);
+    result.ortUs /= blocks;
+    result.nativeUs /= blocks;
+    return result;
+}
+
+static bool
+parseSizes(const std::string& list, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        long size = std::atol(item.c_str());
+        if (size <= 0)
+        {
+            return false;
+        }
+        sizes.push_back(static_cast<size_t>(size));
+    }
+    return !sizes.empty();
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* modelPath     = nullptr;
+    int blocks                = 100;
+    float tolerance           = 1e-4f;
+    std::vector<size_t> sizes = DEFAULT_BLOCK_SIZES;
+    bool usage                = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--blocks" && i + 1 < argc)
+        {
+            blocks = std::atoi(argv[++i]);
+            usage  = blocks <= 0;
+        }
+        else if (arg == "--block-sizes" && i + 1 < argc)
+        {
+            usage = !parseSizes(argv[++i], sizes);
+        }
+        else if (arg == "--tolerance" && i + 1 < argc)
+        {
+            tolerance = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (!modelPath && arg[0] != '-')
+        {
+            modelPath = argv[i];
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+    if (usage || !modelPath)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> [--blocks N] [--block-sizes A,B,...]"
+                     " [--tolerance T]"
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_native_check");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        Ort::Session session(env, modelPath, session_options);
+        NativeEngine engine(modelPath);
+
+        std::cout << "Native engine: " << engine.nodeCount() << " nodes, "
+                  << kernelIsa() << " kernels, " << blocks
+                  << " blocks per size, tolerance " << tolerance << std::endl;
+
+        bool passed = true;
+        for (size_t blockSize : sizes)
+        {
+            CheckResult result = check(session, engine, blockSize, blocks);
+            double blockUs     = 1e6 * blockSize / SAMPLE_RATE;
+            bool ok            = result.outputError <= tolerance &&
+                      result.stateError <= tolerance &&
+                      result.converterError <= tolerance;
+            passed             = passed && ok;
+            std::cout << "  block " << blockSize << ": output error "
+                      << result.outputError << ", state error "
+                      << result.stateError;
+            if (result.converterError >= 0.0f)
+            {
+                std::cout << ", converter error " << result.converterError;
+            }
+            std::cout << (ok ? "" : "  FAIL") << std::endl;
+            std::cout << "    ORT " << result.ortUs << " us (RTF "
+                      << result.ortUs / blockUs << "), native "
+                      << result.nativeUs << " us (RTF "
+                      << result.nativeUs / blockUs << "), "
+                      << result.ortUs / result.nativeUs << "x; "
+                      << engine.foldedNodeCount() << " nodes folded"
+                      << std::endl;
+        }
+        std::cout << (passed ? "PASS" : "FAIL") << std::endl;
+        return passed ? 0 : 1;
+    }
+    catch (const Ort::Exception& exception)
+    {
+        std::cerr << "ONNX Runtime error: " << exception.what() << std::endl;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << "An error occurred: " << exception.what() << std::endl;
+    }
+    return 1;
+}
@@ -1,3 +1,8 @@
+#include "llvc.h"
+#include "llvc_startup.h"
+#include "RtLog.h"
+#include "Metrics.h"
+#include "CircularBuffer.h"
 #include <portaudio.h>
 #include <onnxruntime_cxx_api.h>
 #include <iostream>
@@ -6,121 +11,62 @@
 #include <chrono>
 #include <thread>
 #include <atomic>
-
-// Takes in a ref to the session, and does inference on the input block
-void
-processBlock(Ort::Session& session,
-             std::vector<float>& block,
-             std::unique_ptr<Ort::Value>& enc_buf_tensor,
-             std::unique_ptr<Ort::Value>& dec_buf_tensor,
-             std::unique_ptr<Ort::Value>& out_buf_tensor,
-             std::unique_ptr<Ort::Value>& convnet_pre_ctx_tensor)
-{
-    // Prepare input tensors
-    Ort::MemoryInfo memory_info =
-      Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-    std::vector<int64_t> input_shape = { 1,
-                                         1,
-                                         static_cast<int64_t>(block.size()) };
-    Ort::Value input_tensor =
-      Ort::Value::CreateTensor<float>(memory_info,
-                                      block.data(),
-                                      block.size(),
-                                      input_shape.data(),
-                                      input_shape.size());
-
-    // Prepare input and output names
-    const char* input_names[] = {
-        "input", "enc_buf", "dec_buf", "out_buf", "convnet_pre_ctx"
-    };
-    const char* output_names[] = { "output",
-                                   "new_enc_buf",
-                                   "new_dec_buf",
-                                   "new_out_buf",
-                                   "new_convnet_pre_ctx" };
-
-    // Run inference
-    std::vector<Ort::Value> ort_inputs;
-    ort_inputs.push_back(std::move(input_tensor));
-    ort_inputs.push_back(std::move(*enc_buf_tensor));
-    ort_inputs.push_back(std::move(*dec_buf_tensor));
-    ort_inputs.push_back(std::move(*out_buf_tensor));
-    ort_inputs.push_back(std::move(*convnet_pre_ctx_tensor));
-
-    auto output_tensors = session.Run(Ort::RunOptions{ nullptr },
-                                      input_names,
-                                      ort_inputs.data(),
-                                      ort_inputs.size(),
-                                      output_names,
-                                      5);
-
-    // Process output writing to the block
-    float* output_data = output_tensors[0].GetTensorMutableData<float>();
-    std::vector<int64_t> output_shape =
-      output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
-    std::vector<float> output_audio(
-      output_data, output_data + output_shape[1] * output_shape[2]);
-
-    // copy output_audio to block
-    std::copy(output_audio.begin(), output_audio.end(), block.begin());
-
-    // Update state tensors with new values
-    enc_buf_tensor = std::make_unique<Ort::Value>(std::move(output_tensors[1]));
-    dec_buf_tensor = std::make_unique<Ort::Value>(std::move(output_tensors[2]));
-    out_buf_tensor = std::make_unique<Ort::Value>(std::move(output_tensors[3]));
-    convnet_pre_ctx_tensor =
-      std::make_unique<Ort::Value>(std::move(output_tensors[4]));
-}
+#include <algorithm>
+#include <cstdlib>
+#include <string>
 
 const int BLOCK_SIZE  = 1024;
 const int BUFFER_SIZE = 1024; // Number of blocks in the ring buffer
+const int LOG_RECORDS = 256;  // diagnostics queued before records drop
+const double BLOCK_MS = 1000.0 * BLOCK_SIZE / SAMPLE_RATE;
 
-// Simple lock-free circular buffer
-class CircularBuffer
-{
-  public:
-    CircularBuffer()
-      : writeIndex(0)
-      , readIndex(0)
-      , size(0)
-    {
-        buffer.resize(BUFFER_SIZE);
-        for (auto& block : buffer)
-        {
-            block.resize(BLOCK_SIZE);
-        }
-    }
+// Default queueing latency bound: once more than the maximum is queued
+// between microphone and speaker, the oldest blocks are dropped down to
+// the target
+const double DEFAULT_TARGET_LATENCY_MS = 250.0;
+const double DEFAULT_MAX_LATENCY_MS    = 500.0;
 
-    bool push(const std::vector<float>& data)
-    {
-        if (size.load(std::memory_order_acquire) == BUFFER_SIZE)
-        {
-            return false; // Buffer is full
-        }
-        buffer[writeIndex] = data;
-        writeIndex         = (writeIndex + 1) % BUFFER_SIZE;
-        size.fetch_add(1, std::memory_order_release);
-        return true;
-    }
+// Runs of the inference thread; written by it, read after it is joined
+struct InferenceStats
+{
+    size_t runs            = 0;
+    size_t blocks          = 0;
+    size_t coalescedRuns   = 0; // runs covering more than one block
+    size_t coalescedBlocks = 0;
+    size_t largestRun      = 0; // in blocks
+};
 
-    bool pop(std::vector<float>& data)
+// Exported counters (see Metrics.h); updating one is a relaxed atomic add,
+// so the audio callback may do it
+struct RealtimeMetrics
+{
+    explicit RealtimeMetrics(MetricsRegistry& registry)
+      : inputOverflows(registry.counter(
+          "llvc_xruns_total{kind=\"input_ring_overflow\"}",
+          "Audio discontinuities by cause"))
+      , outputOverflows(registry.counter(
+          "llvc_xruns_total{kind=\"output_ring_overflow\"}", ""))
+      , outputStarved(registry.counter(
+          "llvc_xruns_total{kind=\"output_starved\"}", ""))
+      , deviceInputOverflows(registry.counter(
+          "llvc_xruns_total{kind=\"device_input_overflow\"}", ""))
+      , deviceOutputUnderflows(registry.counter(
+          "llvc_xruns_total{kind=\"device_output_underflow\"}", ""))
+      , blocks(registry.counter("llvc_blocks_total", "Blocks converted"))
+      , blockLatency(registry.histogram(
+          "llvc_block_latency_ms",
+          "Time of one inference run, which may cover coalesced blocks",
+          LATENCY_BUCKETS_MS))
     {
-        if (size.load(std::memory_order_acquire) == 0)
-        {
-            return false; // Buffer is empty
-        }
-        data      = buffer[readIndex];
-        readIndex = (readIndex + 1) % BUFFER_SIZE;
-        size.fetch_sub(1, std::memory_order_release);
-        return true;
     }
 
-  private:
-    std::vector<std::vector<float>> buffer;
-    std::atomic<size_t> writeIndex;
-    std::atomic<size_t> readIndex;
-    std::atomic<size_t> size;
+    Counter& inputOverflows;
+    Counter& outputOverflows;
+    Counter& outputStarved; // played silence, nothing converted yet
+    Counter& deviceInputOverflows;
+    Counter& deviceOutputUnderflows;
+    Counter& blocks;
+    Histogram& blockLatency;
 };
 
 struct AudioData
@@ -129,12 +75,56 @@ struct AudioData
     CircularBuffer inputBuffer;
     CircularBuffer outputBuffer;
     Ort::Session* session;
-    std::unique_ptr<Ort::Value> enc_buf_tensor;
-    std::unique_ptr<Ort::Value> dec_buf_tensor;
-    std::unique_ptr<Ort::Value> out_buf_tensor;
-    std::unique_ptr<Ort::Value> convnet_pre_ctx_tensor;
+    StreamState state;
+    double firstBlockMs = -1.0; // latency of the first live block
+    // Blocks one Run may take when the inference thread falls behind; the
+    // model accepts any input length, so queued blocks are concatenated
+    // and converted together. 1 keeps strictly per-block processing.
+    size_t coalesceLimit = 1;
+    InferenceStats stats{};
+    // The audio callback and inference thread only log through this
+    RtLog* log               = nullptr;
+    RealtimeMetrics* metrics = nullptr;
+    // Latency bound in blocks, over both queues; maxBlocks 0 is unbounded
+    size_t targetBlocks = 0;
+    size_t maxBlocks    = 0;
+    std::atomic<size_t> droppedBlocks{ 0 };
+    // Queueing latency seen by the audio callback, updated every period
+    std::atomic<double> latencyMs{ 0.0 };
+    std::atomic<double> peakLatencyMs{ 0.0 };
 };
 
+static double
+queueLatencyMs(const AudioData* data)
+{
+    return (data->inputBuffer.queued() + data->outputBuffer.queued()) *
+           BLOCK_MS;
+}
+
+// Called by the consumer of `queue`: once more than maxBlocks are queued
+// across both buffers, drops the oldest blocks of `queue` until the
+// pipeline is back at targetBlocks (or `queue` is empty). Live
+// conversation prefers a skip to permanently delayed speech.
+static void
+boundLatency(AudioData* data, CircularBuffer& queue)
+{
+    size_t queued = data->inputBuffer.queued() + data->outputBuffer.queued();
+    if (data->maxBlocks == 0 || queued <= data->maxBlocks)
+    {
+        return;
+    }
+    size_t dropped = 0;
+    while (queued > data->targetBlocks && queue.dropOldest())
+    {
+        --queued;
+        ++dropped;
+    }
+    data->droppedBlocks.fetch_add(dropped, std::memory_order_relaxed);
+    data->log->log("Latency bound exceeded, dropped oldest blocks",
+                   static_cast<int64_t>(dropped),
+                   static_cast<int64_t>(queued * BLOCK_MS));
+}
+
 static int
 paCallback(const void* inputBuffer,
            void* outputBuffer,
@@ -150,7 +140,26 @@ paCallback(const void* inputBuffer,
     std::vector<float> inputBlock(in, in + framesPerBuffer);
     if (!data->inputBuffer.push(inputBlock))
     {
-        std::cerr << "Input buffer overflow!" << std::endl;
+        data->log->log("Input buffer overflow!");
+        data->metrics->inputOverflows.add();
+    }
+    if (statusFlags & paInputOverflow)
+    {
+        data->log->log("PortAudio input overflow");
+        data->metrics->deviceInputOverflows.add();
+    }
+    if (statusFlags & paOutputUnderflow)
+    {
+        data->log->log("PortAudio output underflow");
+        data->metrics->deviceOutputUnderflows.add();
+    }
+
+    boundLatency(data, data->outputBuffer);
+    double latency = queueLatencyMs(data);
+    data->latencyMs.store(latency, std::memory_order_relaxed);
+    if (latency > data->peakLatencyMs.load(std::memory_order_relaxed))
+    {
+        data->peakLatencyMs.store(latency, std::memory_order_relaxed);
     }
 
     std::vector<float> outputBlock(BLOCK_SIZE, 0.0f);
@@ -163,6 +172,7 @@ paCallback(const void* inputBuffer,
         std::fill(out,
                   out + framesPerBuffer,
                   0.0f); // Silence if no processed data available
+        data->metrics->outputStarved.add();
     }
 
     return paContinue;
@@ -171,20 +181,58 @@ paCallback(const void* inputBuffer,
 void
 inferenceThread(AudioData* data)
 {
+    std::vector<float> inputBlock(BLOCK_SIZE, 0.0f);
+    std::vector<float> run(data->coalesceLimit * BLOCK_SIZE, 0.0f);
+    InferenceStats& stats = data->stats;
     while (data->running.load())
     {
-        std::vector<float> inputBlock(BLOCK_SIZE, 0.0f);
-        if (data->inputBuffer.pop(inputBlock))
+        // Everything queued, up to the limit, goes into one Run; once
+        // caught up this is a single block again
+        boundLatency(data, data->inputBuffer);
+        size_t blocks = 0;
+        while (blocks < data->coalesceLimit &&
+               data->inputBuffer.pop(inputBlock))
+        {
+            std::copy(inputBlock.begin(),
+                      inputBlock.end(),
+                      run.begin() + blocks * BLOCK_SIZE);
+            ++blocks;
+        }
+        if (blocks > 0)
         {
+            auto start = std::chrono::steady_clock::now();
             processBlock(*data->session,
-                         inputBlock,
-                         data->enc_buf_tensor,
-                         data->dec_buf_tensor,
-                         data->out_buf_tensor,
-                         data->convnet_pre_ctx_tensor);
-            if (!data->outputBuffer.push(inputBlock))
+                         run.data(),
+                         run.data(),
+                         blocks * BLOCK_SIZE,
+                         data->state);
+            double runMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+            if (data->firstBlockMs < 0.0)
+            {
+                data->firstBlockMs = runMs;
+            }
+            data->metrics->blocks.add(blocks);
+            data->metrics->blockLatency.observe(runMs);
+            ++stats.runs;
+            stats.blocks += blocks;
+            stats.largestRun = std::max(stats.largestRun, blocks);
+            if (blocks > 1)
             {
-                std::cerr << "Output buffer overflow!" << std::endl;
+                ++stats.coalescedRuns;
+                stats.coalescedBlocks += blocks;
+            }
+
+            for (size_t b = 0; b < blocks; ++b)
+            {
+                auto first = run.begin() + b * BLOCK_SIZE;
+                std::copy(first, first + BLOCK_SIZE, inputBlock.begin());
+                if (!data->outputBuffer.push(inputBlock))
+                {
+                    data->log->log("Output buffer overflow!");
+                    data->metrics->outputOverflows.add();
+                }
             }
         }
         std::this_thread::sleep_for(
@@ -193,10 +241,59 @@ inferenceThread(AudioData* data)
 }
 
 int
-main()
+main(int argc, char* argv[])
 {
     const char* modelPath = "/Users/thomaspower/Developer/Koala/LLVC_Test/"
                             "onnx_models/llvc_model.onnx";
+    size_t coalesceLimit  = 1;
+    double targetMs       = DEFAULT_TARGET_LATENCY_MS;
+    double maxMs          = DEFAULT_MAX_LATENCY_MS;
+    int metricsPort       = 0;
+    std::string metricsFile;
+    bool usage            = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--coalesce" && i + 1 < argc)
+        {
+            coalesceLimit = std::strtoul(argv[++i], nullptr, 10);
+            usage         = coalesceLimit == 0;
+        }
+        else if (arg == "--target-latency" && i + 1 < argc)
+        {
+            targetMs = std::atof(argv[++i]);
+        }
+        else if (arg == "--max-latency" && i + 1 < argc)
+        {
+            maxMs = std::atof(argv[++i]); // 0 disables the bound
+        }
+        else if (arg == "--metrics-port" && i + 1 < argc)
+        {
+            metricsPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--metrics-file" && i + 1 < argc)
+        {
+            metricsFile = argv[++i]; // rewritten every second
+        }
+        else if (arg[0] != '-')
+        {
+            modelPath = argv[i];
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+    if (usage || targetMs < 0.0 || maxMs < 0.0 ||
+        (maxMs > 0.0 && targetMs > maxMs))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [model.onnx] [--coalesce MAX_BLOCKS]"
+                     " [--target-latency MS] [--max-latency MS]"
+                     " [--metrics-port PORT] [--metrics-file PATH]"
+                  << std::endl;
+        return 1;
+    }
 
     try
     {
@@ -207,47 +304,18 @@ main()
         session_options.SetGraphOptimizationLevel(
           GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
 
-        Ort::Session session(env, modelPath, session_options);
-
-        // Initialize state tensors
-        Ort::MemoryInfo memory_info =
-          Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-        std::vector<float> enc_buf(1 * 512 * 510, 0.0f);
-        std::vector<int64_t> enc_buf_shape = { 1, 512, 510 };
-        auto enc_buf_tensor                = std::make_unique<Ort::Value>(
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          enc_buf.data(),
-                                          enc_buf.size(),
-                                          enc_buf_shape.data(),
-                                          enc_buf_shape.size()));
-
-        std::vector<float> dec_buf(1 * 2 * 13 * 256, 0.0f);
-        std::vector<int64_t> dec_buf_shape = { 1, 2, 13, 256 };
-        auto dec_buf_tensor                = std::make_unique<Ort::Value>(
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          dec_buf.data(),
-                                          dec_buf.size(),
-                                          dec_buf_shape.data(),
-                                          dec_buf_shape.size()));
-
-        std::vector<float> out_buf(1 * 512 * 4, 0.0f);
-        std::vector<int64_t> out_buf_shape = { 1, 512, 4 };
-        auto out_buf_tensor                = std::make_unique<Ort::Value>(
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          out_buf.data(),
-                                          out_buf.size(),
-                                          out_buf_shape.data(),
-                                          out_buf_shape.size()));
-
-        std::vector<float> convnet_pre_ctx(1 * 1 * 24, 0.0f);
-        std::vector<int64_t> convnet_pre_ctx_shape = { 1, 1, 24 };
-        auto convnet_pre_ctx_tensor = std::make_unique<Ort::Value>(
-          Ort::Value::CreateTensor<float>(memory_info,
-                                          convnet_pre_ctx.data(),
-                                          convnet_pre_ctx.size(),
-                                          convnet_pre_ctx_shape.data(),
-                                          convnet_pre_ctx_shape.size()));
+        // Warm up before the stream opens so no live block pays for
+        // first-run allocations
+        StartupReport startup;
+        std::unique_ptr<Ort::Session> session =
+          createSession(env, modelPath, session_options, startup);
+        std::vector<size_t> warmupSizes;
+        for (size_t blocks = 1; blocks <= coalesceLimit; ++blocks)
+        {
+            warmupSizes.push_back(blocks * BLOCK_SIZE);
+        }
+        warmUpSession(*session, warmupSizes, startup);
+        printStartupReport(std::cout, startup);
 
         // Initialize PortAudio
         PaError err = Pa_Initialize();
@@ -258,14 +326,27 @@ main()
             return 1;
         }
 
+        RtLog log(LOG_RECORDS, std::cerr);
+        MetricsRegistry registry;
+        RealtimeMetrics metrics(registry);
         AudioData data = { true,
-                           CircularBuffer(),
-                           CircularBuffer(),
-                           &session,
-                           std::move(enc_buf_tensor),
-                           std::move(dec_buf_tensor),
-                           std::move(out_buf_tensor),
-                           std::move(convnet_pre_ctx_tensor) };
+                           CircularBuffer(BUFFER_SIZE, BLOCK_SIZE),
+                           CircularBuffer(BUFFER_SIZE, BLOCK_SIZE),
+                           session.get(),
+                           createStreamState() };
+        data.coalesceLimit = coalesceLimit;
+        data.log           = &log;
+        data.metrics       = &metrics;
+        data.targetBlocks  = static_cast<size_t>(targetMs / BLOCK_MS + 0.5);
+        data.maxBlocks     = static_cast<size_t>(maxMs / BLOCK_MS + 0.5);
+        if (maxMs > 0.0)
+        {
+            // A bound below one block would drop every block
+            data.maxBlocks = std::max<size_t>(data.maxBlocks, 1);
+            std::cout << "Queue latency bound: target "
+                      << data.targetBlocks * BLOCK_MS << " ms, max "
+                      << data.maxBlocks * BLOCK_MS << " ms" << std::endl;
+        }
         PaStream* stream;
         err = Pa_OpenDefaultStream(&stream,
                                    1,          // Input channels
@@ -282,6 +363,42 @@ main()
             return 1;
         }
 
+        registry.gauge("llvc_queue_latency_ms",
+                       "Audio queued between microphone and speaker",
+                       [&data] { return data.latencyMs.load(); });
+        registry.gauge("llvc_queue_depth{ring=\"input\"}",
+                       "Blocks queued in each ring",
+                       [&data] { return data.inputBuffer.queued(); });
+        registry.gauge("llvc_queue_depth{ring=\"output\"}",
+                       "",
+                       [&data] { return data.outputBuffer.queued(); });
+        registry.gauge("llvc_latency_dropped_blocks",
+                       "Blocks dropped to stay within the latency bound",
+                       [&data] { return data.droppedBlocks.load(); });
+        registry.gauge("llvc_inference_seconds_per_audio_second",
+                       "Inference time per second of audio since start",
+                       [&metrics] {
+                           Histogram::Snapshot runs =
+                             metrics.blockLatency.snapshot();
+                           uint64_t blocks = metrics.blocks.value();
+                           return blocks > 0 ? runs.sum / (blocks * BLOCK_MS)
+                                             : 0.0;
+                       });
+        registry.gauge("llvc_active_streams", "Open audio streams", [] {
+            return 1.0;
+        });
+        registry.gauge("llvc_model_load_ms",
+                       "Session creation and warm-up time",
+                       [&startup] {
+                           return startup.sessionMs + startup.warmupMs;
+                       });
+        std::unique_ptr<MetricsExporter> exporter;
+        if (metricsPort > 0 || !metricsFile.empty())
+        {
+            exporter = std::make_unique<MetricsExporter>(
+              registry, metricsPort, metricsFile, 1.0);
+        }
+
         std::thread inference(inferenceThread, &data);
 
         err = Pa_StartStream(stream);
@@ -289,6 +406,11 @@ main()
         {
             std::cerr << "PortAudio error: " << Pa_GetErrorText(err)
                       << std::endl;
+            // A joinable thread must not be destroyed
+            data.running.store(false);
+            inference.join();
+            Pa_CloseStream(stream);
+            Pa_Terminate();
             return 1;
         }
 
@@ -298,6 +420,22 @@ main()
         data.running.store(false);
         inference.join();
 
+        startup.firstBlockMs = data.firstBlockMs;
+        printStartupReport(std::cout, startup);
+        const InferenceStats& stats = data.stats;
+        std::cout << "Inference: " << stats.runs << " runs for "
+                  << stats.blocks << " blocks; " << stats.coalescedRuns
+                  << " coalesced runs covered " << stats.coalescedBlocks
+                  << " blocks (largest " << stats.largestRun << ")"
+                  << std::endl;
+        std::cout << "Queue latency: " << data.latencyMs.load()
+                  << " ms now, " << data.peakLatencyMs.load()
+                  << " ms peak; " << data.droppedBlocks.load()
+                  << " blocks dropped to stay within the bound"
+                  << std::endl;
+        std::cout << "Real-time log: " << log.written() << " records, "
+                  << log.dropped() << " dropped" << std::endl;
+
         err = Pa_StopStream(stream);
         if (err != paNoError)
         {
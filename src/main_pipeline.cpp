@@ -0,0 +1,613 @@
+#include "llvc.h"
+#include "NativeEngine.h"
+#include "NativeKernels.h"
+#include "SpscQueue.h"
+#include "StagedSession.h"
+#include "../lib/tinywav/tinywav.h"
+#include <onnxruntime_cxx_api.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Offline conversion as a three-stage pipeline: a reader thread decodes
+// blocks ahead, the inference stage consumes them, and a writer thread
+// encodes behind it, so file I/O overlaps with session.Run. With --stages
+// the inference stage is itself split into pipelined sessions at the given
+// cut tensors, each on its own (optionally pinned) thread. --backend native
+// runs the inference stage on NativeEngine instead of ONNX Runtime.
+
+using Clock = std::chrono::steady_clock;
+
+struct PipelineBlock
+{
+    std::vector<float> samples;
+    size_t count = 0;  // valid samples, the rest is zero padding
+    bool last    = false;
+};
+
+struct StageStats
+{
+    const char* name;
+    double busySeconds = 0.0; // time spent doing the stage's own work
+    double waitSeconds = 0.0; // time blocked on an empty / full queue
+    size_t blocks      = 0;
+    std::string error  = {}; // why the stage aborted the pipeline, if it did
+};
+
+static double
+secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Retries a queue operation until it succeeds, backing off from spinning to
+// sleeping. Returns false if the pipeline was aborted while waiting.
+template <typename Op>
+static bool
+waitFor(Op&& op, const std::atomic<bool>& aborted, StageStats& stats)
+{
+    auto start = Clock::now();
+    for (int attempt = 0; !op(); ++attempt)
+    {
+        if (aborted.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        if (attempt < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    stats.waitSeconds += secondsSince(start);
+    return true;
+}
+
+struct Pipeline
+{
+    Pipeline(size_t blockSize, size_t queueDepth)
+      : freeBlocks(2 * queueDepth + 3)
+      , inputBlocks(queueDepth)
+      , outputBlocks(queueDepth)
+      , aborted(false)
+    {
+        // Every block the pipeline will ever use is allocated up front and
+        // recycled from the writer back to the reader.
+        for (size_t i = 0; i < 2 * queueDepth + 3; ++i)
+        {
+            PipelineBlock block;
+            block.samples.resize(blockSize, 0.0f);
+            freeBlocks.tryPush(std::move(block));
+        }
+    }
+
+    SpscQueue<PipelineBlock> freeBlocks;   // writer -> reader
+    SpscQueue<PipelineBlock> inputBlocks;  // reader -> inference
+    SpscQueue<PipelineBlock> outputBlocks; // inference -> writer
+    std::atomic<bool> aborted;
+};
+
+// Stops every stage; main reports `message` once they have joined
+static void
+abortStage(Pipeline& pipeline, StageStats& stats, const std::string& message)
+{
+    stats.error = message + ": " + std::strerror(errno);
+    pipeline.aborted.store(true);
+}
+
+static void
+readerStage(Pipeline& pipeline, TinyWav& reader, StageStats& stats)
+{
+    PipelineBlock block;
+    do
+    {
+        if (!waitFor([&] { return pipeline.freeBlocks.tryPop(block); },
+                     pipeline.aborted,
+                     stats))
+        {
+            return;
+        }
+
+        auto start = Clock::now();
+        int frames = tinywav_read_f(&reader,
+                                    block.samples.data(),
+                                    static_cast<int>(block.samples.size()));
+        if (frames < 0 || std::ferror(reader.f))
+        {
+            abortStage(pipeline, stats, "reading the input failed");
+            return;
+        }
+        block.count = frames > 0 ? static_cast<size_t>(frames) : 0;
+        block.last  = block.count < block.samples.size();
+        stats.busySeconds += secondsSince(start);
+        ++stats.blocks;
+
+        bool last = block.last;
+        if (!waitFor(
+              [&] { return pipeline.inputBlocks.tryPush(std::move(block)); },
+              pipeline.aborted,
+              stats))
+        {
+            return;
+        }
+        if (last)
+        {
+            return;
+        }
+    } while (true);
+}
+
+// `engine` is an Ort::Session or a NativeEngine, with its state type
+template <typename Engine, typename State>
+static void
+inferenceStage(Pipeline& pipeline,
+               Engine& engine,
+               State& state,
+               StageStats& stats)
+{
+    PipelineBlock block;
+    do
+    {
+        if (!waitFor([&] { return pipeline.inputBlocks.tryPop(block); },
+                     pipeline.aborted,
+                     stats))
+        {
+            return;
+        }
+
+        auto start = Clock::now();
+        if (block.count > 0)
+        {
+            std::fill(
+              block.samples.begin() + block.count, block.samples.end(), 0.0f);
+            processBlock(engine, block.samples, state);
+        }
+        stats.busySeconds += secondsSince(start);
+        ++stats.blocks;
+
+        bool last = block.last;
+        if (!waitFor(
+              [&] { return pipeline.outputBlocks.tryPush(std::move(block)); },
+              pipeline.aborted,
+              stats))
+        {
+            return;
+        }
+        if (last)
+        {
+            return;
+        }
+    } while (true);
+}
+
+// Keeps up to `depth` blocks inside the staged session and forwards them in
+// order; empty final blocks are not submitted and pass straight through.
+static void
+stagedInferenceStage(Pipeline& pipeline,
+                     StagedSession& staged,
+                     size_t depth,
+                     StageStats& stats)
+{
+    std::deque<PipelineBlock> inFlight;
+    PipelineBlock block;
+    bool inputDone = false;
+    auto idleSince = Clock::now();
+    for (int attempt = 0;;)
+    {
+        bool progressed = false;
+        if (!inputDone && inFlight.size() < depth &&
+            pipeline.inputBlocks.tryPop(block))
+        {
+            auto start = Clock::now();
+            inputDone  = block.last;
+            if (block.count > 0)
+            {
+                std::fill(block.samples.begin() + block.count,
+                          block.samples.end(),
+                          0.0f);
+                if (!staged.trySubmit(block.samples.data(),
+                                      block.samples.size()))
+                {
+                    throw std::runtime_error("staged session queue is full");
+                }
+            }
+            inFlight.push_back(std::move(block));
+            stats.busySeconds += secondsSince(start);
+            progressed = true;
+        }
+        if (!inFlight.empty() &&
+            (inFlight.front().count == 0 ||
+             staged.tryReceive(inFlight.front().samples.data(),
+                               inFlight.front().samples.size())))
+        {
+            block = std::move(inFlight.front());
+            inFlight.pop_front();
+            ++stats.blocks;
+            bool last = block.last;
+            if (!waitFor(
+                  [&] {
+                      return pipeline.outputBlocks.tryPush(std::move(block));
+                  },
+                  pipeline.aborted,
+                  stats))
+            {
+                return;
+            }
+            if (last)
+            {
+                return;
+            }
+            progressed = true;
+        }
+
+        if (progressed)
+        {
+            attempt   = 0;
+            idleSince = Clock::now();
+            continue;
+        }
+        if (pipeline.aborted.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        if (attempt++ < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        stats.waitSeconds += secondsSince(idleSince);
+        idleSince = Clock::now();
+    }
+}
+
+static void
+writerStage(Pipeline& pipeline, TinyWav& writer, StageStats& stats)
+{
+    PipelineBlock block;
+    do
+    {
+        if (!waitFor([&] { return pipeline.outputBlocks.tryPop(block); },
+                     pipeline.aborted,
+                     stats))
+        {
+            return;
+        }
+
+        auto start = Clock::now();
+        if (block.count > 0 &&
+            tinywav_write_f(&writer,
+                            block.samples.data(),
+                            static_cast<int>(block.count)) !=
+              static_cast<int>(block.count))
+        {
+            abortStage(pipeline, stats, "writing the output failed");
+            return;
+        }
+        stats.busySeconds += secondsSince(start);
+        ++stats.blocks;
+
+        bool last = block.last;
+        if (!waitFor(
+              [&] { return pipeline.freeBlocks.tryPush(std::move(block)); },
+              pipeline.aborted,
+              stats))
+        {
+            return;
+        }
+        if (last)
+        {
+            return;
+        }
+    } while (true);
+}
+
+static void
+printStage(const StageStats& stats, double wallSeconds)
+{
+    std::cout << "  " << stats.name << ": " << stats.blocks << " blocks, busy "
+              << stats.busySeconds << " s ("
+              << 100.0 * stats.busySeconds / wallSeconds << "% utilization), "
+              << "waiting " << stats.waitSeconds << " s" << std::endl;
+}
+
+// A positive decimal count with nothing after it
+static bool
+parseCount(const char* text, size_t& count)
+{
+    if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end           = nullptr;
+    errno               = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0)
+    {
+        return false;
+    }
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+// A CPU number: decimal digits only
+static bool
+parseCpu(const char* text, int& cpu)
+{
+    if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end  = nullptr;
+    errno      = 0;
+    long value = std::strtol(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > INT_MAX)
+    {
+        return false;
+    }
+    cpu = static_cast<int>(value);
+    return true;
+}
+
+static std::vector<std::string>
+splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        items.push_back(item);
+    }
+    return items;
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::vector<const char*> positional;
+    std::vector<std::string> cuts;
+    std::vector<int> cores;
+    bool native = false;
+    bool usage  = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--stages" && i + 1 < argc)
+        {
+            cuts  = splitList(argv[++i]);
+            usage = cuts.empty();
+        }
+        else if (arg == "--cores" && i + 1 < argc)
+        {
+            for (const std::string& core : splitList(argv[++i]))
+            {
+                int cpu = 0;
+                usage = usage || !parseCpu(core.c_str(), cpu);
+                cores.push_back(cpu);
+            }
+        }
+        else if (arg == "--backend" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            native            = value == "native";
+            usage             = !native && value != "ort";
+        }
+        else if (arg[0] != '-')
+        {
+            positional.push_back(argv[i]);
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+    size_t blockSize  = 1024;
+    size_t queueDepth = 16;
+    if (positional.size() > 3)
+    {
+        usage = usage || !parseCount(positional[3], blockSize);
+    }
+    if (positional.size() > 4)
+    {
+        usage = usage || !parseCount(positional[4], queueDepth);
+    }
+    if (usage || positional.size() < 3 || positional.size() > 5 ||
+        (!cores.empty() && cuts.empty()) || (native && !cuts.empty()))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> <input.wav> <output.wav>"
+                     " [blockSize=1024] [queueDepth=16]"
+                     " [--stages CUT,...] [--cores CPU,...]"
+                     " [--backend ort|native]\n"
+                     "blockSize and queueDepth are positive integers. "
+                     "--stages needs the ort backend. The native backend "
+                     "needs a build with LLVC_NATIVE_ARCH=ON to use AVX2."
+                  << std::endl;
+        return 1;
+    }
+    const char* modelPath  = positional[0];
+    const char* inputPath  = positional[1];
+    const char* outputPath = positional[2];
+
+    try
+    {
+        // Set up ONNX Runtime
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_pipeline");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+
+        // The staged variant or the native engine replaces the single
+        // session
+        std::unique_ptr<Ort::Session> session;
+        std::unique_ptr<StagedSession> staged;
+        std::unique_ptr<NativeEngine> engine;
+        NativeState nativeState;
+        if (native)
+        {
+            engine      = std::make_unique<NativeEngine>(modelPath);
+            nativeState = engine->createState();
+            std::cout << "Native engine, " << kernelIsa() << " kernels."
+                      << std::endl;
+        }
+        else if (cuts.empty())
+        {
+            session =
+              std::make_unique<Ort::Session>(env, modelPath, session_options);
+        }
+        else
+        {
+            staged = std::make_unique<StagedSession>(
+              env, modelPath, cuts, session_options, cores, queueDepth);
+        }
+        StreamState state = createStreamState();
+
+        TinyWav reader;
+        if (tinywav_open_read(&reader, inputPath, TW_INLINE) != 0)
+        {
+            std::cerr << "Failed to open " << inputPath << std::endl;
+            return 1;
+        }
+        if (reader.numChannels != 1)
+        {
+            std::cerr << "Only mono input is supported, got "
+                      << reader.numChannels << " channels." << std::endl;
+            tinywav_close_read(&reader);
+            return 1;
+        }
+
+        TinyWav writer;
+        if (tinywav_open_write(
+              &writer, 1, SAMPLE_RATE, TW_INT16, TW_INLINE, outputPath) != 0)
+        {
+            std::cerr << "Failed to open " << outputPath << std::endl;
+            tinywav_close_read(&reader);
+            return 1;
+        }
+
+        Pipeline pipeline(blockSize, queueDepth);
+        StageStats readerStats{ "reader" };
+        StageStats inferenceStats{ "inference" };
+        StageStats writerStats{ "writer" };
+
+        auto start_time = Clock::now();
+
+        std::thread readerThread(
+          [&] { readerStage(pipeline, reader, readerStats); });
+        std::thread writerThread(
+          [&] { writerStage(pipeline, writer, writerStats); });
+
+        try
+        {
+            if (staged)
+            {
+                stagedInferenceStage(
+                  pipeline, *staged, queueDepth, inferenceStats);
+            }
+            else if (engine)
+            {
+                inferenceStage(pipeline, *engine, nativeState, inferenceStats);
+            }
+            else
+            {
+                inferenceStage(pipeline, *session, state, inferenceStats);
+            }
+        }
+        catch (...)
+        {
+            pipeline.aborted.store(true);
+            readerThread.join();
+            writerThread.join();
+            tinywav_close_read(&reader);
+            tinywav_close_write(&writer);
+            throw;
+        }
+        readerThread.join();
+        writerThread.join();
+
+        double wallSeconds = secondsSince(start_time);
+        std::string error  = readerStats.error.empty() ? writerStats.error
+                                                       : readerStats.error;
+        if (error.empty() && std::fflush(writer.f) != 0)
+        {
+            error = "writing the output failed: " +
+                    std::string(std::strerror(errno));
+        }
+        tinywav_close_read(&reader);
+        tinywav_close_write(&writer);
+        if (!error.empty())
+        {
+            throw std::runtime_error(error);
+        }
+
+        double audio_length_seconds =
+          static_cast<double>(writer.totalFramesReadWritten) / SAMPLE_RATE;
+        double serialSeconds = readerStats.busySeconds +
+                               inferenceStats.busySeconds +
+                               writerStats.busySeconds;
+        for (size_t k = 0; staged && k < staged->stageCount(); ++k)
+        {
+            serialSeconds += staged->timing(k).busySeconds;
+        }
+
+        std::cout << "Processed audio in " << wallSeconds << " seconds."
+                  << std::endl;
+        std::cout << "Audio length: " << audio_length_seconds << " seconds."
+                  << std::endl;
+        std::cout << "Real-time factor: " << audio_length_seconds / wallSeconds
+                  << std::endl;
+        std::cout << "Stage utilization:" << std::endl;
+        printStage(readerStats, wallSeconds);
+        printStage(inferenceStats, wallSeconds);
+        printStage(writerStats, wallSeconds);
+        for (size_t k = 0; staged && k < staged->stageCount(); ++k)
+        {
+            StageTiming timing = staged->timing(k);
+            std::cout << "    model stage " << k;
+            if (!cores.empty())
+            {
+                std::cout << " (CPU " << cores[k] << ")";
+            }
+            std::cout << ": " << timing.blocks << " blocks, busy "
+                      << timing.busySeconds << " s ("
+                      << 100.0 * timing.busySeconds / wallSeconds
+                      << "% utilization), "
+                      << staged->stageOutputs(k).size() << " outputs"
+                      << std::endl;
+        }
+        std::cout << "Overlap speedup vs. serial stages: "
+                  << serialSeconds / wallSeconds << "x" << std::endl;
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
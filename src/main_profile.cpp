@@ -0,0 +1,433 @@
+#include "../lib/tinywav/myk_tiny.h"
+#include "OrtProfile.h"
+#include "llvc.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Per-operator hotspot report. Streams the test audio through the model in
+// fixed blocks with ORT's profiler on, then ranks kernel time by operator
+// type and by node, averaged per block. --tsv saves the summary and --diff
+// compares two saved summaries (e.g. two model versions or block sizes).
+
+namespace fs = std::filesystem;
+
+// Operators that move the recurrent state buffers rather than compute
+const char* const STATE_OPS[] = { "Concat", "Slice", "Split" };
+
+struct Row
+{
+    std::string kind; // "run", "op" or "node"
+    std::string name;
+    std::string opType;
+    double callsPerRun = 0.0;
+    double usPerRun    = 0.0;
+    double share       = 0.0; // percent of kernel time
+};
+
+static bool
+isStateOp(const std::string& opType)
+{
+    for (const char* op : STATE_OPS)
+    {
+        if (opType == op)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::vector<std::string>
+findAudio(const std::vector<std::string>& paths)
+{
+    std::vector<std::string> files;
+    for (const std::string& path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto& entry : fs::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".wav")
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+static std::vector<Row>
+toRows(const ProfileSummary& summary)
+{
+    std::vector<Row> rows;
+    double runs   = std::max<size_t>(summary.runs, 1);
+    double kernel = std::max<int64_t>(summary.kernelUs, 1);
+    rows.push_back(
+      { "run", "model_run", "-", 1.0, summary.runUs / runs, 100.0 });
+    for (const KernelTime& op : summary.operators)
+    {
+        rows.push_back({ "op",
+                         op.name,
+                         op.opType,
+                         op.calls / runs,
+                         op.totalUs / runs,
+                         100.0 * op.totalUs / kernel });
+    }
+    for (const KernelTime& node : summary.nodes)
+    {
+        rows.push_back({ "node",
+                         node.name,
+                         node.opType,
+                         node.calls / runs,
+                         node.totalUs / runs,
+                         100.0 * node.totalUs / kernel });
+    }
+    return rows;
+}
+
+static void
+writeTsv(const std::string& path,
+         const std::vector<Row>& rows,
+         const std::string& description)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+    out << "# " << description << "\n";
+    out << "kind\tname\top\tcalls_per_run\tus_per_run\tshare_pct\n";
+    for (const Row& row : rows)
+    {
+        out << row.kind << '\t' << row.name << '\t' << row.opType << '\t'
+            << row.callsPerRun << '\t' << row.usPerRun << '\t' << row.share
+            << '\n';
+    }
+}
+
+static std::vector<Row>
+readTsv(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::vector<Row> rows;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#' || line.rfind("kind\t", 0) == 0)
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        Row row;
+        std::string calls, us, share;
+        std::getline(fields, row.kind, '\t');
+        std::getline(fields, row.name, '\t');
+        std::getline(fields, row.opType, '\t');
+        std::getline(fields, calls, '\t');
+        std::getline(fields, us, '\t');
+        std::getline(fields, share, '\t');
+        row.callsPerRun = std::strtod(calls.c_str(), nullptr);
+        row.usPerRun    = std::strtod(us.c_str(), nullptr);
+        row.share       = std::strtod(share.c_str(), nullptr);
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+static void
+printTable(const char* title,
+           const std::vector<Row>& rows,
+           const std::string& kind,
+           size_t top)
+{
+    std::cout << "\n" << title << "\n"
+              << "   us/block  kernel%  calls/block  name" << std::endl;
+    size_t shown = 0;
+    for (const Row& row : rows)
+    {
+        if (row.kind != kind || shown++ == top)
+        {
+            continue;
+        }
+        std::cout << std::setw(11) << row.usPerRun << std::setw(9)
+                  << row.share << std::setw(13) << row.callsPerRun << "  "
+                  << row.name;
+        if (kind == "node")
+        {
+            std::cout << " (" << row.opType << ")";
+        }
+        std::cout << std::endl;
+    }
+}
+
+static void
+printReport(const ProfileSummary& summary,
+            const std::vector<Row>& rows,
+            size_t top)
+{
+    double runs  = std::max<size_t>(summary.runs, 1);
+    double state = 0.0;
+    for (const KernelTime& op : summary.operators)
+    {
+        if (isStateOp(op.opType))
+        {
+            state += op.totalUs;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << summary.runs << " profiled blocks: " << summary.runUs / runs
+              << " us per Run, of which kernels "
+              << summary.kernelUs / runs << " us" << std::endl;
+    std::cout << "State buffer Concat/Slice/Split: " << state / runs
+              << " us per block ("
+              << 100.0 * state / std::max<int64_t>(summary.kernelUs, 1)
+              << "% of kernel time)" << std::endl;
+    printTable("By operator type:", rows, "op", top);
+    printTable("By node:", rows, "node", top);
+}
+
+static void
+printDiff(const std::vector<Row>& before,
+          const std::vector<Row>& after,
+          size_t top)
+{
+    struct Delta
+    {
+        const Row* a = nullptr;
+        const Row* b = nullptr;
+        double change() const
+        {
+            return (b ? b->usPerRun : 0.0) - (a ? a->usPerRun : 0.0);
+        }
+    };
+    std::map<std::pair<std::string, std::string>, Delta> deltas;
+    for (const Row& row : before)
+    {
+        deltas[{ row.kind, row.name }].a = &row;
+    }
+    for (const Row& row : after)
+    {
+        deltas[{ row.kind, row.name }].b = &row;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    for (const char* kind : { "run", "op", "node" })
+    {
+        std::vector<const Delta*> ordered;
+        for (const auto& entry : deltas)
+        {
+            if (entry.first.first == kind)
+            {
+                ordered.push_back(&entry.second);
+            }
+        }
+        std::sort(ordered.begin(),
+                  ordered.end(),
+                  [](const Delta* x, const Delta* y) {
+                      return std::fabs(x->change()) > std::fabs(y->change());
+                  });
+        if (ordered.empty())
+        {
+            continue;
+        }
+
+        std::cout << "\n"
+                  << (kind == std::string("run")  ? "Per Run:"
+                      : kind == std::string("op") ? "By operator type:"
+                                                  : "By node:")
+                  << "\n        A us        B us     delta us  name"
+                  << std::endl;
+        for (size_t i = 0; i < ordered.size() && i < top; ++i)
+        {
+            const Delta& d = *ordered[i];
+            const Row& any = d.a ? *d.a : *d.b;
+            std::cout << std::setw(12) << (d.a ? d.a->usPerRun : 0.0)
+                      << std::setw(12) << (d.b ? d.b->usPerRun : 0.0)
+                      << std::setw(13) << std::showpos << d.change()
+                      << std::noshowpos << "  " << any.name
+                      << (d.a ? "" : " (new)") << (d.b ? "" : " (gone)")
+                      << std::endl;
+        }
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> [AUDIO.wav|DIR ...] [--block N]"
+                     " [--skip RUNS] [--top K] [--tsv OUT.tsv]\n"
+                     "       "
+                  << argv[0]
+                  << " --diff A.tsv B.tsv [--top K]\n"
+                     "Audio defaults to test_audio/; the first RUNS blocks"
+                     " (default 5) are warm-up and not counted."
+                  << std::endl;
+        return 1;
+    }
+
+    std::string modelPath;
+    std::vector<std::string> inputs;
+    std::vector<std::string> diffPaths;
+    std::string tsvPath;
+    size_t blockSize = 1024;
+    size_t skipRuns  = 5;
+    size_t top       = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--diff" && i + 2 < argc)
+        {
+            diffPaths = { argv[i + 1], argv[i + 2] };
+            i += 2;
+        }
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            blockSize = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--skip" && i + 1 < argc)
+        {
+            skipRuns = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--top" && i + 1 < argc)
+        {
+            top = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--tsv" && i + 1 < argc)
+        {
+            tsvPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+        else if (modelPath.empty())
+        {
+            modelPath = arg;
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+
+    try
+    {
+        if (!diffPaths.empty())
+        {
+            std::cout << "A: " << diffPaths[0] << "\nB: " << diffPaths[1]
+                      << std::endl;
+            printDiff(readTsv(diffPaths[0]), readTsv(diffPaths[1]), top);
+            return 0;
+        }
+        if (modelPath.empty() || blockSize == 0)
+        {
+            std::cerr << "A model and a non-zero block size are required."
+                      << std::endl;
+            return 1;
+        }
+        if (inputs.empty())
+        {
+            inputs.push_back("test_audio");
+        }
+        std::vector<std::string> files = findAudio(inputs);
+        if (files.empty())
+        {
+            std::cerr << "No .wav files found." << std::endl;
+            return 1;
+        }
+
+        // Set up ONNX Runtime with the profiler on for the whole session
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_profile");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        std::string prefix =
+          (fs::temp_directory_path() / "llvc_profile").string();
+        session_options.EnableProfiling(prefix.c_str());
+        Ort::Session session(env, modelPath.c_str(), session_options);
+
+        // Each file is its own stream; a trailing partial block is dropped
+        // so every profiled Run has the same shape
+        size_t blocks = 0;
+        std::vector<float> block(blockSize);
+        for (const std::string& file : files)
+        {
+            std::vector<float> audio = myk_tiny::loadWav(file);
+            StreamState state        = createStreamState();
+            for (size_t offset = 0; offset + blockSize <= audio.size();
+                 offset += blockSize)
+            {
+                std::copy(audio.begin() + offset,
+                          audio.begin() + offset + blockSize,
+                          block.begin());
+                processBlock(session, block, state);
+                ++blocks;
+            }
+            std::cout << "Profiled " << file << std::endl;
+        }
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        Ort::AllocatedStringPtr trace =
+          session.EndProfilingAllocated(allocator);
+        std::vector<ProfileEvent> events = loadProfile(trace.get());
+        std::remove(trace.get());
+
+        ProfileSummary summary = summarizeProfile(events, skipRuns);
+        if (summary.runs == 0)
+        {
+            std::cerr << "Only " << blocks << " blocks were run; nothing left"
+                      << " after skipping " << skipRuns << "." << std::endl;
+            return 1;
+        }
+        std::vector<Row> rows = toRows(summary);
+        printReport(summary, rows, top);
+
+        if (!tsvPath.empty())
+        {
+            std::ostringstream description;
+            description << "llvc_profile " << modelPath << " block="
+                        << blockSize << " runs=" << summary.runs;
+            writeTsv(tsvPath, rows, description.str());
+            std::cout << "\nSummary written to " << tsvPath << std::endl;
+        }
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1518 @@
+#include "HotSwap.h"
+#include "llvc.h"
+#include "llvc_net.h"
+#include "llvc_protocol.h"
+#include "llvc_startup.h"
+#include "Metrics.h"
+#include "ModelRegistry.h"
+#include "StatePool.h"
+#include "StateSnapshot.h"
+#include "StreamAccounting.h"
+#include "VadGate.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Streaming conversion server. One epoll thread owns every socket and
+// parses frames; a fixed pool of inference threads shares one session.
+// Each connection is a stream with its own state tensors and has at most
+// one block in flight, which keeps its blocks in order and its state
+// single-threaded without a thread per connection. States come from a
+// preallocated pool, so accepting a connection does not allocate them.
+// SIGHUP reloads the model in the background; streams move over at their
+// next block boundary (see HotSwap.h). With --models, a stream may name a
+// voice in its HELLO and is served from the ModelRegistry instead; a voice
+// that is not resident loads on its own thread while the stream's blocks
+// wait, so the inference threads keep serving everyone else. Every Run is
+// charged to its stream in CPU and wall time (StreamAccounting.h). A
+// stream's state can be snapshotted and restored over the connection
+// (STATE and SNAPSHOT in llvc_protocol.h), from and into its pooled state.
+
+const size_t MAX_PENDING_FRAMES = 8;       // per connection before reads pause
+const size_t MAX_WRITE_BACKLOG  = 1 << 20; // bytes queued for a slow reader
+const size_t CROSSFADE_BLOCKS   = 4;       // old and new model both run
+
+const uint64_t LISTEN_ID           = 0;
+const uint64_t WAKE_ID             = 1;
+const uint64_t SIGNAL_ID           = 2;
+const uint64_t FIRST_CONNECTION_ID = 16;
+
+struct Connection
+{
+    uint64_t id;
+    int fd;
+    PooledState* state = nullptr; // null in echo mode
+    std::shared_ptr<const LoadedModel> model; // the model `state` belongs to
+    std::string voice;                        // empty for the default model
+    StreamAccounting::Account* account = nullptr; // null in echo mode
+    std::unique_ptr<VadGate> vad;             // null unless --vad
+    // Outgoing model and its state while crossfading to a new one
+    std::shared_ptr<const LoadedModel> fadingModel;
+    PooledState* fadingState = nullptr;
+    size_t fadePosition      = 0;
+    std::vector<float> fadeBuffer;
+    std::vector<char> readBuffer;  // received bytes not yet parsed
+    std::vector<char> writeBuffer; // framed bytes waiting for the socket
+    size_t writeOffset = 0;
+    std::deque<std::vector<float>> pending; // blocks waiting for a worker,
+                                            // or empty for a SNAPSHOT
+    // Precision of each SNAPSHOT in `pending`, in order
+    std::deque<SnapshotPrecision> snapshots;
+    uint32_t events    = 0;                 // current epoll interest
+    bool greeted       = false;
+    bool inFlight      = false;
+    bool loadingVoice  = false; // blocks wait until the voice is loaded
+    bool draining      = false; // BYE or EOF: finish pending, then close
+    bool aborted       = false; // socket error: close as soon as idle
+    bool failed        = false; // ERROR sent, later results are dropped
+    size_t blocks      = 0;
+};
+
+// What the server exports (see Metrics.h); updated by the workers and the
+// event loop, read on scrape
+struct ServerMetrics
+{
+    explicit ServerMetrics(MetricsRegistry& registry)
+      : blocks(registry.counter("llvc_blocks_total", "Blocks converted"))
+      , failures(registry.counter("llvc_block_failures_total",
+                                  "Blocks whose inference failed"))
+      , audioSamples(registry.counter("llvc_audio_samples_total",
+                                      "Samples converted"))
+      , inferenceMicros(
+          registry.counter("llvc_inference_microseconds_total",
+                           "Worker time spent converting blocks"))
+      , blockLatency(
+          registry.histogram("llvc_block_latency_ms",
+                             "Time to convert one block, queueing excluded",
+                             LATENCY_BUCKETS_MS))
+      , connections(
+          registry.counter("llvc_connections_total", "Accepted connections"))
+      , rejected(registry.counter("llvc_connections_rejected_total",
+                                  "Connections refused at capacity"))
+      , activeStreams(
+          registry.gauge("llvc_active_streams", "Open connections"))
+      , modelLoadMs(registry.gauge(
+          "llvc_model_load_ms",
+          "Session creation and warm-up time of the current model"))
+      , modelGeneration(registry.gauge("llvc_model_generation",
+                                       "Generation of the current model"))
+    {
+    }
+
+    Counter& blocks;
+    Counter& failures;
+    Counter& audioSamples;
+    Counter& inferenceMicros;
+    Histogram& blockLatency;
+    Counter& connections;
+    Counter& rejected;
+    Gauge& activeStreams;
+    Gauge& modelLoadMs;
+    Gauge& modelGeneration;
+};
+
+static void
+recordModel(ServerMetrics& metrics, const LoadedModel& model)
+{
+    metrics.modelLoadMs.set(model.startup.sessionMs + model.startup.warmupMs);
+    metrics.modelGeneration.set(static_cast<double>(model.generation));
+}
+
+struct Job
+{
+    Connection* connection;
+    std::vector<float> block;
+    std::string error; // set by the worker if inference failed
+};
+
+// Inference threads sharing the current model (none in echo mode).
+// Completed jobs are handed back to the event loop through a mutex-guarded
+// list and an eventfd wake-up.
+class InferencePool
+{
+  public:
+    InferencePool(ModelSlot* models,
+                  StatePool* states,
+                  SwapPolicy policy,
+                  ServerMetrics* metrics,
+                  StreamAccounting* accounting,
+                  size_t threads,
+                  int wakeFd)
+      : models(models)
+      , states(states)
+      , policy(policy)
+      , metrics(metrics)
+      , accounting(accounting)
+      , wakeFd(wakeFd)
+    {
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~InferencePool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void submit(Job job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queued.push_back(std::move(job));
+        }
+        ready.notify_one();
+    }
+
+    void takeCompleted(std::vector<Job>& jobs)
+    {
+        std::lock_guard<std::mutex> lock(completedMutex);
+        jobs.swap(completed);
+    }
+
+    size_t queuedJobs() const
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return queued.size();
+    }
+
+    // Latency of the first block served, or -1 if none was
+    double firstBlockLatencyMs() const { return firstBlockMs.load(); }
+
+    size_t streamsSwitched() const { return switchedStreams.load(); }
+
+  private:
+    void run()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                ready.wait(lock,
+                           [this] { return stopping || !queued.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                job = std::move(queued.front());
+                queued.pop_front();
+            }
+
+            // Only the inference calls are timed, not swaps or queueing
+            RunCost cost;
+            try
+            {
+                if (models)
+                {
+                    convert(*job.connection, job.block, cost);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                job.error = e.what();
+            }
+            double blockMs = cost.wallSeconds * 1000.0;
+            if (job.connection->account)
+            {
+                // Failed blocks are charged too: the time was spent
+                accounting->record(
+                  job.connection->account, job.block.size(), cost);
+            }
+            if (!firstBlockDone.exchange(true))
+            {
+                firstBlockMs = blockMs;
+            }
+            if (!job.error.empty())
+            {
+                metrics->failures.add();
+            }
+            else if (models)
+            {
+                metrics->blocks.add();
+                metrics->audioSamples.add(job.block.size());
+                metrics->inferenceMicros.add(
+                  static_cast<uint64_t>(blockMs * 1000.0));
+                metrics->blockLatency.observe(blockMs);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(completedMutex);
+                completed.push_back(std::move(job));
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    // Adds the thread's time from construction to destruction to `total`,
+    // including when the timed call throws
+    class InferenceTimer
+    {
+      public:
+        explicit InferenceTimer(RunCost& total)
+          : total(total)
+        {
+        }
+
+        ~InferenceTimer()
+        {
+            RunCost spent = timer.elapsed();
+            total.cpuSeconds += spent.cpuSeconds;
+            total.wallSeconds += spent.wallSeconds;
+        }
+
+      private:
+        RunCost& total;
+        RunTimer timer;
+    };
+
+    // Runs one block, first moving the stream to a newly published model
+    // if the swap policy says so, and adds the time spent in inference to
+    // `cost`. Named voices are loaded before their first block is
+    // dispatched (VoiceLoader) and are not affected by reloads.
+    void convert(Connection& connection,
+                 std::vector<float>& block,
+                 RunCost& cost)
+    {
+        std::shared_ptr<const LoadedModel> latest =
+          connection.voice.empty() ? models->current() : connection.model;
+        if (latest != connection.model && policy == SwapPolicy::Crossfade &&
+            !connection.fadingModel)
+        {
+            PooledState* fresh = states->acquire();
+            if (fresh)
+            {
+                connection.fadingModel  = std::move(connection.model);
+                connection.fadingState  = connection.state;
+                connection.state        = fresh;
+                connection.fadePosition = 0;
+            }
+            else
+            {
+                // No room for a second state: switch with a plain reset
+                StatePool::reset(*connection.state);
+            }
+            connection.model = std::move(latest);
+            ++switchedStreams;
+        }
+
+        Ort::Session& session = *connection.model->session;
+        if (connection.fadingModel)
+        {
+            std::vector<float>& old = connection.fadeBuffer;
+            old.assign(block.begin(), block.end());
+            {
+                InferenceTimer timer(cost);
+                processBlock(*connection.fadingModel->session,
+                             old.data(),
+                             old.data(),
+                             old.size(),
+                             *connection.fadingState);
+                processBlock(session,
+                             block.data(),
+                             block.data(),
+                             block.size(),
+                             *connection.state);
+            }
+            crossfade(old.data(),
+                      block.data(),
+                      block.data(),
+                      block.size(),
+                      float(connection.fadePosition) / CROSSFADE_BLOCKS,
+                      float(connection.fadePosition + 1) / CROSSFADE_BLOCKS);
+            if (++connection.fadePosition == CROSSFADE_BLOCKS)
+            {
+                // The old session is freed here if this was its last user
+                states->release(connection.fadingState);
+                connection.fadingState = nullptr;
+                connection.fadingModel.reset();
+            }
+        }
+        else if (connection.vad)
+        {
+            InferenceTimer timer(cost);
+            connection.vad->process(session,
+                                    block.data(),
+                                    block.data(),
+                                    block.size(),
+                                    *connection.state);
+        }
+        else
+        {
+            InferenceTimer timer(cost);
+            processBlock(session,
+                         block.data(),
+                         block.data(),
+                         block.size(),
+                         *connection.state);
+        }
+    }
+
+    ModelSlot* models;
+    StatePool* states;
+    SwapPolicy policy;
+    ServerMetrics* metrics;
+    StreamAccounting* accounting;
+    int wakeFd;
+    std::atomic<size_t> switchedStreams{ 0 };
+    std::atomic<bool> firstBlockDone{ false };
+    std::atomic<double> firstBlockMs{ -1.0 };
+    mutable std::mutex queueMutex;
+    std::condition_variable ready;
+    std::deque<Job> queued;
+    bool stopping = false;
+    std::mutex completedMutex;
+    std::vector<Job> completed;
+    std::vector<std::thread> workers;
+};
+
+struct VoiceLoad
+{
+    Connection* connection;
+    std::string voice;
+    std::shared_ptr<const LoadedModel> model; // null if loading failed
+    std::string error;
+};
+
+// Loads voices that are not resident, one at a time (the registry
+// serializes loads anyway), and hands them back to the event loop like the
+// InferencePool does its jobs. Only started with --models.
+class VoiceLoader
+{
+  public:
+    VoiceLoader(ModelRegistry* voices, int wakeFd)
+      : voices(voices)
+      , wakeFd(wakeFd)
+    {
+        if (voices)
+        {
+            thread = std::thread([this] { run(); });
+        }
+    }
+
+    ~VoiceLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    void submit(VoiceLoad load)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queued.push_back(std::move(load));
+        }
+        ready.notify_one();
+    }
+
+    void takeCompleted(std::vector<VoiceLoad>& loads)
+    {
+        std::lock_guard<std::mutex> lock(completedMutex);
+        loads.swap(completed);
+    }
+
+  private:
+    void run()
+    {
+        while (true)
+        {
+            VoiceLoad load;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                ready.wait(lock,
+                           [this] { return stopping || !queued.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                load = std::move(queued.front());
+                queued.pop_front();
+            }
+
+            try
+            {
+                load.model = voices->acquire(load.voice);
+            }
+            catch (const std::exception& e)
+            {
+                load.error = e.what();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(completedMutex);
+                completed.push_back(std::move(load));
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    ModelRegistry* voices;
+    int wakeFd;
+    std::mutex queueMutex;
+    std::condition_variable ready;
+    std::deque<VoiceLoad> queued;
+    bool stopping = false;
+    std::mutex completedMutex;
+    std::vector<VoiceLoad> completed;
+    std::thread thread;
+};
+
+class Server
+{
+  public:
+    using Reloader = std::function<std::shared_ptr<const LoadedModel>()>;
+
+    Server(ModelSlot* models,
+           ModelRegistry* voices,
+           Reloader reload,
+           SwapPolicy policy,
+           StatePool* states,
+           const VadOptions* vadOptions,
+           ServerMetrics* metrics,
+           StreamAccounting* accounting,
+           int listenFd,
+           int signalFd,
+           size_t workers)
+      : models(models)
+      , voices(voices)
+      , reload(std::move(reload))
+      , states(states)
+      , vadOptions(vadOptions)
+      , metrics(metrics)
+      , accounting(accounting)
+      , listenFd(listenFd)
+      , signalFd(signalFd)
+      , epollFd(epoll_create1(EPOLL_CLOEXEC))
+      , wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+      , echo(models == nullptr)
+      , voiceLoader(echo ? nullptr : voices, wakeFd)
+      , pool(models,
+             states,
+             policy,
+             metrics,
+             accounting,
+             workers,
+             wakeFd)
+    {
+        if (epollFd < 0 || wakeFd < 0)
+        {
+            throw std::runtime_error("failed to create epoll / eventfd");
+        }
+        setNonBlocking(listenFd);
+        watch(listenFd, LISTEN_ID, EPOLLIN);
+        watch(wakeFd, WAKE_ID, EPOLLIN);
+        watch(signalFd, SIGNAL_ID, EPOLLIN);
+    }
+
+    ~Server()
+    {
+        if (loader.joinable())
+        {
+            loader.join();
+        }
+        for (auto& entry : connections)
+        {
+            close(entry.second->fd);
+        }
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    void run()
+    {
+        epoll_event events[256];
+        bool running = true;
+        while (running)
+        {
+            int n = epoll_wait(epollFd, events, 256, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::runtime_error(std::string("epoll_wait: ") +
+                                         std::strerror(errno));
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID)
+                {
+                    acceptConnections();
+                }
+                else if (id == WAKE_ID)
+                {
+                    onWake();
+                }
+                else if (id == SIGNAL_ID)
+                {
+                    signalfd_siginfo info;
+                    if (read(signalFd, &info, sizeof(info)) ==
+                          sizeof(info) &&
+                        info.ssi_signo == SIGHUP)
+                    {
+                        startReload();
+                    }
+                    else
+                    {
+                        running = false;
+                    }
+                }
+                else
+                {
+                    onConnectionEvent(id, events[i].events);
+                }
+            }
+        }
+    }
+
+    double firstBlockLatencyMs() const { return pool.firstBlockLatencyMs(); }
+
+    size_t queuedJobs() const { return pool.queuedJobs(); }
+
+    void printStats(size_t topStreams) const
+    {
+        std::cout << "Served " << totalConnections << " connections, "
+                  << totalBlocks << " blocks";
+        if (states)
+        {
+            std::cout << ", peak " << states->peakInUse() << " of "
+                      << states->capacity() << " pooled states";
+        }
+        if (rejectedConnections > 0)
+        {
+            std::cout << ", " << rejectedConnections << " rejected as full";
+        }
+        if (pool.streamsSwitched() > 0)
+        {
+            std::cout << ", " << pool.streamsSwitched()
+                      << " streams switched model";
+        }
+        std::cout << "." << std::endl;
+        if (vadOptions)
+        {
+            std::cout << vadTotals << "." << std::endl;
+        }
+        if (voices)
+        {
+            std::cout << voices->stats() << "." << std::endl;
+        }
+        if (!echo && topStreams > 0)
+        {
+            printHeaviest(topStreams);
+        }
+    }
+
+  private:
+    void printHeaviest(size_t count) const
+    {
+        StreamUsage all = accounting->totals();
+        std::cout << "Inference: " << all.cpuSeconds << " s CPU, "
+                  << all.wallSeconds << " s wall for " << all.audioSeconds
+                  << " s of audio (" << all.averageCpuPerAudioSecond()
+                  << " CPU s per audio s)." << std::endl;
+        for (const StreamUsage& usage : accounting->top(count))
+        {
+            std::cout << "  stream " << usage.id;
+            if (!usage.label.empty())
+            {
+                std::cout << " (" << usage.label << ")";
+            }
+            std::cout << ": " << usage.cpuSeconds << " s CPU, "
+                      << usage.wallSeconds << " s wall, " << usage.blocks
+                      << " blocks, " << usage.averageCpuPerAudioSecond()
+                      << " CPU s per audio s" << std::endl;
+        }
+    }
+
+    // Loads the next model on a background thread and publishes it; the
+    // current model keeps serving if loading or validation fails
+    void startReload()
+    {
+        if (!models || reloading.load())
+        {
+            std::cout << "Ignoring SIGHUP: "
+                      << (models ? "a reload is in progress" : "echo mode")
+                      << "." << std::endl;
+            return;
+        }
+        if (loader.joinable())
+        {
+            loader.join();
+        }
+        reloading = true;
+        loader    = std::thread([this] {
+            try
+            {
+                std::shared_ptr<const LoadedModel> next = reload();
+                models->publish(next);
+                recordModel(*metrics, *next);
+                std::cout << "Switched to model generation " << next->generation
+                          << " (" << next->path << ")." << std::endl;
+                printStartupReport(std::cout, next->startup);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Model reload failed, keeping the current model: "
+                          << e.what() << std::endl;
+            }
+            reloading = false;
+        });
+    }
+
+    void watch(int fd, uint64_t id, uint32_t events)
+    {
+        epoll_event ev{};
+        ev.events   = events;
+        ev.data.u64 = id;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            throw std::runtime_error(std::string("epoll_ctl: ") +
+                                     std::strerror(errno));
+        }
+    }
+
+    void acceptConnections()
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return; // EAGAIN or transient error (e.g. EMFILE)
+            }
+            setNonBlocking(fd);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            auto connection    = std::make_unique<Connection>();
+            connection->id     = nextId++;
+            connection->fd     = fd;
+            connection->state  = echo ? nullptr : states->acquire();
+            connection->model  = echo ? nullptr : models->current();
+            if (!echo && vadOptions)
+            {
+                connection->vad = std::make_unique<VadGate>(*vadOptions);
+            }
+            connection->events = EPOLLIN;
+            watch(fd, connection->id, EPOLLIN);
+            Connection& added = *connection;
+            connections.emplace(connection->id, std::move(connection));
+            ++totalConnections;
+            metrics->connections.add();
+            metrics->activeStreams.set(static_cast<double>(connections.size()));
+
+            if (added.state)
+            {
+                added.account = accounting->open(added.id);
+            }
+            else if (!echo)
+            {
+                ++rejectedConnections;
+                metrics->rejected.add();
+                fail(added, "server is at capacity");
+                update(added);
+            }
+        }
+    }
+
+    void onConnectionEvent(uint64_t id, uint32_t events)
+    {
+        auto it = connections.find(id);
+        if (it == connections.end())
+        {
+            return; // Closed earlier in this batch
+        }
+        Connection& connection = *it->second;
+
+        if (events & (EPOLLERR | EPOLLHUP))
+        {
+            connection.aborted = true;
+        }
+        if (!connection.aborted && (events & EPOLLIN))
+        {
+            onReadable(connection);
+        }
+        if (!connection.aborted && (events & EPOLLOUT))
+        {
+            flush(connection);
+        }
+        dispatch(connection);
+        update(connection);
+    }
+
+    void onReadable(Connection& connection)
+    {
+        char chunk[65536];
+        while (true)
+        {
+            ssize_t n = read(connection.fd, chunk, sizeof(chunk));
+            if (n > 0)
+            {
+                connection.readBuffer.insert(
+                  connection.readBuffer.end(), chunk, chunk + n);
+                continue;
+            }
+            if (n == 0)
+            {
+                connection.draining = true; // Peer finished sending
+            }
+            else if (errno == EINTR)
+            {
+                continue;
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                connection.aborted = true;
+            }
+            break;
+        }
+        parseFrames(connection);
+    }
+
+    void parseFrames(Connection& connection)
+    {
+        std::vector<char>& buffer = connection.readBuffer;
+        size_t offset             = 0;
+        while (buffer.size() - offset >= sizeof(FrameHeader))
+        {
+            FrameHeader header;
+            std::memcpy(&header, buffer.data() + offset, sizeof(header));
+            size_t limit = header.type == FRAME_STATE
+                             ? MAX_STATE_BYTES
+                             : MAX_FRAME_SAMPLES * sizeof(float) + 256;
+            if (header.length > limit)
+            {
+                fail(connection, "frame too large");
+                break;
+            }
+            if (buffer.size() - offset < sizeof(header) + header.length)
+            {
+                break; // Wait for the rest of the payload
+            }
+            const char* payload = buffer.data() + offset + sizeof(header);
+            offset += sizeof(header) + header.length;
+            if (!handleFrame(connection, header, payload))
+            {
+                break;
+            }
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+    }
+
+    bool handleFrame(Connection& connection,
+                     const FrameHeader& header,
+                     const char* payload)
+    {
+        switch (header.type)
+        {
+            case FRAME_HELLO:
+            {
+                HelloPayload hello;
+                if (connection.greeted)
+                {
+                    // A worker may be converting a block with the voice
+                    // and model this would replace
+                    return fail(connection, "duplicate HELLO");
+                }
+                if (header.length < sizeof(hello))
+                {
+                    return fail(connection, "malformed HELLO");
+                }
+                std::memcpy(&hello, payload, sizeof(hello));
+                if (hello.version != LLVC_PROTOCOL_VERSION)
+                {
+                    return fail(connection, "unsupported protocol version");
+                }
+                if (hello.sampleRate != SAMPLE_RATE)
+                {
+                    return fail(connection, "sample rate must be 16000");
+                }
+                size_t nameLength = header.length - sizeof(hello);
+                if (nameLength > 0 && !echo)
+                {
+                    if (!voices)
+                    {
+                        return fail(connection, "voices are not enabled");
+                    }
+                    if (nameLength > MAX_VOICE_NAME)
+                    {
+                        return fail(connection, "voice name too long");
+                    }
+                    connection.voice.assign(payload + sizeof(hello),
+                                            nameLength);
+                    if (connection.account)
+                    {
+                        accounting->setLabel(connection.account,
+                                             connection.voice);
+                    }
+                    // A resident voice is used at once; otherwise AUDIO
+                    // is queued until the loader hands the model back
+                    connection.model = voices->tryAcquire(connection.voice);
+                    if (!connection.model)
+                    {
+                        connection.loadingVoice = true;
+                        VoiceLoad load;
+                        load.connection = &connection;
+                        load.voice      = connection.voice;
+                        voiceLoader.submit(std::move(load));
+                    }
+                }
+                connection.greeted = true;
+                return true;
+            }
+            case FRAME_AUDIO:
+            {
+                size_t samples = header.length / sizeof(float);
+                if (!connection.greeted)
+                {
+                    return fail(connection, "AUDIO before HELLO");
+                }
+                if (header.length % sizeof(float) != 0 || samples == 0 ||
+                    samples > MAX_FRAME_SAMPLES)
+                {
+                    return fail(connection, "malformed AUDIO frame");
+                }
+                std::vector<float> block(samples);
+                std::memcpy(block.data(), payload, header.length);
+                connection.pending.push_back(std::move(block));
+                return true;
+            }
+            case FRAME_STATE:
+            {
+                if (!connection.greeted || !connection.state)
+                {
+                    return fail(connection, "STATE before HELLO or in echo "
+                                            "mode");
+                }
+                if (connection.blocks > 0 || connection.inFlight ||
+                    !connection.pending.empty())
+                {
+                    return fail(connection, "STATE after AUDIO");
+                }
+                try
+                {
+                    restoreState(reinterpret_cast<const uint8_t*>(payload),
+                                 header.length,
+                                 *connection.state);
+                }
+                catch (const std::exception& e)
+                {
+                    return fail(connection, e.what());
+                }
+                return true;
+            }
+            case FRAME_SNAPSHOT:
+            {
+                uint8_t precision = header.length > 0 ? payload[0] : 0;
+                if (!connection.greeted || !connection.state)
+                {
+                    return fail(connection, "SNAPSHOT before HELLO or in "
+                                            "echo mode");
+                }
+                if (header.length > 1 ||
+                    precision >
+                      static_cast<uint8_t>(SnapshotPrecision::Float16))
+                {
+                    return fail(connection, "malformed SNAPSHOT");
+                }
+                // Answered once the AUDIO before it has been converted
+                connection.pending.emplace_back();
+                connection.snapshots.push_back(
+                  static_cast<SnapshotPrecision>(precision));
+                return true;
+            }
+            case FRAME_BYE:
+                connection.draining = true;
+                return false;
+            default:
+                return fail(connection, "unknown frame type");
+        }
+    }
+
+    // Reports the error to the client and closes once it has been sent
+    bool fail(Connection& connection, const std::string& message)
+    {
+        connection.pending.clear();
+        connection.snapshots.clear();
+        connection.draining = true;
+        connection.failed   = true;
+        sendFrame(connection, FRAME_ERROR, message.data(), message.size());
+        return false;
+    }
+
+    void dispatch(Connection& connection)
+    {
+        // The state is the event loop's while no block is in flight
+        while (!connection.inFlight && !connection.aborted &&
+               !connection.pending.empty() &&
+               connection.pending.front().empty())
+        {
+            connection.pending.pop_front();
+            snapshotState(
+              *connection.state, connection.snapshots.front(), snapshotBlob);
+            connection.snapshots.pop_front();
+            sendFrame(connection,
+                      FRAME_STATE,
+                      snapshotBlob.data(),
+                      snapshotBlob.size());
+        }
+        if (connection.inFlight || connection.loadingVoice ||
+            connection.aborted || connection.pending.empty())
+        {
+            return;
+        }
+        Job job;
+        job.connection = &connection;
+        job.block      = std::move(connection.pending.front());
+        connection.pending.pop_front();
+        connection.inFlight = true;
+        pool.submit(std::move(job));
+    }
+
+    void onWake()
+    {
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0)
+        {
+        }
+
+        voiceLoader.takeCompleted(loadedVoices);
+        for (VoiceLoad& load : loadedVoices)
+        {
+            Connection& connection  = *load.connection;
+            connection.loadingVoice = false;
+            if (!load.model)
+            {
+                fail(connection, load.error);
+            }
+            else
+            {
+                connection.model = std::move(load.model);
+            }
+            dispatch(connection);
+            update(connection);
+        }
+        loadedVoices.clear();
+
+        pool.takeCompleted(completed);
+        for (Job& job : completed)
+        {
+            Connection& connection = *job.connection;
+            connection.inFlight    = false;
+            if (!job.error.empty())
+            {
+                fail(connection, "inference failed: " + job.error);
+            }
+            else if (!connection.aborted && !connection.failed)
+            {
+                sendFrame(connection,
+                          FRAME_AUDIO,
+                          job.block.data(),
+                          job.block.size() * sizeof(float));
+                ++connection.blocks;
+                ++totalBlocks;
+            }
+            dispatch(connection);
+            update(connection);
+        }
+        completed.clear();
+    }
+
+    void sendFrame(Connection& connection,
+                   FrameType type,
+                   const void* payload,
+                   size_t length)
+    {
+        FrameHeader header{ type, static_cast<uint32_t>(length) };
+        const char* h = reinterpret_cast<const char*>(&header);
+        const char* p = static_cast<const char*>(payload);
+        connection.writeBuffer.insert(
+          connection.writeBuffer.end(), h, h + sizeof(header));
+        connection.writeBuffer.insert(
+          connection.writeBuffer.end(), p, p + length);
+        flush(connection);
+    }
+
+    void flush(Connection& connection)
+    {
+        std::vector<char>& buffer = connection.writeBuffer;
+        while (connection.writeOffset < buffer.size())
+        {
+            ssize_t n = send(connection.fd,
+                             buffer.data() + connection.writeOffset,
+                             buffer.size() - connection.writeOffset,
+                             MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    connection.aborted = true;
+                }
+                break;
+            }
+            connection.writeOffset += static_cast<size_t>(n);
+        }
+        if (connection.writeOffset == buffer.size())
+        {
+            buffer.clear();
+            connection.writeOffset = 0;
+        }
+    }
+
+    // Recomputes the epoll interest set and closes finished connections
+    void update(Connection& connection)
+    {
+        size_t backlog =
+          connection.writeBuffer.size() - connection.writeOffset;
+        bool finished =
+          !connection.inFlight && !connection.loadingVoice &&
+          (connection.aborted ||
+           (connection.draining && connection.pending.empty() && backlog == 0));
+        if (finished)
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+            close(connection.fd);
+            if (connection.state)
+            {
+                states->release(connection.state);
+            }
+            if (connection.fadingState)
+            {
+                states->release(connection.fadingState);
+            }
+            if (connection.vad)
+            {
+                vadTotals += connection.vad->statistics();
+            }
+            if (connection.account)
+            {
+                accounting->close(connection.account);
+            }
+            connections.erase(connection.id);
+            metrics->activeStreams.set(static_cast<double>(connections.size()));
+            return;
+        }
+
+        // Backpressure: stop reading while the model or the peer is behind
+        uint32_t events = 0;
+        if (!connection.draining && !connection.aborted &&
+            connection.pending.size() < MAX_PENDING_FRAMES &&
+            backlog < MAX_WRITE_BACKLOG)
+        {
+            events |= EPOLLIN;
+        }
+        if (backlog > 0 && !connection.aborted)
+        {
+            events |= EPOLLOUT;
+        }
+        if (events != connection.events)
+        {
+            epoll_event ev{};
+            ev.events   = events;
+            ev.data.u64 = connection.id;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &ev);
+            connection.events = events;
+        }
+    }
+
+    ModelSlot* models;
+    ModelRegistry* voices;
+    Reloader reload;
+    std::atomic<bool> reloading{ false };
+    std::thread loader;
+    StatePool* states;
+    const VadOptions* vadOptions;
+    ServerMetrics* metrics;
+    StreamAccounting* accounting;
+    int listenFd;
+    int signalFd;
+    int epollFd;
+    int wakeFd;
+    bool echo;
+    uint64_t nextId = FIRST_CONNECTION_ID;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    std::vector<Job> completed;
+    std::vector<VoiceLoad> loadedVoices;
+    std::vector<uint8_t> snapshotBlob; // reused for every STATE sent
+    size_t totalConnections    = 0;
+    size_t totalBlocks         = 0;
+    size_t rejectedConnections = 0;
+    VadStats vadTotals;
+    // Declared last so the loader and workers are joined before connections
+    // are freed
+    VoiceLoader voiceLoader;
+    InferencePool pool;
+};
+
+// A positive decimal count with nothing after it
+static bool
+parseCount(const char* text, size_t& count)
+{
+    if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end           = nullptr;
+    errno               = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0)
+    {
+        return false;
+    }
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> <tcp:HOST:PORT|unix:PATH> [--workers N]"
+                     " [--max-streams N] [--huge-pages] [--warmup SIZES]"
+                     " [--swap crossfade|drain] [--vad] [--vad-threshold DBFS]"
+                     " [--models DIR] [--budget MB] [--echo]"
+                     " [--metrics-port PORT] [--metrics-file PATH]"
+                     " [--metrics-interval SECONDS] [--top-streams N]"
+                     " [--mmap]\n"
+                     "SIGHUP reloads the model file without dropping streams."
+                     " Clients naming a voice get DIR/<voice>.onnx; idle"
+                     " voices are evicted beyond the budget (default 512 MB)."
+                     " --mmap keeps weights in a read-only mapping shared by"
+                     " every server process on the host."
+                  << std::endl;
+        return 1;
+    }
+    const char* modelPath = argv[1];
+    std::string endpoint  = argv[2];
+    size_t workers    = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxStreams = 1024;
+    bool hugePages    = false;
+    bool vad          = false; // skip inference on silent blocks
+    bool echo         = false; // return input unchanged, for transport timing
+    VadOptions vadOptions;
+    SwapPolicy swapPolicy = SwapPolicy::Crossfade;
+    std::vector<size_t> warmupSizes = { 1024 };
+    std::string voiceDirectory; // empty: only the default model is served
+    size_t voiceBudgetMb = 512;
+    int metricsPort        = 0; // 0: no HTTP endpoint
+    std::string metricsFile;    // empty: no metrics file
+    double metricsInterval = 10.0;
+    size_t topStreams      = 10; // heaviest streams exported and reported
+    bool mapWeights        = false;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--workers" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], workers))
+            {
+                std::cerr << "--workers must be a positive integer"
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--max-streams" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], maxStreams))
+            {
+                std::cerr << "--max-streams must be a positive integer"
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            // Comma-separated block sizes clients are expected to send
+            warmupSizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string size;
+            size_t samples;
+            while (std::getline(list, size, ','))
+            {
+                if (!parseCount(size.c_str(), samples))
+                {
+                    std::cerr << "--warmup takes positive block sizes"
+                              << std::endl;
+                    return 1;
+                }
+                warmupSizes.push_back(samples);
+            }
+        }
+        else if (arg == "--swap" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value != "crossfade" && value != "drain")
+            {
+                std::cerr << "Unknown swap policy: " << value << std::endl;
+                return 1;
+            }
+            swapPolicy =
+              value == "drain" ? SwapPolicy::Drain : SwapPolicy::Crossfade;
+        }
+        else if (arg == "--models" && i + 1 < argc)
+        {
+            voiceDirectory = argv[++i];
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            voiceBudgetMb = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--huge-pages")
+        {
+            hugePages = true;
+        }
+        else if (arg == "--vad")
+        {
+            vad = true;
+        }
+        else if (arg == "--vad-threshold" && i + 1 < argc)
+        {
+            // Speech ends 6 dB below the onset threshold
+            vadOptions.openDb  = std::strtof(argv[++i], nullptr);
+            vadOptions.closeDb = vadOptions.openDb - 6.0f;
+        }
+        else if (arg == "--echo")
+        {
+            echo = true;
+        }
+        else if (arg == "--metrics-port" && i + 1 < argc)
+        {
+            metricsPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--metrics-file" && i + 1 < argc)
+        {
+            metricsFile = argv[++i];
+        }
+        else if (arg == "--metrics-interval" && i + 1 < argc)
+        {
+            metricsInterval = std::max(0.1, std::atof(argv[++i]));
+        }
+        else if (arg == "--top-streams" && i + 1 < argc)
+        {
+            topStreams = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--mmap")
+        {
+            mapWeights = true;
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // Route SIGINT/SIGTERM/SIGHUP through the event loop; threads inherit
+    // the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+    try
+    {
+        // Set up ONNX Runtime
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_server");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+
+        std::unique_ptr<ModelSlot> models;
+        std::unique_ptr<ModelRegistry> voices;
+        std::unique_ptr<StatePool> states;
+        MetricsRegistry registry;
+        ServerMetrics metrics(registry);
+        StreamAccounting accounting(topStreams);
+        StartupReport startup;
+        uint64_t generation = 1;
+        Server::Reloader reload;
+        if (!echo)
+        {
+            // Nothing is accepted until the model is validated and every
+            // block size is warm
+            std::shared_ptr<const LoadedModel> initial =
+              loadModel(env,
+                        modelPath,
+                        session_options,
+                        warmupSizes,
+                        generation,
+                        mapWeights);
+            startup = initial->startup;
+            printStartupReport(std::cout, startup);
+            recordModel(metrics, *initial);
+            models = std::make_unique<ModelSlot>(std::move(initial));
+            reload = [&] {
+                return loadModel(env,
+                                 modelPath,
+                                 session_options,
+                                 warmupSizes,
+                                 ++generation,
+                                 mapWeights);
+            };
+
+            if (!voiceDirectory.empty())
+            {
+                voices = std::make_unique<ModelRegistry>(
+                  env,
+                  session_options,
+                  voiceDirectory,
+                  voiceBudgetMb * 1024 * 1024,
+                  warmupSizes,
+                  mapWeights);
+                std::cout << "Voices from " << voiceDirectory << ", "
+                          << voiceBudgetMb << " MB budget." << std::endl;
+            }
+
+            // The slab is reserved up front but only touched as slots are used
+            states = std::make_unique<StatePool>(maxStreams, hugePages);
+            std::cout << "State pool: " << maxStreams << " streams x "
+                      << states->bytesPerStream() / 1024 << " KB ("
+                      << (states->hugePages() ? "huge pages" : "regular pages")
+                      << ")." << std::endl;
+        }
+
+        int listenFd = listenOn(endpoint);
+        std::cout << "Listening on " << endpoint << " with " << workers
+                  << " inference threads" << (echo ? " (echo)" : "") << "."
+                  << std::endl;
+
+        {
+            Server server(
+              models.get(),
+              voices.get(),
+              reload,
+              swapPolicy,
+              states.get(),
+              vad ? &vadOptions : nullptr,
+              &metrics,
+              &accounting,
+              listenFd,
+              signalFd,
+              workers);
+
+            // Scrape-time gauges read the server, so the exporter is
+            // created after it and stopped before it
+            registry.gauge("llvc_queue_depth",
+                           "Blocks waiting for an inference thread",
+                           [&server] { return server.queuedJobs(); });
+            registry.gauge(
+              "llvc_inference_seconds_per_audio_second",
+              "Inference time per second of audio since start",
+              [&metrics] {
+                  double audio = metrics.audioSamples.value() /
+                                 static_cast<double>(SAMPLE_RATE);
+                  return audio > 0.0
+                           ? metrics.inferenceMicros.value() / 1e6 / audio
+                           : 0.0;
+              });
+            if (states)
+            {
+                StatePool* pool = states.get();
+                registry.gauge("llvc_state_pool_in_use",
+                               "Pooled stream states in use",
+                               [pool] { return pool->inUse(); });
+                registry.gauge("llvc_state_bytes_per_stream",
+                               "Memory of one stream's pooled state",
+                               [pool] { return pool->bytesPerStream(); });
+            }
+            registry.collector([&accounting, topStreams] {
+                return accounting.render(topStreams);
+            });
+            std::unique_ptr<MetricsExporter> exporter;
+            if (metricsPort > 0 || !metricsFile.empty())
+            {
+                exporter = std::make_unique<MetricsExporter>(
+                  registry, metricsPort, metricsFile, metricsInterval);
+                std::cout << "Metrics on "
+                          << (metricsPort > 0
+                                ? "http://127.0.0.1:" +
+                                    std::to_string(metricsPort) + "/metrics"
+                                : metricsFile)
+                          << "." << std::endl;
+            }
+            server.run();
+            exporter.reset();
+            server.printStats(topStreams);
+            if (models)
+            {
+                startup.firstBlockMs = server.firstBlockLatencyMs();
+                printStartupReport(std::cout, startup);
+            }
+        }
+        close(listenFd);
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "llvc_net.h"
+#include "llvc_protocol.h"
+#include "ShmTransport.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Round-trip cost of one block over the shared-memory transport versus the
+// socket server. Run both daemons with --echo to time the transports alone:
+//
+//   llvc_shm_daemon x --echo --name /llvc &
+//   llvc_server x unix:/tmp/llvc.sock --echo --workers 1 &
+//   llvc_shm_bench --shm /llvc --socket unix:/tmp/llvc.sock
+
+using Clock = std::chrono::steady_clock;
+
+const size_t WARMUP_BLOCKS = 100;
+
+struct Summary
+{
+    double mean = 0.0;
+    double p50  = 0.0;
+    double p99  = 0.0;
+    double max  = 0.0;
+};
+
+static Summary
+summarize(std::vector<double> us)
+{
+    Summary s;
+    if (us.empty())
+    {
+        return s;
+    }
+    std::sort(us.begin(), us.end());
+    for (double v : us)
+    {
+        s.mean += v;
+    }
+    s.mean /= us.size();
+    s.p50 = us[us.size() / 2];
+    s.p99 = us[std::min(us.size() - 1, us.size() * 99 / 100)];
+    s.max = us.back();
+    return s;
+}
+
+static void
+printSummary(const char* name, const Summary& s)
+{
+    std::cout << "  " << name << ": mean " << s.mean << " us, p50 " << s.p50
+              << " us, p99 " << s.p99 << " us, max " << s.max << " us"
+              << std::endl;
+}
+
+static std::vector<double>
+benchShm(const std::string& name, size_t blocks)
+{
+    ShmStreamClient client(name);
+    std::vector<double> us;
+    us.reserve(blocks);
+
+    for (size_t b = 0; b < WARMUP_BLOCKS + blocks; ++b)
+    {
+        auto start = Clock::now();
+        float* in  = client.acquireInput();
+        if (!in)
+        {
+            throw std::runtime_error("shm input ring unexpectedly full");
+        }
+        std::fill(in, in + client.blockSize(), 0.01f * (b % 100));
+        client.submitInput();
+        if (!client.waitOutput(1000))
+        {
+            throw std::runtime_error("shm daemon did not answer");
+        }
+        client.releaseOutput();
+        if (b >= WARMUP_BLOCKS)
+        {
+            us.push_back(std::chrono::duration<double, std::micro>(
+                           Clock::now() - start)
+                           .count());
+        }
+    }
+    return us;
+}
+
+static std::vector<double>
+benchSocket(const std::string& endpoint, size_t blockSize, size_t blocks)
+{
+    int fd = connectTo(endpoint);
+    FrameHeader header{ FRAME_HELLO, sizeof(HelloPayload) };
+    HelloPayload hello{ LLVC_PROTOCOL_VERSION, 16000 };
+    writeFully(fd, &header, sizeof(header));
+    writeFully(fd, &hello, sizeof(hello));
+
+    std::vector<float> block(blockSize);
+    std::vector<double> us;
+    us.reserve(blocks);
+
+    for (size_t b = 0; b < WARMUP_BLOCKS + blocks; ++b)
+    {
+        auto start = Clock::now();
+        std::fill(block.begin(), block.end(), 0.01f * (b % 100));
+        FrameHeader audio{ FRAME_AUDIO,
+                           static_cast<uint32_t>(blockSize * sizeof(float)) };
+        FrameHeader reply;
+        if (!writeFully(fd, &audio, sizeof(audio)) ||
+            !writeFully(fd, block.data(), audio.length) ||
+            !readFully(fd, &reply, sizeof(reply)) ||
+            reply.type != FRAME_AUDIO || reply.length != audio.length ||
+            !readFully(fd, block.data(), reply.length))
+        {
+            throw std::runtime_error("socket server did not answer");
+        }
+        if (b >= WARMUP_BLOCKS)
+        {
+            us.push_back(std::chrono::duration<double, std::micro>(
+                           Clock::now() - start)
+                           .count());
+        }
+    }
+
+    FrameHeader bye{ FRAME_BYE, 0 };
+    writeFully(fd, &bye, sizeof(bye));
+    close(fd);
+    return us;
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string shmName;
+    std::string socketEndpoint;
+    size_t blocks    = 5000;
+    size_t blockSize = 1024;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--shm" && i + 1 < argc)
+        {
+            shmName = argv[++i];
+        }
+        else if (arg == "--socket" && i + 1 < argc)
+        {
+            socketEndpoint = argv[++i];
+        }
+        else if (arg == "--blocks" && i + 1 < argc)
+        {
+            blocks = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            blockSize = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--shm NAME] [--socket tcp:HOST:PORT|unix:PATH]"
+                         " [--blocks N] [--block SAMPLES]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (shmName.empty() && socketEndpoint.empty())
+    {
+        std::cerr << "Nothing to measure: pass --shm and/or --socket."
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        if (!shmName.empty())
+        {
+            // The shm segment fixes the block size for both transports
+            blockSize = ShmStreamClient(shmName).blockSize();
+        }
+        std::cout << "Round trip of one " << blockSize << "-sample block, "
+                  << blocks << " blocks:" << std::endl;
+
+        Summary shm;
+        Summary socket;
+        if (!shmName.empty())
+        {
+            shm = summarize(benchShm(shmName, blocks));
+            printSummary("shared memory", shm);
+        }
+        if (!socketEndpoint.empty())
+        {
+            socket = summarize(benchSocket(socketEndpoint, blockSize, blocks));
+            printSummary("socket", socket);
+        }
+        if (!shmName.empty() && !socketEndpoint.empty())
+        {
+            std::cout << "Shared memory saves " << socket.mean - shm.mean
+                      << " us per block on average ("
+                      << socket.mean / std::max(shm.mean, 1e-9) << "x)."
+                      << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,305 @@
+#include "llvc.h"
+#include "ShmTransport.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Conversion daemon for the shared-memory transport. Each worker thread
+// owns every slot whose index maps to it, converts blocks straight from the
+// slot's input ring into its output ring, and sleeps on its own doorbell
+// when no stream has work. Once a second, an idle worker checks that the
+// clients of its slots are still alive and frees the slots of dead ones.
+
+static std::atomic<bool> running(true);
+
+const auto OWNER_CHECK_INTERVAL = std::chrono::seconds(1);
+
+static void
+onSignal(int)
+{
+    running.store(false);
+}
+
+struct DaemonOptions
+{
+    std::string name    = "/llvc";
+    uint32_t streams    = 64;
+    uint32_t blockSize  = 1024;
+    uint32_t ringBlocks = 8;
+    uint32_t workers    = 1;
+    bool echo           = false; // copy input to output, for transport timing
+};
+
+// True once the client that attached the slot has exited. A slot whose
+// owner is not recorded yet, or who belongs to another user, counts as alive.
+static bool
+ownerGone(const ShmSlot& slot)
+{
+    int32_t pid = slot.owner.load(std::memory_order_acquire);
+    return pid > 0 && kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+// A positive decimal count with nothing after it that fits the segment
+// header
+static bool
+parseCount(const char* text, uint32_t& count)
+{
+    if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end           = nullptr;
+    errno               = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0 || value > UINT32_MAX)
+    {
+        return false;
+    }
+    count = static_cast<uint32_t>(value);
+    return true;
+}
+
+static void
+workerLoop(const ShmSegment& segment,
+           uint32_t worker,
+           Ort::Session* session,
+           size_t& blocksDone)
+{
+    const ShmHeader& header = segment.header();
+    ShmDoorbell& bell       = segment.header().workerBells[worker];
+    std::vector<std::unique_ptr<StreamState>> states(header.maxStreams);
+    auto nextOwnerCheck = std::chrono::steady_clock::now();
+    bool checkOwners    = false;
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        uint32_t seen = bell.sequence.load();
+        bool didWork  = false;
+
+        for (uint32_t i = worker; i < header.maxStreams; i += header.workers)
+        {
+            ShmSlot& slot = segment.slot(i);
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+
+            if (state == SLOT_ATTACHED && checkOwners && ownerGone(slot))
+            {
+                std::cerr << "Stream " << i << ": client " << slot.owner.load()
+                          << " exited without detaching." << std::endl;
+                state = SLOT_DETACHING;
+            }
+            if (state == SLOT_DETACHING)
+            {
+                states[i].reset();
+                slot.owner.store(0, std::memory_order_relaxed);
+                slot.input.head.store(0, std::memory_order_relaxed);
+                slot.input.tail.store(0, std::memory_order_relaxed);
+                slot.output.head.store(0, std::memory_order_relaxed);
+                slot.output.tail.store(0, std::memory_order_relaxed);
+                slot.state.store(SLOT_FREE, std::memory_order_release);
+                continue;
+            }
+            if (state != SLOT_ATTACHED)
+            {
+                continue;
+            }
+            if (!states[i] && session)
+            {
+                states[i] = std::make_unique<StreamState>(createStreamState());
+            }
+
+            // Convert every block that has both input and output room
+            ShmRing& input  = slot.input;
+            ShmRing& output = slot.output;
+            while (true)
+            {
+                uint64_t inHead  = input.head.load(std::memory_order_relaxed);
+                uint64_t outTail = output.tail.load(std::memory_order_relaxed);
+                if (input.tail.load(std::memory_order_acquire) == inHead ||
+                    outTail - output.head.load(std::memory_order_acquire) ==
+                      header.ringBlocks)
+                {
+                    break;
+                }
+
+                const float* in = segment.inputBlock(i, inHead);
+                float* out      = segment.outputBlock(i, outTail);
+                if (!session)
+                {
+                    std::memcpy(out, in, header.blockSize * sizeof(float));
+                }
+                else
+                {
+                    try
+                    {
+                        processBlock(
+                          *session, in, out, header.blockSize, *states[i]);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "Stream " << i << ": " << e.what()
+                                  << std::endl;
+                        std::fill(out, out + header.blockSize, 0.0f);
+                        // The failed Run took the state tensors with it;
+                        // the stream restarts from silence
+                        states[i] =
+                          std::make_unique<StreamState>(createStreamState());
+                    }
+                }
+
+                input.head.store(inHead + 1, std::memory_order_release);
+                output.tail.store(outTail + 1, std::memory_order_release);
+                ringDoorbell(slot.clientBell);
+                ++blocksDone;
+                didWork = true;
+            }
+        }
+
+        // Only idle passes check, so a busy worker makes no extra syscalls
+        checkOwners = false;
+        if (!didWork)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextOwnerCheck)
+            {
+                checkOwners    = true;
+                nextOwnerCheck = now + OWNER_CHECK_INTERVAL;
+                continue;
+            }
+            waitDoorbell(bell, seen, 100);
+        }
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx> [--name /llvc] [--streams N] [--block N]"
+                     " [--ring BLOCKS] [--workers N] [--echo]"
+                  << std::endl;
+        return 1;
+    }
+
+    const char* modelPath = argv[1];
+    DaemonOptions options;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool valid      = true;
+        if (arg == "--name" && i + 1 < argc)
+        {
+            options.name = argv[++i];
+        }
+        else if (arg == "--streams" && i + 1 < argc)
+        {
+            valid = parseCount(argv[++i], options.streams);
+        }
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            valid = parseCount(argv[++i], options.blockSize);
+        }
+        else if (arg == "--ring" && i + 1 < argc)
+        {
+            valid = parseCount(argv[++i], options.ringBlocks);
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            valid = parseCount(argv[++i], options.workers) &&
+                    options.workers <= SHM_MAX_WORKERS;
+        }
+        else if (arg == "--echo")
+        {
+            options.echo = true;
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << arg << " must be a positive integer"
+                      << (arg == "--workers"
+                            ? " up to " + std::to_string(SHM_MAX_WORKERS)
+                            : std::string())
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    try
+    {
+        // Set up ONNX Runtime
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_shm_daemon");
+        std::unique_ptr<Ort::Session> session;
+        if (!options.echo)
+        {
+            Ort::SessionOptions session_options;
+            session_options.SetIntraOpNumThreads(1);
+            session_options.SetGraphOptimizationLevel(
+              GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+            session =
+              std::make_unique<Ort::Session>(env, modelPath, session_options);
+        }
+
+        ShmSegment segment = ShmSegment::create(options.name,
+                                                options.streams,
+                                                options.blockSize,
+                                                options.ringBlocks,
+                                                options.workers);
+        std::cout << "Serving " << options.streams << " streams on "
+                  << options.name << " (" << options.blockSize
+                  << "-sample blocks, " << options.workers << " workers"
+                  << (options.echo ? ", echo" : "") << ")." << std::endl;
+
+        std::vector<size_t> blocksDone(options.workers, 0);
+        std::vector<std::thread> workers;
+        for (uint32_t w = 0; w < options.workers; ++w)
+        {
+            workers.emplace_back([&, w] {
+                workerLoop(segment, w, session.get(), blocksDone[w]);
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        size_t total = 0;
+        for (size_t done : blocksDone)
+        {
+            total += done;
+        }
+        std::cout << "Converted " << total << " blocks." << std::endl;
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
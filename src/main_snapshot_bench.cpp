@@ -0,0 +1,236 @@
+#include "llvc.h"
+#include "StateSnapshot.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures the cost of snapshotting and restoring a stream's state. With a
+// model, the state comes from converting a few seconds of synthetic audio
+// and the effect of an fp16 round trip on the following output is reported.
+
+using Clock = std::chrono::steady_clock;
+
+const int WARM_BLOCKS   = 50;
+const int FOLLOW_BLOCKS = 20;
+const size_t BLOCK_SIZE = 1024;
+
+static double
+timeMicros(int iterations, const std::function<void()>& fn)
+{
+    fn(); // first touch outside the measurement
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        fn();
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start)
+             .count() /
+           iterations;
+}
+
+static void
+fillBlock(std::vector<float>& block, int index)
+{
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        double t = static_cast<double>(index * block.size() + i) / SAMPLE_RATE;
+        block[i] = static_cast<float>(0.3 * std::sin(2 * M_PI * 140.0 * t) +
+                                      0.1 * std::sin(2 * M_PI * 430.0 * t));
+    }
+}
+
+static void
+fillRandom(Ort::Value& tensor, std::mt19937& rng)
+{
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    float* data  = tensor.GetTensorMutableData<float>();
+    size_t count = tensor.GetTensorTypeAndShapeInfo().GetElementCount();
+    for (size_t i = 0; i < count; ++i)
+    {
+        data[i] = dist(rng);
+    }
+}
+
+static float
+maxAbsDiff(const Ort::Value& a, const Ort::Value& b)
+{
+    const float* x = a.GetTensorData<float>();
+    const float* y = b.GetTensorData<float>();
+    size_t count   = a.GetTensorTypeAndShapeInfo().GetElementCount();
+    float diff     = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        diff = std::max(diff, std::fabs(x[i] - y[i]));
+    }
+    return diff;
+}
+
+static void
+printRow(const char* name, double us, size_t bytes)
+{
+    std::cout << "  " << name << ": " << us << " us ("
+              << bytes / us << " MB/s)" << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* modelPath = nullptr;
+    int iterations        = 200;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc)
+        {
+            const char* text = argv[++i];
+            char* end        = nullptr;
+            long value       = std::strtol(text, &end, 10);
+            if (end == text || *end != '\0' || value <= 0 ||
+                value > 1000000000)
+            {
+                std::cerr << "--iterations must be a positive integer"
+                          << std::endl;
+                return 1;
+            }
+            iterations = static_cast<int>(value);
+        }
+        else if (!modelPath)
+        {
+            modelPath = argv[i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [model.onnx] [--iterations N]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_snapshot_bench");
+        std::unique_ptr<Ort::Session> session;
+        StreamState state = createStreamState();
+        std::vector<float> block(BLOCK_SIZE);
+
+        if (modelPath)
+        {
+            Ort::SessionOptions session_options;
+            session_options.SetIntraOpNumThreads(1);
+            session_options.SetGraphOptimizationLevel(
+              GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+            session =
+              std::make_unique<Ort::Session>(env, modelPath, session_options);
+            for (int b = 0; b < WARM_BLOCKS; ++b)
+            {
+                fillBlock(block, b);
+                processBlock(*session, block, state);
+            }
+        }
+        else
+        {
+            // Without a model, random data stands in for a warmed-up state
+            std::mt19937 rng(42);
+            fillRandom(*state.enc_buf_tensor, rng);
+            fillRandom(*state.dec_buf_tensor, rng);
+            fillRandom(*state.out_buf_tensor, rng);
+            fillRandom(*state.convnet_pre_ctx_tensor, rng);
+        }
+
+        std::vector<uint8_t> blob32;
+        std::vector<uint8_t> blob16;
+        snapshotState(state, SnapshotPrecision::Float32, blob32);
+        snapshotState(state, SnapshotPrecision::Float16, blob16);
+        StreamState target = createStreamState();
+
+        std::cout << "State snapshot: " << blob32.size() / 1024.0
+                  << " KB as fp32, " << blob16.size() / 1024.0
+                  << " KB as fp16 (" << iterations << " iterations)"
+                  << std::endl;
+
+        printRow("snapshot fp32",
+                 timeMicros(iterations,
+                            [&] {
+                                snapshotState(
+                                  state, SnapshotPrecision::Float32, blob32);
+                            }),
+                 blob32.size());
+        printRow("snapshot fp16",
+                 timeMicros(iterations,
+                            [&] {
+                                snapshotState(
+                                  state, SnapshotPrecision::Float16, blob16);
+                            }),
+                 blob16.size());
+        printRow("restore fp32 in place",
+                 timeMicros(iterations,
+                            [&] {
+                                restoreState(
+                                  blob32.data(), blob32.size(), target);
+                            }),
+                 blob32.size());
+        printRow("restore fp16 in place",
+                 timeMicros(iterations,
+                            [&] {
+                                restoreState(
+                                  blob16.data(), blob16.size(), target);
+                            }),
+                 blob16.size());
+        printRow("restore fp32 into new state",
+                 timeMicros(iterations,
+                            [&] {
+                                StreamState fresh =
+                                  restoreState(blob32.data(), blob32.size());
+                            }),
+                 blob32.size());
+
+        restoreState(blob16.data(), blob16.size(), target);
+        std::cout << "fp16 round trip max error: enc_buf "
+                  << maxAbsDiff(*state.enc_buf_tensor, *target.enc_buf_tensor)
+                  << ", dec_buf "
+                  << maxAbsDiff(*state.dec_buf_tensor, *target.dec_buf_tensor)
+                  << std::endl;
+
+        if (session)
+        {
+            // Continue the original stream and the fp16-restored copy side
+            // by side to see whether compression is audible
+            std::vector<float> reference(BLOCK_SIZE);
+            float worst = 0.0f;
+            for (int b = 0; b < FOLLOW_BLOCKS; ++b)
+            {
+                fillBlock(block, WARM_BLOCKS + b);
+                reference = block;
+                processBlock(*session, reference, state);
+                processBlock(*session, block, target);
+                for (size_t i = 0; i < BLOCK_SIZE; ++i)
+                {
+                    worst = std::max(worst, std::fabs(reference[i] - block[i]));
+                }
+            }
+            std::cout << "Output deviation after fp16 restore over "
+                      << FOLLOW_BLOCKS << " blocks: max |diff| " << worst
+                      << " (" << 20.0 * std::log10(std::max(worst, 1e-12f))
+                      << " dBFS)" << std::endl;
+        }
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
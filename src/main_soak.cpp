@@ -0,0 +1,388 @@
+#include "llvc.h"
+#include "OnnxGraph.h"
+#include "myk_tiny.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Soak test: streams hours of audio through one long-lived stream as fast
+// as the converter allows (an accelerated clock: "time" below is audio
+// time), and samples memory and block latency once per window. After the
+// warm-up windows the first window is the baseline; the run fails if RSS
+// later grows past it by more than --max-growth-mb or the last window's
+// p99 latency exceeds the baseline p99 by more than --max-drift percent.
+
+using Clock = std::chrono::steady_clock;
+
+struct Window
+{
+    double audioMinutes = 0.0; // at the end of the window
+    double wallSeconds  = 0.0;
+    double p50Ms        = 0.0;
+    double p99Ms        = 0.0;
+    double maxMs        = 0.0;
+    size_t rssBytes     = 0;
+    size_t heapBytes    = 0; // obtained from the kernel by malloc
+    size_t heapFree     = 0; // of which free: fragmentation shows up here
+};
+
+static size_t
+residentBytes()
+{
+    long pages = 0;
+    long rss   = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+    {
+        if (std::fscanf(statm, "%ld %ld", &pages, &rss) != 2)
+        {
+            rss = 0;
+        }
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(rss) * sysconf(_SC_PAGESIZE);
+}
+
+// malloc's view of the heap, which ORT's CPU arena allocates from; the
+// arena's own counters are not exposed through the C++ API
+static void
+sampleHeap(Window& window)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    window.heapBytes      = info.arena + info.hblkhd;
+    window.heapFree       = info.fordblks;
+#else
+    (void)window;
+#endif
+}
+
+static double
+percentile(std::vector<double>& values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static std::vector<std::string>
+findAudio(const std::vector<std::string>& paths)
+{
+    std::vector<std::string> files;
+    for (const std::string& path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto& entry : fs::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".wav")
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+// A minute of two tones and a little noise, for runs without test audio
+static std::vector<float>
+syntheticAudio()
+{
+    std::vector<float> audio(60 * SAMPLE_RATE);
+    unsigned seed = 1;
+    for (size_t i = 0; i < audio.size(); ++i)
+    {
+        seed         = seed * 1103515245u + 12345u;
+        double t     = static_cast<double>(i) / SAMPLE_RATE;
+        double noise = 0.02 * ((seed >> 16 & 0x7fff) / 32767.0 - 0.5);
+        audio[i] = static_cast<float>(0.3 * std::sin(2 * M_PI * 140.0 * t) +
+                                      0.1 * std::sin(2 * M_PI * 430.0 * t) +
+                                      noise);
+    }
+    return audio;
+}
+
+static void
+printWindow(const Window& window)
+{
+    std::cout << std::fixed << std::setprecision(1) << std::setw(9)
+              << window.audioMinutes << std::setw(9) << window.wallSeconds
+              << std::setprecision(3) << std::setw(10) << window.p50Ms
+              << std::setw(10) << window.p99Ms << std::setw(10)
+              << window.maxMs << std::setprecision(1) << std::setw(10)
+              << window.rssBytes / 1048576.0 << std::setw(10)
+              << window.heapBytes / 1048576.0 << std::setw(10)
+              << window.heapFree / 1048576.0 << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string modelPath;
+    std::vector<std::string> inputs;
+    std::string csvPath;
+    bool syntheticModel  = false;
+    bool tone            = false;
+    size_t blockSize     = 1024;
+    double hours         = 4.0;  // of audio
+    double windowMinutes = 10.0; // of audio
+    size_t warmupWindows = 1;
+    double maxGrowthMb   = 16.0;
+    double maxDrift      = 25.0; // percent
+    bool usage           = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue   = i + 1 < argc;
+        if (arg == "--synthetic-model")
+        {
+            syntheticModel = true;
+        }
+        else if (arg == "--tone")
+        {
+            tone = true;
+        }
+        else if (arg == "--block" && hasValue)
+        {
+            blockSize = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--hours" && hasValue)
+        {
+            hours = std::atof(argv[++i]);
+        }
+        else if (arg == "--window-minutes" && hasValue)
+        {
+            windowMinutes = std::atof(argv[++i]);
+        }
+        else if (arg == "--warmup-windows" && hasValue)
+        {
+            warmupWindows = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-growth-mb" && hasValue)
+        {
+            maxGrowthMb = std::atof(argv[++i]);
+        }
+        else if (arg == "--max-drift" && hasValue)
+        {
+            maxDrift = std::atof(argv[++i]);
+        }
+        else if (arg == "--csv" && hasValue)
+        {
+            csvPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage = true;
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+    // Without --synthetic-model the first path is the model
+    if (!syntheticModel && !inputs.empty())
+    {
+        modelPath = inputs.front();
+        inputs.erase(inputs.begin());
+    }
+    if (usage || (modelPath.empty() && !syntheticModel) || blockSize == 0 ||
+        hours <= 0.0 || windowMinutes <= 0.0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.onnx>|--synthetic-model [AUDIO.wav|DIR ...]"
+                     " [--tone] [--block N] [--hours H]"
+                     " [--window-minutes M] [--warmup-windows W]"
+                     " [--max-growth-mb MB] [--max-drift PERCENT]"
+                     " [--csv OUT.csv]\n"
+                     "Audio defaults to test_audio/, looped; --tone uses a"
+                     " generated signal instead."
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        std::vector<float> audio;
+        if (tone)
+        {
+            audio = syntheticAudio();
+        }
+        else
+        {
+            if (inputs.empty())
+            {
+                inputs.push_back("test_audio");
+            }
+            for (const std::string& file : findAudio(inputs))
+            {
+                std::vector<float> samples = myk_tiny::loadWav(file);
+                audio.insert(audio.end(), samples.begin(), samples.end());
+            }
+        }
+        if (audio.size() < blockSize)
+        {
+            std::cerr << "Less than one block of audio found." << std::endl;
+            return 1;
+        }
+
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_soak");
+        Ort::SessionOptions session_options;
+        session_options.SetIntraOpNumThreads(1);
+        session_options.SetGraphOptimizationLevel(
+          GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        std::unique_ptr<Ort::Session> session;
+        if (syntheticModel)
+        {
+            std::string model = syntheticOnnxModel(
+              std::vector<std::string>(std::begin(INPUT_NAMES),
+                                       std::end(INPUT_NAMES)),
+              std::vector<std::string>(std::begin(OUTPUT_NAMES),
+                                       std::end(OUTPUT_NAMES)));
+            session = std::make_unique<Ort::Session>(
+              env, model.data(), model.size(), session_options);
+        }
+        else
+        {
+            session = std::make_unique<Ort::Session>(
+              env, modelPath.c_str(), session_options);
+        }
+
+        std::ofstream csv;
+        if (!csvPath.empty())
+        {
+            csv.open(csvPath);
+            csv << "audio_minutes,wall_seconds,p50_ms,p99_ms,max_ms,"
+                   "rss_bytes,heap_bytes,heap_free_bytes\n";
+        }
+
+        const double blockSeconds =
+          static_cast<double>(blockSize) / SAMPLE_RATE;
+        const size_t windowBlocks = std::max<size_t>(
+          1, static_cast<size_t>(windowMinutes * 60.0 / blockSeconds));
+        // Whole windows only, so every sample covers the same audio time
+        const size_t windowCount =
+          static_cast<size_t>(std::ceil(hours * 60.0 / windowMinutes));
+        const size_t totalBlocks = windowCount * windowBlocks;
+
+        std::cout << "Soaking " << hours << " h of audio in "
+                  << windowMinutes << "-minute windows, " << blockSize
+                  << "-sample blocks" << std::endl;
+        std::cout << "  audio_m   wall_s    p50_ms    p99_ms    max_ms"
+                     "    rss_mb   heap_mb   free_mb"
+                  << std::endl;
+
+        StreamState state = createStreamState();
+        std::vector<float> block(blockSize);
+        std::vector<double> latencies;
+        latencies.reserve(windowBlocks);
+        std::vector<Window> windows;
+        size_t cursor = 0;
+        auto start    = Clock::now();
+        for (size_t b = 1; b <= totalBlocks; ++b)
+        {
+            // Loop the audio, wrapping mid-block where it runs out
+            for (size_t i = 0; i < blockSize; ++i)
+            {
+                block[i] = audio[cursor];
+                cursor   = cursor + 1 == audio.size() ? 0 : cursor + 1;
+            }
+            auto before = Clock::now();
+            processBlock(*session, block, state);
+            latencies.push_back(
+              std::chrono::duration<double, std::milli>(Clock::now() - before)
+                .count());
+
+            if (b % windowBlocks != 0)
+            {
+                continue;
+            }
+            Window window;
+            window.audioMinutes = b * blockSeconds / 60.0;
+            window.wallSeconds =
+              std::chrono::duration<double>(Clock::now() - start).count();
+            window.p50Ms    = percentile(latencies, 0.5);
+            window.p99Ms    = percentile(latencies, 0.99);
+            window.maxMs    = *std::max_element(latencies.begin(),
+                                                 latencies.end());
+            window.rssBytes = residentBytes();
+            sampleHeap(window);
+            latencies.clear();
+            windows.push_back(window);
+            printWindow(window);
+            if (csv.is_open())
+            {
+                csv << window.audioMinutes << "," << window.wallSeconds << ","
+                    << window.p50Ms << "," << window.p99Ms << ","
+                    << window.maxMs << "," << window.rssBytes << ","
+                    << window.heapBytes << "," << window.heapFree << "\n";
+                csv.flush();
+            }
+        }
+
+        if (windows.size() < warmupWindows + 2)
+        {
+            std::cerr << "Too few windows after warm-up to judge drift; run"
+                         " longer or use shorter windows."
+                      << std::endl;
+            return 1;
+        }
+        const Window& baseline = windows[warmupWindows];
+        const Window& last     = windows.back();
+        size_t peakRss         = baseline.rssBytes;
+        for (size_t w = warmupWindows; w < windows.size(); ++w)
+        {
+            peakRss = std::max(peakRss, windows[w].rssBytes);
+        }
+        double growthMb = (peakRss - baseline.rssBytes) / 1048576.0;
+        double driftPct = baseline.p99Ms > 0.0
+                            ? 100.0 * (last.p99Ms / baseline.p99Ms - 1.0)
+                            : 0.0;
+        double realtime = last.audioMinutes * 60.0 / last.wallSeconds;
+
+        bool grew    = growthMb > maxGrowthMb;
+        bool drifted = driftPct > maxDrift;
+        std::cout << std::setprecision(1) << "\n"
+                  << last.audioMinutes / 60.0 << " h of audio in "
+                  << last.wallSeconds << " s (" << realtime
+                  << "x real time)\n"
+                  << "RSS growth after warm-up: " << growthMb << " MB (limit "
+                  << maxGrowthMb << ")" << (grew ? "  FAIL" : "") << "\n"
+                  << std::setprecision(3) << "p99 " << baseline.p99Ms
+                  << " -> " << last.p99Ms << " ms: " << std::setprecision(1)
+                  << driftPct << "% drift (limit " << maxDrift << "%)"
+                  << (drifted ? "  FAIL" : "") << std::endl;
+        return grew || drifted ? 1 : 0;
+    }
+    catch (const Ort::Exception& exception)
+    {
+        std::cerr << "ONNX Runtime error: " << exception.what() << std::endl;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << "An error occurred: " << exception.what() << std::endl;
+    }
+    return 1;
+}
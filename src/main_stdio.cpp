@@ -0,0 +1,397 @@
+#include "llvc.h"
+#include "NativeEngine.h"
+#include "NativeKernels.h"
+#include "StreamingConverter.h"
+#include "VadGate.h"
+#include <onnxruntime_cxx_api.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Streams raw 16 kHz mono PCM from stdin (or a FIFO) through the converter
+// and writes each converted block to stdout as soon as it is ready, e.g.
+//
+//   ffmpeg -i in.mp3 -f s16le -ac 1 -ar 16000 - |
+//     llvc_stdio model.onnx | sox -t s16 -r 16000 -c 1 - out.wav
+//
+// --backend native runs the model on NativeEngine instead of ONNX Runtime.
+// With ONNX Runtime, blocks of 256, 512 or 1024 samples go through a
+// BlockConverter (StreamingConverter.h); other sizes use processBlock.
+
+enum class SampleFormat
+{
+    S16LE,
+    F32LE
+};
+
+const int PIPE_BUFFER_BYTES = 1 << 20;
+
+// Grows the kernel pipe buffer so a bursty upstream producer does not stall
+// on us; silently ignored for regular files and ttys.
+static void
+growPipeBuffer(int fd)
+{
+#ifdef F_SETPIPE_SZ
+    fcntl(fd, F_SETPIPE_SZ, PIPE_BUFFER_BYTES);
+#else
+    (void)fd;
+#endif
+}
+
+// Reads until `size` bytes arrived or EOF. Returns the bytes read.
+static size_t
+readFully(int fd, char* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n == 0)
+        {
+            break; // EOF
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::runtime_error(std::string("read failed: ") +
+                                     std::strerror(errno));
+        }
+        done += static_cast<size_t>(n);
+    }
+    return done;
+}
+
+// Returns false once the reader on the other end has gone away.
+static bool
+writeFully(int fd, const char* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = write(fd, data + done, size - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EPIPE)
+            {
+                return false;
+            }
+            throw std::runtime_error(std::string("write failed: ") +
+                                     std::strerror(errno));
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void
+decodeSamples(const char* raw,
+              size_t count,
+              SampleFormat format,
+              std::vector<float>& block)
+{
+    if (format == SampleFormat::F32LE)
+    {
+        std::memcpy(block.data(), raw, count * sizeof(float));
+        return;
+    }
+    const int16_t* in = reinterpret_cast<const int16_t*>(raw);
+    for (size_t i = 0; i < count; ++i)
+    {
+        block[i] = in[i] / 32768.0f;
+    }
+}
+
+static void
+encodeSamples(const std::vector<float>& block,
+              size_t count,
+              SampleFormat format,
+              char* raw)
+{
+    if (format == SampleFormat::F32LE)
+    {
+        std::memcpy(raw, block.data(), count * sizeof(float));
+        return;
+    }
+    int16_t* out = reinterpret_cast<int16_t*>(raw);
+    for (size_t i = 0; i < count; ++i)
+    {
+        float s = std::min(1.0f, std::max(-1.0f, block[i]));
+        out[i]  = static_cast<int16_t>(std::lrintf(s * 32767.0f));
+    }
+}
+
+static void
+printUsage(const char* argv0)
+{
+    std::cerr << "Usage: " << argv0
+              << " <model.onnx> [--format s16le|f32le] [--block N]"
+                 " [--in PATH] [--out PATH] [--vad] [--vad-threshold DBFS]"
+                 " [--backend ort|native]\n"
+                 "Reads raw 16 kHz mono PCM from stdin (or --in) and writes "
+                 "converted PCM to stdout (or --out). The native backend "
+                 "needs a build with LLVC_NATIVE_ARCH=ON to use AVX2."
+              << std::endl;
+}
+
+// A positive decimal count with nothing after it
+static bool
+parseCount(const char* text, size_t& count)
+{
+    if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end           = nullptr;
+    errno               = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0)
+    {
+        return false;
+    }
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char* modelPath = argv[1];
+    SampleFormat format   = SampleFormat::S16LE;
+    size_t blockSize      = 1024;
+    const char* inPath    = nullptr;
+    const char* outPath   = nullptr;
+    bool vad              = false; // skip inference on silent blocks
+    bool native           = false; // NativeEngine instead of ORT
+    VadOptions vadOptions;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "s16le")
+            {
+                format = SampleFormat::S16LE;
+            }
+            else if (value == "f32le")
+            {
+                format = SampleFormat::F32LE;
+            }
+            else
+            {
+                std::cerr << "Unknown format: " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], blockSize))
+            {
+                std::cerr << "Block size must be a positive integer."
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--in" && i + 1 < argc)
+        {
+            inPath = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if (arg == "--vad")
+        {
+            vad = true;
+        }
+        else if (arg == "--backend" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "native")
+            {
+                native = true;
+            }
+            else if (value != "ort")
+            {
+                std::cerr << "Unknown backend: " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--vad-threshold" && i + 1 < argc)
+        {
+            vadOptions.openDb  = std::strtof(argv[++i], nullptr);
+            vadOptions.closeDb = vadOptions.openDb - 6.0f;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // A closed downstream pipe is reported through EPIPE instead
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int inFd  = STDIN_FILENO;
+    int outFd = STDOUT_FILENO;
+    if (inPath && (inFd = open(inPath, O_RDONLY)) < 0)
+    {
+        std::cerr << "Failed to open " << inPath << ": " << std::strerror(errno)
+                  << std::endl;
+        return 1;
+    }
+    if (outPath &&
+        (outFd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    {
+        std::cerr << "Failed to open " << outPath << ": "
+                  << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    growPipeBuffer(inFd);
+    growPipeBuffer(outFd);
+
+    try
+    {
+        VadGate gate(vadOptions);
+
+        // All buffers are sized once; the loop below never allocates
+        const size_t sampleBytes =
+          format == SampleFormat::F32LE ? sizeof(float) : sizeof(int16_t);
+        std::vector<char> raw(blockSize * sampleBytes);
+        std::vector<float> block(blockSize, 0.0f);
+
+        size_t totalSamples = 0;
+        double inferenceSeconds = 0.0;
+
+        // The same loop for either backend
+        auto convertStream = [&](auto& engine, auto& state) {
+            while (true)
+            {
+                size_t bytes   = readFully(inFd, raw.data(), raw.size());
+                size_t samples = bytes / sampleBytes;
+                if (samples == 0)
+                {
+                    break;
+                }
+
+                decodeSamples(raw.data(), samples, format, block);
+                std::fill(block.begin() + samples, block.end(), 0.0f);
+
+                auto start = std::chrono::steady_clock::now();
+                if (vad)
+                {
+                    gate.process(
+                      engine, block.data(), block.data(), block.size(), state);
+                }
+                else
+                {
+                    processBlock(engine, block, state);
+                }
+                inferenceSeconds += std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count();
+
+                encodeSamples(block, samples, format, raw.data());
+                if (!writeFully(outFd, raw.data(), samples * sampleBytes))
+                {
+                    break; // Downstream closed
+                }
+                totalSamples += samples;
+
+                if (bytes < raw.size())
+                {
+                    break; // Short read means EOF
+                }
+            }
+        };
+
+        if (native)
+        {
+            NativeEngine engine(modelPath);
+            NativeState state = engine.createState();
+            std::cerr << "Native engine, " << kernelIsa() << " kernels."
+                      << std::endl;
+            convertStream(engine, state);
+        }
+        else
+        {
+            // Set up ONNX Runtime
+            Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "llvc_stdio");
+            Ort::SessionOptions session_options;
+            session_options.SetIntraOpNumThreads(1);
+            session_options.SetGraphOptimizationLevel(
+              GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+
+            Ort::Session session(env, modelPath, session_options);
+            if (BlockConverter::supports(blockSize))
+            {
+                BlockConverter converter(session, blockSize);
+                BlockConverter::State state;
+                convertStream(converter, state);
+            }
+            else
+            {
+                StreamState state = createStreamState();
+                convertStream(session, state);
+            }
+        }
+
+        double audio_length_seconds =
+          static_cast<double>(totalSamples) / SAMPLE_RATE;
+        std::cerr << "Converted " << audio_length_seconds << " seconds in "
+                  << inferenceSeconds << " seconds of inference (RTF "
+                  << (inferenceSeconds > 0.0
+                        ? audio_length_seconds / inferenceSeconds
+                        : 0.0)
+                  << ")." << std::endl;
+        if (vad)
+        {
+            std::cerr << gate.statistics() << "." << std::endl;
+        }
+    }
+    catch (const Ort::Exception& e)
+    {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (inPath)
+    {
+        close(inFd);
+    }
+    if (outPath)
+    {
+        close(outFd);
+    }
+    return 0;
+}